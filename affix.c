@@ -0,0 +1,747 @@
+/* affix.c -- find the stems of words made with affixes.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+   Rules are read in the format of Ispell's affix files, and each kind
+   is compiled into a trie keyed on what its rules add: backwards for
+   suffixes, forwards for prefixes.  To strip a word's suffixes, the
+   trie is walked from the word's last character towards its first,
+   and at each node the rules that end there are tried: each gives one
+   stem, to be checked against its condition and looked up.  A word
+   that no rule could have made is dropped after a step or two, so
+   stripping costs little more than the literal lookup that failed
+   before it.  */
+
+/* Local headers.  */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dict.h"
+#include "affix.h"
+
+/* System headers.  */
+
+#include <sys/types.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else /* not HAVE_STRING_H */
+#include <strings.h>
+#endif /* not HAVE_STRING_H */
+
+#ifndef EXIT_FAILURE
+#define EXIT_FAILURE 1
+#endif
+
+/* Room for any stem tried: a word with a prefix's strip put back and
+   a suffix's.  */
+#define STEM_MAX (DICT_MAX_WORD + 2 * AFFIX_MAX)
+
+extern char *program_name;
+
+static void *xmalloc (size_t);
+static void *xrealloc (void *, size_t);
+static void error (int, int, const char *,...);
+static int compare_prefixes (const void *, const void *);
+static int compare_suffixes (const void *, const void *);
+static int derive (affixes_t *, dict_t *, const char *, int, char *,
+		   int *);
+static int key_char (const struct affix_rule *, int, int);
+static int match (affixes_t *, const struct affix_rule *, const char *);
+static int strip_prefix (affixes_t *, dict_t *, const char *, int, char *,
+			 int *);
+static int strip_suffix (affixes_t *, dict_t *, const char *, int,
+			 const struct affix_rule *, char *, int *);
+static void build_table (struct affix_table *, int);
+static void fill_node (struct affix_table *, int, int, int, int, int);
+static void parse (affixes_t *, const char *, size_t, const char *);
+static void parse_rule (affixes_t *, struct affix_table *, int,
+			const char *, const char *, const char *, int);
+
+/* The rules used when no affix file is given: the commoner of
+   Ispell's English ones.  Lacking flags, they are tried on every
+   word, so those that would let the most nonsense through are left
+   out.  */
+static const char english_rules[] =
+  "prefixes\n"
+  "flag *a:\n"
+  "    .\t\t> re\n"
+  "flag *u:\n"
+  "    .\t\t> un\n"
+  "suffixes\n"
+  "flag *d:\n"
+  "    e\t\t> d\n"
+  "    [^aeiou]y\t> -y,ied\n"
+  "    [^ey]\t> ed\n"
+  "    [aeiou]y\t> ed\n"
+  "flag *g:\n"
+  "    e\t\t> -e,ing\n"
+  "    [^e]\t> ing\n"
+  "flag *j:\n"
+  "    e\t\t> -e,ings\n"
+  "    [^e]\t> ings\n"
+  "flag *m:\n"
+  "    .\t\t> 's\n"
+  "flag *p:\n"
+  "    [^aeiou]y\t> -y,iness\n"
+  "    [aeiou]y\t> ness\n"
+  "    [^y]\t> ness\n"
+  "flag *r:\n"
+  "    e\t\t> r\n"
+  "    [^aeiou]y\t> -y,ier\n"
+  "    [aeiou]y\t> er\n"
+  "    [^ey]\t> er\n"
+  "flag *s:\n"
+  "    [^aeiou]y\t> -y,ies\n"
+  "    [aeiou]y\t> s\n"
+  "    [sxzh]\t> es\n"
+  "    [^sxzhy]\t> s\n"
+  "flag *t:\n"
+  "    e\t\t> st\n"
+  "    [^aeiou]y\t> -y,iest\n"
+  "    [aeiou]y\t> est\n"
+  "    [^ey]\t> est\n"
+  "flag *y:\n"
+  "    .\t\t> ly\n"
+  "flag *z:\n"
+  "    e\t\t> rs\n"
+  "    [^aeiou]y\t> -y,iers\n"
+  "    [aeiou]y\t> ers\n"
+  "    [^ey]\t> ers\n";
+
+/* Return a new, empty set of rules.  */
+
+affixes_t *
+affix_make (void)
+{
+  affixes_t *affixes = xmalloc (sizeof *affixes);
+
+  memset (affixes, 0, sizeof *affixes);
+  return affixes;
+}
+
+/* Add to *AFFIXES the rules in the Ispell affix file FILE, or the
+   builtin English rules if FILE is NULL.  Of the file, only the
+   `prefixes' and `suffixes' sections and the `flag' groups in them
+   are read; the flags' names mean nothing here, as no word says
+   which it takes.  */
+
+void
+affix_load (affixes_t * affixes, const char *file)
+{
+  FILE *stream;
+  struct stat stat_buf;
+  char *text;
+  size_t len;
+
+  if (!file)
+    {
+      parse (affixes, english_rules, sizeof english_rules - 1,
+	     "builtin rules");
+      return;
+    }
+
+  stream = fopen (file, "r");
+  if (!stream)
+    error (EXIT_FAILURE, errno, "%s: cannot open", file);
+  if (fstat (fileno (stream), &stat_buf) == -1)
+    error (EXIT_FAILURE, errno, "%s: stat error", file);
+
+  text = xmalloc (stat_buf.st_size + 1);
+  len = fread (text, 1, stat_buf.st_size, stream);
+  if (ferror (stream))
+    error (EXIT_FAILURE, errno, "%s: read error", file);
+  fclose (stream);
+
+  parse (affixes, text, len, file);
+  free (text);
+}
+
+/* Add the rules in the LEN characters at TEXT, in the format of an
+   Ispell affix file called NAME, to *AFFIXES.  Letters are taken in
+   lower case, as the word lists have them.  */
+
+static void
+parse (affixes_t * affixes, const char *text, size_t len, const char *name)
+{
+  struct affix_table *table = NULL;
+  const char *end = text + len;
+  const char *pos = text;
+  int cross = 0;
+  int in_flag = 0;
+  int line = 0;
+
+  while (pos < end)
+    {
+      const char *eol = memchr (pos, '\n', end - pos);
+      const char *next = eol ? eol + 1 : end;
+      const char *comment;
+      const char *word;
+      int word_len;
+
+      if (!eol)
+	eol = end;
+      line++;
+
+      comment = memchr (pos, '#', eol - pos);
+      if (comment)
+	eol = comment;
+
+      while (pos < eol && isspace ((unsigned char) *pos))
+	pos++;
+      for (word = pos; pos < eol && isalpha ((unsigned char) *pos); pos++);
+      word_len = pos - word;
+
+      if (word_len == 8 && !strncasecmp (word, "prefixes", 8))
+	table = &affixes->prefix, in_flag = 0;
+      else if (word_len == 8 && !strncasecmp (word, "suffixes", 8))
+	table = &affixes->suffix, in_flag = 0;
+      else if (word_len == 4 && !strncasecmp (word, "flag", 4) && table)
+	{
+	  const char *colon = memchr (pos, ':', eol - pos);
+
+	  if (!colon)
+	    error (EXIT_FAILURE, 0, "%s:%d: flag without `:'", name, line);
+	  cross = memchr (pos, '*', colon - pos) != NULL;
+	  in_flag = 1;
+
+	  /* A rule may follow on the same line.  */
+	  if (memchr (colon, '>', eol - colon))
+	    parse_rule (affixes, table, cross, colon + 1, eol, name, line);
+	}
+      else if (in_flag && memchr (word, '>', eol - word))
+	parse_rule (affixes, table, cross, word, eol, name, line);
+
+      pos = next;
+    }
+}
+
+/* Add to *TABLE of *AFFIXES the rule in the characters from POS to
+   END, which is line LINE of NAME: a condition, `>', and what to add,
+   with what to strip before it after a `-' and followed by a `,'.
+   CROSS says whether the rule's flag had a `*'.  */
+
+static void
+parse_rule (affixes_t * affixes, struct affix_table *table, int cross,
+	    const char *pos, const char *end, const char *name, int line)
+{
+  struct affix_rule *rule;
+
+  if (table->count == table->mem)
+    {
+      table->mem = table->mem ? table->mem * 2 : 32;
+      table->rule = xrealloc (table->rule, table->mem * sizeof *table->rule);
+    }
+  rule = &table->rule[table->count];
+  memset (rule, 0, sizeof *rule);
+  rule->cross = cross;
+  rule->cond = affixes->sets;
+
+  /* The condition: `.' for any character, a letter, or a set in
+     brackets, each for one character of the stem.  */
+  while (pos < end && *pos != '>')
+    {
+      uint32_t *set;
+      int negate = 0;
+      int c;
+
+      if (isspace ((unsigned char) *pos))
+	{
+	  pos++;
+	  continue;
+	}
+      if (rule->conds == AFFIX_MAX_CONDS)
+	error (EXIT_FAILURE, 0, "%s:%d: condition too long", name, line);
+
+      if (affixes->sets == affixes->set_mem)
+	{
+	  affixes->set_mem = affixes->set_mem ? affixes->set_mem * 2 : 32;
+	  affixes->set = xrealloc (affixes->set,
+				   affixes->set_mem * sizeof *affixes->set);
+	}
+      set = affixes->set[affixes->sets++];
+      rule->conds++;
+
+      if (*pos == '.')
+	{
+	  memset (set, 0xff, sizeof affixes->set[0]);
+	  pos++;
+	  continue;
+	}
+
+      memset (set, 0, sizeof affixes->set[0]);
+      if (*pos != '[')
+	{
+	  c = tolower ((unsigned char) *pos++);
+	  set[c / 32] |= 1U << c % 32;
+	  continue;
+	}
+
+      if (++pos < end && *pos == '^')
+	negate = 1, pos++;
+      for (; pos < end && *pos != ']'; pos++)
+	{
+	  int last = c = tolower ((unsigned char) *pos);
+
+	  if (pos + 2 < end && pos[1] == '-' && pos[2] != ']')
+	    {
+	      last = tolower ((unsigned char) pos[2]);
+	      pos += 2;
+	    }
+	  for (; c <= last; c++)
+	    set[c / 32] |= 1U << c % 32;
+	}
+      if (pos == end)
+	error (EXIT_FAILURE, 0, "%s:%d: missing `]'", name, line);
+      pos++;
+      if (negate)
+	for (c = 0; c < 8; c++)
+	  set[c] = ~set[c];
+    }
+  if (pos == end)
+    error (EXIT_FAILURE, 0, "%s:%d: missing `>'", name, line);
+
+  for (pos++; pos < end && isspace ((unsigned char) *pos); pos++);
+  if (pos < end && *pos == '-')
+    {
+      for (pos++; pos < end && *pos != ','; pos++)
+	{
+	  if (rule->strip_len == AFFIX_MAX)
+	    error (EXIT_FAILURE, 0, "%s:%d: affix too long", name, line);
+	  rule->strip[rule->strip_len++] = tolower ((unsigned char) *pos);
+	}
+      if (pos == end)
+	error (EXIT_FAILURE, 0, "%s:%d: missing `,'", name, line);
+      pos++;
+    }
+
+  for (; pos < end && !isspace ((unsigned char) *pos); pos++)
+    {
+      if (rule->add_len == AFFIX_MAX)
+	error (EXIT_FAILURE, 0, "%s:%d: affix too long", name, line);
+      rule->add[rule->add_len++] = tolower ((unsigned char) *pos);
+    }
+
+  /* `-' alone adds nothing.  */
+  if (rule->add_len == 1 && rule->add[0] == '-')
+    rule->add_len = 0;
+
+  if (!rule->add_len && !rule->strip_len)
+    error (EXIT_FAILURE, 0, "%s:%d: rule changes nothing", name, line);
+
+  table->count++;
+}
+
+/* Compile the rules added to *AFFIXES into their tries, which must be
+   done before words are checked with them.  */
+
+void
+affix_build (affixes_t * affixes)
+{
+  build_table (&affixes->prefix, 0);
+  build_table (&affixes->suffix, 1);
+}
+
+/* Sort the rules of *TABLE by their keys (backwards if SUFFIX) and
+   build its trie.  */
+
+static void
+build_table (struct affix_table *table, int suffix)
+{
+  int most = 1;
+  int i;
+
+  if (table->count > 65535)
+    error (EXIT_FAILURE, 0, "too many affix rules");
+
+  qsort (table->rule, table->count, sizeof *table->rule,
+	 suffix ? compare_suffixes : compare_prefixes);
+
+  /* A node for each character of each key at most.  */
+  for (i = 0; i < table->count; i++)
+    most += table->rule[i].add_len;
+  table->node = xmalloc (most * sizeof *table->node);
+  table->node[0].c = 0;
+  table->nodes = 1;
+  fill_node (table, 0, 0, table->count, 0, suffix);
+}
+
+/* Fill in node N of *TABLE as the node at DEPTH for the rules from LO
+   to HI, whose keys have the same first DEPTH characters, and its
+   children after it.  The children of a node are allocated together,
+   before any grandchild.  */
+
+static void
+fill_node (struct affix_table *table, int n, int lo, int hi, int depth,
+	   int suffix)
+{
+  struct affix_node *node = &table->node[n];
+  int first = table->nodes;
+  int start;
+  int i;
+  int j;
+
+  /* A key that ends here sorts before the keys it begins.  */
+  for (start = lo; start < hi && table->rule[start].add_len == depth;
+       start++);
+  node->rule = lo;
+  node->rules = start - lo;
+  node->child = first;
+  node->children = 0;
+
+  for (i = start; i < hi; i = j)
+    {
+      int c = key_char (&table->rule[i], depth, suffix);
+
+      for (j = i; j < hi && key_char (&table->rule[j], depth, suffix) == c;
+	   j++);
+      table->node[table->nodes++].c = c;
+      node->children++;
+    }
+
+  for (i = start, n = first; i < hi; i = j, n++)
+    {
+      int c = key_char (&table->rule[i], depth, suffix);
+
+      for (j = i; j < hi && key_char (&table->rule[j], depth, suffix) == c;
+	   j++);
+      fill_node (table, n, i, j, depth + 1, suffix);
+    }
+}
+
+/* Return character DEPTH of the key of *RULE: what it adds, read
+   backwards if SUFFIX.  */
+
+static int
+key_char (const struct affix_rule *rule, int depth, int suffix)
+{
+  return (unsigned char) rule->add[suffix ? rule->add_len - 1 - depth
+				   : depth];
+}
+
+/* Compare the prefix rules at A and B by what they add, then by what
+   they strip, so that the order, and so the stem found, is always the
+   same.  */
+
+static int
+compare_prefixes (const void *a, const void *b)
+{
+  const struct affix_rule *x = a;
+  const struct affix_rule *y = b;
+  int len = x->add_len < y->add_len ? x->add_len : y->add_len;
+  int diff = memcmp (x->add, y->add, len);
+
+  if (diff)
+    return diff;
+  if (x->add_len != y->add_len)
+    return x->add_len - y->add_len;
+  if (x->strip_len != y->strip_len)
+    return x->strip_len - y->strip_len;
+  return memcmp (x->strip, y->strip, x->strip_len);
+}
+
+/* Compare the suffix rules at A and B by what they add read
+   backwards, then by what they strip.  */
+
+static int
+compare_suffixes (const void *a, const void *b)
+{
+  const struct affix_rule *x = a;
+  const struct affix_rule *y = b;
+  int len = x->add_len < y->add_len ? x->add_len : y->add_len;
+  int i;
+
+  for (i = 0; i < len; i++)
+    {
+      int diff = key_char (x, i, 1) - key_char (y, i, 1);
+
+      if (diff)
+	return diff;
+    }
+  if (x->add_len != y->add_len)
+    return x->add_len - y->add_len;
+  if (x->strip_len != y->strip_len)
+    return x->strip_len - y->strip_len;
+  return memcmp (x->strip, y->strip, x->strip_len);
+}
+
+/* Return nonzero if the LEN characters at WORD, which are not in
+   DICT literally, are made by the rules of *AFFIXES from a stem in
+   DICT, and put that stem in STEM (which has room for
+   `DICT_MAX_WORD' characters) and its length in *STEM_LEN.  A word
+   capitalized or in capitals may be made from a stem in lower case,
+   or capitalized, just as `dict_check' allows.  Nothing is changed,
+   so threads may do this at once.  */
+
+int
+affix_check (affixes_t * affixes, dict_t * dict, const char *word, int len,
+	     char *stem, int *stem_len)
+{
+  char copy[DICT_MAX_WORD];
+  int lower = 0;		/* Lower case letters after the first.  */
+  int upper = 0;		/* Upper case letters after the first.  */
+  int pos;
+
+  if (len > DICT_MAX_WORD || len < 2)
+    return 0;
+  if (derive (affixes, dict, word, len, stem, stem_len))
+    return 1;
+
+  for (pos = 1; pos < len; pos++)
+    if (islower ((unsigned char) word[pos]))
+      lower++;
+    else if (isupper ((unsigned char) word[pos]))
+      upper++;
+
+  if (!isupper ((unsigned char) word[0]) || (lower && upper))
+    return 0;
+
+  for (pos = 0; pos < len; pos++)
+    copy[pos] = tolower ((unsigned char) word[pos]);
+  if (derive (affixes, dict, copy, len, stem, stem_len))
+    return 1;
+
+  if (upper)
+    {
+      copy[0] = word[0];
+      return derive (affixes, dict, copy, len, stem, stem_len);
+    }
+
+  return 0;
+}
+
+/* Look in DICT for a stem the LEN characters at WORD are made from,
+   with a suffix, a prefix, or both, and return nonzero if there is
+   one, as `affix_check' does.  */
+
+static int
+derive (affixes_t * affixes, dict_t * dict, const char *word, int len,
+	char *stem, int *stem_len)
+{
+  return (strip_suffix (affixes, dict, word, len, NULL, stem, stem_len)
+	  || strip_prefix (affixes, dict, word, len, stem, stem_len));
+}
+
+/* Look in DICT for a stem the LEN characters at WORD are made from
+   with a suffix of *AFFIXES, as `affix_check' does.  If PREFIX is not
+   NULL, WORD is what a word was left after that prefix rule was
+   stripped from it: only suffixes that may go with a prefix are
+   tried, and the stem must meet PREFIX's condition too.  */
+
+static int
+strip_suffix (affixes_t * affixes, dict_t * dict, const char *word, int len,
+	      const struct affix_rule *prefix, char *stem, int *stem_len)
+{
+  struct affix_table *table = &affixes->suffix;
+  struct affix_node *node = table->node;
+  char buf[STEM_MAX];
+  int depth = 0;
+
+  if (!table->nodes)
+    return 0;
+
+  while (1)
+    {
+      const struct affix_rule *rule = &table->rule[node->rule];
+      const struct affix_rule *end = rule + node->rules;
+      int keep = len - depth;
+      struct affix_node *child;
+      struct affix_node *last;
+      int c;
+
+      for (; rule < end; rule++)
+	{
+	  int n = keep + rule->strip_len;
+	  const char *at = word;
+
+	  if ((prefix && !rule->cross) || n < rule->conds
+	      || n > DICT_MAX_WORD)
+	    continue;
+
+	  /* Most rules strip nothing, and the stem is in WORD.  */
+	  if (rule->strip_len)
+	    {
+	      memcpy (buf, word, keep);
+	      memcpy (buf + keep, rule->strip, rule->strip_len);
+	      at = buf;
+	    }
+	  if (!match (affixes, rule, at + n - rule->conds)
+	      || (prefix && (n < prefix->conds
+			     || !match (affixes, prefix, at)))
+	      || !dict_find (dict, at, n))
+	    continue;
+	  memcpy (stem, at, n);
+	  *stem_len = n;
+	  return 1;
+	}
+
+      /* Some of the word must be left.  */
+      if (keep == 1)
+	return 0;
+      c = (unsigned char) word[keep - 1];
+      child = &table->node[node->child];
+      last = child + node->children;
+      for (; child < last && child->c < c; child++);
+      if (child == last || child->c != c)
+	return 0;
+      node = child;
+      depth++;
+    }
+}
+
+/* Look in DICT for a stem the LEN characters at WORD are made from
+   with a prefix of *AFFIXES, and perhaps a suffix as well, as
+   `affix_check' does.  */
+
+static int
+strip_prefix (affixes_t * affixes, dict_t * dict, const char *word, int len,
+	      char *stem, int *stem_len)
+{
+  struct affix_table *table = &affixes->prefix;
+  struct affix_node *node = table->node;
+  char buf[DICT_MAX_WORD + AFFIX_MAX];
+  int depth = 0;
+
+  if (!table->nodes)
+    return 0;
+
+  while (1)
+    {
+      const struct affix_rule *rule = &table->rule[node->rule];
+      const struct affix_rule *end = rule + node->rules;
+      int keep = len - depth;
+      struct affix_node *child;
+      struct affix_node *last;
+      int c;
+
+      for (; rule < end; rule++)
+	{
+	  int n = rule->strip_len + keep;
+	  const char *at = word + depth;
+
+	  if (rule->strip_len)
+	    {
+	      memcpy (buf, rule->strip, rule->strip_len);
+	      memcpy (buf + rule->strip_len, word + depth, keep);
+	      at = buf;
+	    }
+	  if (n >= rule->conds && n <= DICT_MAX_WORD
+	      && match (affixes, rule, at) && dict_find (dict, at, n))
+	    {
+	      memcpy (stem, at, n);
+	      *stem_len = n;
+	      return 1;
+	    }
+	  if (rule->cross
+	      && strip_suffix (affixes, dict, at, n, rule, stem, stem_len))
+	    return 1;
+	}
+
+      if (keep == 1)
+	return 0;
+      c = (unsigned char) word[depth];
+      child = &table->node[node->child];
+      last = child + node->children;
+      for (; child < last && child->c < c; child++);
+      if (child == last || child->c != c)
+	return 0;
+      node = child;
+      depth++;
+    }
+}
+
+/* Return nonzero if the characters at TEXT are in the sets of the
+   condition of *RULE, one for one.  */
+
+static int
+match (affixes_t * affixes, const struct affix_rule *rule, const char *text)
+{
+  uint32_t (*set)[8] = affixes->set + rule->cond;
+  int i;
+
+  for (i = 0; i < rule->conds; i++)
+    {
+      int c = (unsigned char) text[i];
+
+      if (!(set[i][c / 32] & 1U << c % 32))
+	return 0;
+    }
+  return 1;
+}
+
+/* Print the program name and error message MESSAGE, which is a
+   printf-style format string with optional args.  If ERRNUM is
+   nonzero, print its corresponding system error message.  Exit with
+   status STATUS if it is nonzero.  This function was written by David
+   MacKenzie <djm@gnu.ai.mit.edu>.  */
+
+static void
+error (int status, int errnum, const char *message,...)
+{
+  va_list args;
+
+  fflush (stdout);
+  fprintf (stderr, "%s: ", program_name);
+
+  va_start (args, message);
+  vfprintf (stderr, message, args);
+  va_end (args);
+
+  if (errnum)
+    fprintf (stderr, ": %s", strerror (errnum));
+  putc ('\n', stderr);
+  fflush (stderr);
+  if (status)
+    exit (status);
+}
+
+/* Allocate SIZE bytes of memory dynamically, with error checking,
+   returning a pointer to that memory.  */
+
+static void *
+xmalloc (size_t size)
+{
+  void *ptr = malloc (size);
+
+  if (!ptr)
+    error (EXIT_FAILURE, 0, "virtual memory exhausted");
+  return ptr;
+}
+
+/* Change the size of an allocated block of memory *PTR to SIZE bytes,
+   with error checking, returning the new pointer.  If PTR is NULL,
+   run `xmalloc'.  */
+
+static void *
+xrealloc (void *ptr, size_t size)
+{
+  if (!ptr)
+    return xmalloc (size);
+  ptr = realloc (ptr, size);
+  if (!ptr)
+    error (EXIT_FAILURE, 0, "virtual memory exhausted");
+  return ptr;
+}
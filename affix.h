@@ -0,0 +1,88 @@
+/* affix.h -- header for affix.c.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+/* The most characters a rule may add or strip.  */
+#define AFFIX_MAX 16
+
+/* The most characters of a stem a rule's condition may test.  */
+#define AFFIX_MAX_CONDS 8
+
+/* A rule for making a word from a stem, as `flag' lines in an Ispell
+   affix file give them: if the end of the stem (the start, for a
+   prefix) matches the condition, `strip' is taken off it and `add'
+   put on.  */
+struct affix_rule
+  {
+    char strip[AFFIX_MAX];	/* What is taken off the stem.  */
+    char add[AFFIX_MAX];	/* What is put on.  */
+    unsigned char strip_len;	/* Length of `strip'.  */
+    unsigned char add_len;	/* Length of `add'.  */
+    unsigned char conds;	/* Characters the condition tests.  */
+    unsigned char cross;	/* Whether a word may have this and an
+				   affix of the other kind (`*' before
+				   the flag).  */
+    int cond;			/* Index in `set' of the set allowed for
+				   the first of them.  */
+  };
+
+/* A node of a trie of rules.  The trie of suffixes is keyed on what
+   each rule adds read backwards, so the walk from a word's last
+   character down passes every suffix rule the word could have been
+   made with, and only those; the trie of prefixes is keyed forwards.
+   A node's children are next to each other, sorted.  */
+struct affix_node
+  {
+    unsigned char c;		/* The character leading to it.  */
+    unsigned char children;	/* How many children it has.  */
+    uint16_t child;		/* Index of the first.  */
+    uint16_t rule;		/* Index of the first rule whose `add'
+				   ends here.  */
+    uint16_t rules;		/* How many there are.  */
+  };
+
+/* The rules of one kind, and their trie.  */
+struct affix_table
+  {
+    struct affix_rule *rule;	/* The rules, sorted by key once
+				   built.  */
+    int count;			/* Number of rules.  */
+    int mem;			/* Number allocated.  */
+    struct affix_node *node;	/* The trie; the root is first.  */
+    int nodes;			/* Number of nodes.  */
+  };
+
+/* The prefix and suffix rules for stripping affixes off words that
+   are not in the dictionary literally.  A stem is accepted if any rule
+   makes the word from it, whatever the stem: the word lists we use
+   give no flags saying which rules each word takes.  */
+struct affixes
+  {
+    struct affix_table prefix;	/* Prefix rules.  */
+    struct affix_table suffix;	/* Suffix rules.  */
+    uint32_t (*set)[8];		/* Sets of characters allowed by the
+				   conditions, one bit a character.  */
+    int sets;			/* Number of sets.  */
+    int set_mem;		/* Number allocated.  */
+  };
+typedef struct affixes affixes_t;
+
+affixes_t *affix_make (void);
+int affix_check (affixes_t *, dict_t *, const char *, int, char *, int *);
+void affix_build (affixes_t *);
+void affix_load (affixes_t *, const char *);
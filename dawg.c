@@ -0,0 +1,603 @@
+/* dawg.c -- dictionaries kept as minimal acyclic word graphs.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+   The graph is built the way Daciuk, Mihov, Watson and Watson build
+   one from sorted words, in a single pass with no trie built first.
+   The states on the path of the last word added are still open: a
+   word can only add arcs to them, and only after their last arc.
+   When the next word leaves the path at some depth, the open states
+   below it can never change again, so each, deepest first, is closed:
+   its arcs are looked up in a table of the states already closed,
+   and it becomes the state found, or is added to the arcs if there
+   is none.  A state's arcs are compared as they are encoded, so
+   closing one is a hash and a compare.
+
+   Whether a state ends a word is kept in the arcs leading to it, so
+   two states differing only in that share their arcs.  */
+
+/* Local headers.  */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dict.h"
+#include "dawg.h"
+
+/* System headers.  */
+
+#include <sys/types.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else /* not HAVE_STRING_H */
+#include <strings.h>
+#endif /* not HAVE_STRING_H */
+
+#ifndef EXIT_FAILURE
+#define EXIT_FAILURE 1
+#endif
+
+/* A state not yet closed.  */
+struct open_state
+  {
+    uint32_t *arc;		/* Its arcs; the target of the last is
+				   filled in when the state it leads to
+				   is closed.  */
+    int count;			/* How many it has.  */
+    int final;			/* Whether it ends a word.  */
+  };
+
+/* What is kept while words are added to a graph.  */
+struct dawg_builder
+  {
+    struct open_state open[DICT_MAX_WORD + 1];	/* The path of the
+						   last word, from the
+						   start state.  */
+    char last[DICT_MAX_WORD];	/* The last word added.  */
+    int last_len;		/* Its length.  */
+    uint32_t *closed;		/* Hash table of the first arcs of the
+				   states closed, or zero.  */
+    uint32_t size;		/* Its number of slots; a power of
+				   two.  */
+    uint32_t count;		/* Number of states in it.  */
+  };
+
+extern char *program_name;
+
+static void *xmalloc (size_t);
+static void *xrealloc (void *, size_t);
+static void error (int, int, const char *,...);
+static long enumerate (dawg_t *, uint32_t, char *, int,
+		       void (*) (const char *, int, void *), void *);
+static uint32_t close_state (dawg_t *, struct open_state *);
+static uint32_t hash_arcs (const uint32_t *, int);
+static void close_path (dawg_t *, int);
+static void index_start (dawg_t *);
+static void grow (struct dawg_builder *, uint32_t *);
+
+/* Make an empty graph, to which words can be added in order.  */
+
+dawg_t *
+dawg_make (void)
+{
+  dawg_t *dawg = xmalloc (sizeof *dawg);
+  struct dawg_builder *build = xmalloc (sizeof *build);
+
+  memset (build, 0, sizeof *build);
+  build->size = 1024;
+  build->closed = xmalloc (build->size * sizeof *build->closed);
+  memset (build->closed, 0, build->size * sizeof *build->closed);
+
+  dawg->mem = 1024;
+  dawg->arc = xmalloc (dawg->mem * sizeof *dawg->arc);
+  dawg->arc[0] = 0;
+  dawg->arcs = 1;
+  dawg->root = 0;
+  dawg->count = 0;
+  dawg->build = build;
+  dawg->mapped = 0;
+
+  return dawg;
+}
+
+/* Add the LEN characters at WORD to *DAWG, which must still be open
+   to words.  Words must be added in order of their bytes, taken as
+   unsigned; adding one again does nothing.  */
+
+void
+dawg_add (dawg_t * dawg, const char *word, int len)
+{
+  struct dawg_builder *build = dawg->build;
+  int common;
+  int depth;
+
+  if (len <= 0 || len > DICT_MAX_WORD)
+    return;
+
+  for (common = 0; common < len && common < build->last_len
+       && word[common] == build->last[common]; common++);
+  if (common == len && common == build->last_len)
+    return;
+  if (common == len
+      || (common < build->last_len
+	  && (unsigned char) word[common]
+	  < (unsigned char) build->last[common]))
+    error (EXIT_FAILURE, 0, "words must be added to a word graph in "
+	   "order");
+
+  /* The states past the common part are done with.  */
+  close_path (dawg, common);
+
+  for (depth = common + 1; depth <= len; depth++)
+    {
+      struct open_state *parent = &build->open[depth - 1];
+      struct open_state *state = &build->open[depth];
+
+      if (!parent->arc)
+	parent->arc = xmalloc (256 * sizeof *parent->arc);
+      parent->arc[parent->count++] = (unsigned char) word[depth - 1];
+      state->count = 0;
+      state->final = 0;
+    }
+  build->open[len].final = 1;
+
+  memcpy (build->last, word, len);
+  build->last_len = len;
+  dawg->count++;
+}
+
+/* Finish building *DAWG, after which it may be searched but no more
+   words added.  */
+
+void
+dawg_finish (dawg_t * dawg)
+{
+  struct dawg_builder *build = dawg->build;
+  int depth;
+
+  close_path (dawg, 0);
+  dawg->root = close_state (dawg, &build->open[0]);
+
+  for (depth = 0; depth <= DICT_MAX_WORD; depth++)
+    free (build->open[depth].arc);
+  free (build->closed);
+  free (build);
+  dawg->build = NULL;
+
+  dawg->arc = xrealloc (dawg->arc, dawg->arcs * sizeof *dawg->arc);
+  dawg->mem = dawg->arcs;
+  index_start (dawg);
+}
+
+/* Fill in the `start' index of *DAWG.  */
+
+static void
+index_start (dawg_t * dawg)
+{
+  uint32_t pos = dawg->root;
+
+  memset (dawg->start, 0, sizeof dawg->start);
+  if (pos)
+    do
+      dawg->start[DAWG_LABEL (dawg->arc[pos])] = pos;
+    while (!(dawg->arc[pos++] & DAWG_LAST));
+}
+
+/* Close the open states of *DAWG deeper than DEPTH, deepest first,
+   pointing the last arc of each one's parent at it.  */
+
+static void
+close_path (dawg_t * dawg, int depth)
+{
+  struct dawg_builder *build = dawg->build;
+  int d;
+
+  for (d = build->last_len; d > depth; d--)
+    {
+      struct open_state *state = &build->open[d];
+      struct open_state *parent = &build->open[d - 1];
+      uint32_t first = close_state (dawg, state);
+
+      parent->arc[parent->count - 1] |= (first << 10
+					 | (state->final ? DAWG_FINAL : 0));
+      state->count = 0;
+      state->final = 0;
+    }
+  if (build->last_len > depth)
+    build->last_len = depth;
+}
+
+/* Return the index of the first arc of a closed state of *DAWG with
+   the arcs of *STATE, adding one if there is none, or zero if STATE
+   has no arcs.  */
+
+static uint32_t
+close_state (dawg_t * dawg, struct open_state *state)
+{
+  struct dawg_builder *build = dawg->build;
+  uint32_t mask = build->size - 1;
+  uint32_t pos;
+  uint32_t first;
+  int i;
+
+  if (!state->count)
+    return 0;
+  state->arc[state->count - 1] |= DAWG_LAST;
+
+  for (pos = hash_arcs (state->arc, state->count) & mask;
+       build->closed[pos]; pos = (pos + 1) & mask)
+    {
+      const uint32_t *arc = dawg->arc + build->closed[pos];
+
+      /* A shorter state has `DAWG_LAST' where STATE has none.  */
+      for (i = 0; i < state->count && arc[i] == state->arc[i]; i++);
+      if (i == state->count)
+	return build->closed[pos];
+    }
+
+  if (dawg->arcs + state->count > DAWG_MAX_ARCS)
+    error (EXIT_FAILURE, 0, "too many words for a word graph");
+  if (dawg->arcs + state->count > dawg->mem)
+    {
+      while (dawg->arcs + state->count > dawg->mem)
+	dawg->mem *= 2;
+      dawg->arc = xrealloc (dawg->arc, dawg->mem * sizeof *dawg->arc);
+    }
+  first = dawg->arcs;
+  memcpy (dawg->arc + first, state->arc, state->count * sizeof *state->arc);
+  dawg->arcs += state->count;
+
+  build->closed[pos] = first;
+  if (++build->count * 2 > build->size)
+    grow (build, dawg->arc);
+  return first;
+}
+
+/* Return the hash of the COUNT arcs at ARC (32-bit FNV-1a, taken an
+   arc at a time).  */
+
+static uint32_t
+hash_arcs (const uint32_t * arc, int count)
+{
+  uint32_t hash = 2166136261U;
+  int i;
+
+  for (i = 0; i < count; i++)
+    {
+      hash ^= arc[i];
+      hash *= 16777619U;
+    }
+  return hash;
+}
+
+/* Double the number of slots in the table of closed states of
+   *BUILD, whose arcs are at ARC.  */
+
+static void
+grow (struct dawg_builder *build, uint32_t * arc)
+{
+  uint32_t *old = build->closed;
+  uint32_t old_size = build->size;
+  uint32_t mask;
+  uint32_t i;
+
+  build->size *= 2;
+  mask = build->size - 1;
+  build->closed = xmalloc (build->size * sizeof *build->closed);
+  memset (build->closed, 0, build->size * sizeof *build->closed);
+
+  for (i = 0; i < old_size; i++)
+    if (old[i])
+      {
+	uint32_t first = old[i];
+	uint32_t end = first;
+	uint32_t pos;
+
+	while (!(arc[end] & DAWG_LAST))
+	  end++;
+	for (pos = hash_arcs (arc + first, end - first + 1) & mask;
+	     build->closed[pos]; pos = (pos + 1) & mask);
+	build->closed[pos] = first;
+      }
+  free (old);
+}
+
+/* Return nonzero if the LEN characters at WORD are, exactly, a word
+   in *DAWG.  */
+
+int
+dawg_find (dawg_t * dawg, const char *word, int len)
+{
+  const uint32_t *arc = dawg->arc;
+  uint32_t pos;
+  uint32_t a;
+  int i;
+
+  if (len <= 0 || !(pos = dawg->start[(unsigned char) word[0]]))
+    return 0;
+  a = arc[pos];
+
+  for (i = 1; i < len; i++)
+    {
+      uint32_t c = (unsigned char) word[i];
+
+      pos = DAWG_TARGET (a);
+      if (!pos)
+	return 0;
+      for (;; pos++)
+	{
+	  a = arc[pos];
+	  if (DAWG_LABEL (a) == c)
+	    break;
+	  if (DAWG_LABEL (a) > c || (a & DAWG_LAST))
+	    return 0;
+	}
+    }
+
+  return (a & DAWG_FINAL) != 0;
+}
+
+/* Call FN with each word in *DAWG that begins with the LEN characters
+   at PREFIX, with its length and ARG, in order, and return how many
+   there were.  */
+
+long
+dawg_enumerate (dawg_t * dawg, const char *prefix, int len,
+		void (*fn) (const char *, int, void *), void *arg)
+{
+  char word[DICT_MAX_WORD];
+  uint32_t pos = dawg->root;
+  long count = 0;
+  int i;
+
+  if (len > DICT_MAX_WORD)
+    return 0;
+  memcpy (word, prefix, len);
+
+  for (i = 0; i < len; i++)
+    {
+      uint32_t c = (unsigned char) prefix[i];
+      uint32_t a;
+
+      if (!pos)
+	return 0;
+      for (;; pos++)
+	{
+	  a = dawg->arc[pos];
+	  if (DAWG_LABEL (a) == c)
+	    break;
+	  if (DAWG_LABEL (a) > c || (a & DAWG_LAST))
+	    return 0;
+	}
+
+      if (i == len - 1 && (a & DAWG_FINAL))
+	{
+	  fn (word, len, arg);
+	  count++;
+	}
+      pos = DAWG_TARGET (a);
+    }
+
+  return count + enumerate (dawg, pos, word, len, fn, arg);
+}
+
+/* Call FN with ARG for each word reached from the state whose first
+   arc is POS, having come to it with the LEN characters at WORD,
+   which has room for `DICT_MAX_WORD'.  Return how many there were.  */
+
+static long
+enumerate (dawg_t * dawg, uint32_t pos, char *word, int len,
+	   void (*fn) (const char *, int, void *), void *arg)
+{
+  long count = 0;
+
+  if (!pos || len == DICT_MAX_WORD)
+    return 0;
+
+  while (1)
+    {
+      uint32_t a = dawg->arc[pos++];
+
+      word[len] = DAWG_LABEL (a);
+      if (a & DAWG_FINAL)
+	{
+	  fn (word, len + 1, arg);
+	  count++;
+	}
+      count += enumerate (dawg, DAWG_TARGET (a), word, len + 1, fn, arg);
+      if (a & DAWG_LAST)
+	return count;
+    }
+}
+
+/* Write *DAWG to the file FILE as a compiled dictionary, which
+   `dawg_map' can use as it is.  The file is written under a temporary
+   name and then renamed, so that a reader never sees half of it.
+   Exit with an error on failure.  */
+
+void
+dawg_write (dawg_t * dawg, const char *file)
+{
+  struct dawg_header header;
+  size_t arcs_len = dawg->arcs * sizeof *dawg->arc;
+  char *temp;
+  FILE *stream;
+
+  memset (&header, 0, sizeof header);
+  memcpy (header.magic, DAWG_MAGIC, sizeof header.magic);
+  header.version = DAWG_VERSION;
+  header.byte_order = 0x01020304;
+  header.arcs = dawg->arcs;
+  header.root = dawg->root;
+  header.count = dawg->count;
+  header.checksum = dict_checksum (dawg->arc, arcs_len);
+
+  temp = xmalloc (strlen (file) + sizeof ".tmp");
+  strcpy (temp, file);
+  strcat (temp, ".tmp");
+
+  stream = fopen (temp, "wb");
+  if (!stream)
+    error (EXIT_FAILURE, errno, "%s: cannot create", temp);
+  if (fwrite (&header, sizeof header, 1, stream) != 1
+      || fwrite (dawg->arc, 1, arcs_len, stream) != arcs_len
+      || fclose (stream) == EOF)
+    error (EXIT_FAILURE, errno, "%s: write error", temp);
+  if (rename (temp, file) == -1)
+    error (EXIT_FAILURE, errno, "%s: cannot rename to %s", temp, file);
+
+  free (temp);
+}
+
+/* Return the graph in the LEN bytes mapped at MAP from the file FILE,
+   written by `dawg_write'.  If it is not one of the version and byte
+   order we understand, or fails its checksum, or has an arc leading
+   outside it, print why and return NULL.  */
+
+dawg_t *
+dawg_map (char *map, size_t len, const char *file)
+{
+  struct dawg_header header;
+  dawg_t *dawg;
+  uint32_t *arc;
+  uint32_t i;
+
+  if (len < sizeof header)
+    {
+      error (0, 0, "%s: not a compiled dictionary", file);
+      return NULL;
+    }
+  memcpy (&header, map, sizeof header);
+  if (memcmp (header.magic, DAWG_MAGIC, sizeof header.magic))
+    {
+      error (0, 0, "%s: not a compiled dictionary", file);
+      return NULL;
+    }
+  if (header.byte_order != 0x01020304)
+    {
+      error (0, 0, "%s: compiled on a machine of different byte order",
+	     file);
+      return NULL;
+    }
+  if (header.version != DAWG_VERSION)
+    {
+      error (0, 0, "%s: compiled dictionary version %lu, expected %d; "
+	     "recompile it", file, (unsigned long) header.version,
+	     DAWG_VERSION);
+      return NULL;
+    }
+
+  arc = (uint32_t *) (map + sizeof header);
+  if (!header.arcs || header.root >= header.arcs
+      || len != sizeof header + (size_t) header.arcs * sizeof *arc
+      || dict_checksum (arc, (size_t) header.arcs * sizeof *arc)
+      != header.checksum
+      || (header.arcs > 1 && !(arc[header.arcs - 1] & DAWG_LAST)))
+    {
+      error (0, 0, "%s: compiled dictionary is corrupt", file);
+      return NULL;
+    }
+  for (i = 1; i < header.arcs; i++)
+    if (DAWG_TARGET (arc[i]) >= header.arcs)
+      {
+	error (0, 0, "%s: compiled dictionary is corrupt", file);
+	return NULL;
+      }
+
+  dawg = xmalloc (sizeof *dawg);
+  dawg->arc = arc;
+  dawg->arcs = header.arcs;
+  dawg->root = header.root;
+  dawg->count = header.count;
+  dawg->mem = 0;
+  dawg->build = NULL;
+  dawg->mapped = 1;
+  index_start (dawg);
+
+  return dawg;
+}
+
+/* Free *DAWG, and its arcs unless they are mapped.  */
+
+void
+dawg_free (dawg_t * dawg)
+{
+  if (!dawg->mapped)
+    free (dawg->arc);
+  free (dawg);
+}
+
+/* Print the program name and error message MESSAGE, which is a
+   printf-style format string with optional args.  If ERRNUM is
+   nonzero, print its corresponding system error message.  Exit with
+   status STATUS if it is nonzero.  This function was written by David
+   MacKenzie <djm@gnu.ai.mit.edu>.  */
+
+static void
+error (int status, int errnum, const char *message,...)
+{
+  va_list args;
+
+  fflush (stdout);
+  fprintf (stderr, "%s: ", program_name);
+
+  va_start (args, message);
+  vfprintf (stderr, message, args);
+  va_end (args);
+
+  if (errnum)
+    fprintf (stderr, ": %s", strerror (errnum));
+  putc ('\n', stderr);
+  fflush (stderr);
+  if (status)
+    exit (status);
+}
+
+/* Allocate SIZE bytes of memory dynamically, with error checking,
+   returning a pointer to that memory.  */
+
+static void *
+xmalloc (size_t size)
+{
+  void *ptr = malloc (size);
+
+  if (!ptr)
+    error (EXIT_FAILURE, 0, "virtual memory exhausted");
+  return ptr;
+}
+
+/* Change the size of an allocated block of memory *PTR to SIZE bytes,
+   with error checking, returning the new pointer.  If PTR is NULL,
+   run `xmalloc'.  */
+
+static void *
+xrealloc (void *ptr, size_t size)
+{
+  if (!ptr)
+    return xmalloc (size);
+  ptr = realloc (ptr, size);
+  if (!ptr)
+    error (EXIT_FAILURE, 0, "virtual memory exhausted");
+  return ptr;
+}
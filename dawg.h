@@ -0,0 +1,92 @@
+/* dawg.h -- header for dawg.c.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* The first bytes of a dictionary compiled as a word graph, and the
+   version of the format written by `dawg_write'.  */
+#define DAWG_MAGIC "GNUSDAWG"
+#define DAWG_VERSION 1
+
+/* The parts of an arc, which is a `uint32_t': the character it is
+   labeled with, whether it is the last arc of its state, whether the
+   state it leads to ends a word, and the index of that state's first
+   arc (zero for a state with none).  */
+#define DAWG_LABEL(arc) ((arc) & 0xff)
+#define DAWG_LAST 0x100
+#define DAWG_FINAL 0x200
+#define DAWG_TARGET(arc) ((arc) >> 10)
+
+/* Arcs beyond this many cannot be pointed to.  */
+#define DAWG_MAX_ARCS (1UL << 22)
+
+/* The header of a word graph compiled by `dawg_write'.  It is
+   followed by the arcs.  */
+struct dawg_header
+  {
+    char magic[8];		/* `DAWG_MAGIC', without the NUL.  */
+    uint32_t version;		/* `DAWG_VERSION'.  */
+    uint32_t byte_order;	/* `0x01020304' as the writer saw it.  */
+    uint32_t arcs;		/* Number of arcs.  */
+    uint32_t root;		/* Index of the start state's first
+				   arc.  */
+    uint32_t count;		/* Number of words.  */
+    uint32_t checksum;		/* `dict_checksum' of the arcs.  */
+  };
+
+/* A set of words as a minimal acyclic word graph: a trie whose equal
+   subtrees have been merged, so that words share their endings as
+   well as their beginnings.  A state is the run of its arcs, sorted
+   by label, the last marked with `DAWG_LAST'; the graph is nothing
+   but the array of arcs, four bytes each.  Arc zero is unused, so
+   that zero can stand for the state with no arcs.
+
+   The graph is built from words added in order, each state being
+   merged with an equal one already built (if any) as soon as no more
+   words can reach it.  A graph mapped from a compiled file points
+   into the mapping.  */
+struct dawg
+  {
+    uint32_t *arc;		/* The arcs.  */
+    uint32_t arcs;		/* Number of arcs, including arc
+				   zero.  */
+    uint32_t root;		/* Index of the start state's first
+				   arc.  */
+    uint32_t count;		/* Number of words.  */
+    uint32_t start[256];	/* For each character, the arc from the
+				   start state labeled with it, or
+				   zero; most words would otherwise
+				   take a walk along these.  */
+    uint32_t mem;		/* Number of arcs allocated.  */
+    struct dawg_builder *build;	/* What is kept while words are
+				   added, or NULL.  */
+    int mapped;			/* Whether `arc' is in a mapping.  */
+  };
+typedef struct dawg dawg_t;
+
+dawg_t *dawg_make (void);
+dawg_t *dawg_map (char *, size_t, const char *);
+int dawg_find (dawg_t *, const char *, int);
+long dawg_enumerate (dawg_t *, const char *, int,
+		     void (*) (const char *, int, void *), void *);
+void dawg_add (dawg_t *, const char *, int);
+void dawg_finish (dawg_t *);
+void dawg_free (dawg_t *);
+void dawg_write (dawg_t *, const char *);
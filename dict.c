@@ -0,0 +1,733 @@
+/* dict.c -- look up words without Ispell.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+   This is the dictionary of the builtin engine (--engine=builtin).
+   It is loaded from a plain word list, one word per line, of the
+   kind Ispell accepts as a personal dictionary, or mapped from a
+   file compiled from such a list by `dict_write' (--compile-dict).
+   A compiled file is an image of the table itself, so mapping it
+   involves no parsing and no allocation per word.
+
+   The words may instead be kept as a word graph (--dict-format=dawg),
+   which shares their beginnings and endings and so takes a fraction
+   of the memory of the table and pool, at some cost in lookup time;
+   it too can be compiled and mapped.  */
+
+/* Local headers.  */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dict.h"
+#include "dawg.h"
+
+/* System headers.  */
+
+#include <sys/types.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else /* not HAVE_STRING_H */
+#include <strings.h>
+#endif /* not HAVE_STRING_H */
+
+#ifndef EXIT_FAILURE
+#define EXIT_FAILURE 1
+#endif
+
+/* Number of slots in a new table.  */
+#define INITIAL_SIZE 1024
+
+static void *xmalloc (size_t);
+static void *xrealloc (void *, size_t);
+static void error (int, int, const char *,...);
+static int compare_entries (const void *, const void *);
+static void grow (dict_t *);
+static void place (dict_t *, struct dict_slot);
+static dict_t *load (const char *, int);
+static dict_t *map_file (const char *, int);
+
+/* The name of the executable this process comes from.  This should be
+   set by the caller.  */
+extern char *program_name;
+
+/* Make an empty dictionary and return it.  */
+
+dict_t *
+dict_make (void)
+{
+  dict_t *dict = xmalloc (sizeof *dict);
+
+  dict->size = INITIAL_SIZE;
+  dict->count = 0;
+  dict->slot = xmalloc (dict->size * sizeof *dict->slot);
+  memset (dict->slot, 0, dict->size * sizeof *dict->slot);
+  dict->pool_len = 0;
+  dict->pool = xmalloc (dict->pool_mem = 4096);
+  dict->map = NULL;
+  dict->map_len = 0;
+  dict->dawg = NULL;
+
+  return dict;
+}
+
+/* Return the hash of the LEN characters at WORD (32-bit FNV-1a).  */
+
+uint32_t
+dict_hash (const char *word, int len)
+{
+  uint32_t hash = 2166136261U;
+  int pos;
+
+  for (pos = 0; pos < len; pos++)
+    {
+      hash ^= (unsigned char) word[pos];
+      hash *= 16777619U;
+    }
+
+  return hash;
+}
+
+/* Return nonzero if the LEN characters at WORD are, exactly, a word
+   in *DICT.  */
+
+int
+dict_find (dict_t * dict, const char *word, int len)
+{
+  uint32_t mask = dict->size - 1;
+  uint32_t hash;
+  uint32_t pos;
+  uint32_t dist;
+
+  if (dict->dawg)
+    return dawg_find (dict->dawg, word, len);
+  if (len > DICT_MAX_WORD)
+    return 0;
+
+  hash = dict_hash (word, len);
+  for (pos = hash & mask, dist = 0; dict->slot[pos].word;
+       pos = (pos + 1) & mask, dist++)
+    {
+      /* Had WORD been here, it would have displaced this one.  */
+      if (((pos - dict->slot[pos].hash) & mask) < dist)
+	return 0;
+
+      if (dict->slot[pos].hash == hash)
+	{
+	  const char *entry = dict->pool + dict->slot[pos].word - 1;
+
+	  if ((unsigned char) entry[0] == len
+	      && !memcmp (entry + 1, word, len))
+	    return 1;
+	}
+    }
+
+  return 0;
+}
+
+/* Add the LEN characters at WORD to *DICT, unless they are already
+   there.  */
+
+void
+dict_add (dict_t * dict, const char *word, int len)
+{
+  struct dict_slot entry;
+
+  if (len <= 0 || len > DICT_MAX_WORD || dict_find (dict, word, len))
+    return;
+
+  if ((dict->count + 1) * 2 > dict->size)
+    grow (dict);
+
+  if (dict->pool_len + len + 1 > dict->pool_mem)
+    dict->pool = xrealloc (dict->pool, dict->pool_mem *= 2);
+  dict->pool[dict->pool_len] = len;
+  memcpy (dict->pool + dict->pool_len + 1, word, len);
+
+  entry.hash = dict_hash (word, len);
+  entry.word = dict->pool_len + 1;
+  place (dict, entry);
+
+  dict->pool_len += len + 1;
+  dict->count++;
+}
+
+/* Put ENTRY in its place in the table of *DICT, which must have an
+   empty slot.  Walk from its home slot, and whenever a word is
+   found that is nearer its own home slot than ENTRY is, put ENTRY
+   there and go on to find a place for the word displaced.  */
+
+static void
+place (dict_t * dict, struct dict_slot entry)
+{
+  uint32_t mask = dict->size - 1;
+  uint32_t pos = entry.hash & mask;
+  uint32_t dist = 0;
+
+  while (dict->slot[pos].word)
+    {
+      uint32_t their_dist = (pos - dict->slot[pos].hash) & mask;
+
+      if (their_dist < dist)
+	{
+	  struct dict_slot displaced = dict->slot[pos];
+
+	  dict->slot[pos] = entry;
+	  entry = displaced;
+	  dist = their_dist;
+	}
+
+      pos = (pos + 1) & mask;
+      dist++;
+    }
+
+  dict->slot[pos] = entry;
+}
+
+/* Double the number of slots in *DICT, moving every word to its place
+   in the bigger table.  */
+
+static void
+grow (dict_t * dict)
+{
+  struct dict_slot *old = dict->slot;
+  uint32_t old_size = dict->size;
+  uint32_t i;
+
+  dict->size *= 2;
+  dict->slot = xmalloc (dict->size * sizeof *dict->slot);
+  memset (dict->slot, 0, dict->size * sizeof *dict->slot);
+
+  for (i = 0; i < old_size; i++)
+    if (old[i].word)
+      place (dict, old[i]);
+
+  free (old);
+}
+
+/* Return nonzero if the LEN characters at WORD are spelled correctly
+   according to *DICT.  As with Ispell, a word in the dictionary may
+   also be written capitalized or all in capitals, and a capitalized
+   word may also be written all in capitals; any other change of case
+   makes it a misspelling.  */
+
+int
+dict_check (dict_t * dict, const char *word, int len)
+{
+  char copy[DICT_MAX_WORD];
+  int lower = 0;		/* Lower case letters after the first.  */
+  int upper = 0;		/* Upper case letters after the first.  */
+  int pos;
+
+  if (dict_find (dict, word, len))
+    return 1;
+  if (len > DICT_MAX_WORD)
+    return 0;
+
+  for (pos = 1; pos < len; pos++)
+    if (islower ((unsigned char) word[pos]))
+      lower++;
+    else if (isupper ((unsigned char) word[pos]))
+      upper++;
+
+  if (!isupper ((unsigned char) word[0]) || (lower && upper))
+    return 0;
+
+  /* Capitalized, or all capitals: try it all in lower case.  */
+  for (pos = 0; pos < len; pos++)
+    copy[pos] = tolower ((unsigned char) word[pos]);
+  if (dict_find (dict, copy, len))
+    return 1;
+
+  /* All capitals: try it capitalized.  */
+  if (upper)
+    {
+      copy[0] = word[0];
+      return dict_find (dict, copy, len);
+    }
+
+  return 0;
+}
+
+/* Load the dictionary in the file FILE and return it.  If FILE is a
+   compiled dictionary, map it with `dict_map'.  Otherwise it is a
+   word list, one word per line; anything after a `/' on a line
+   (Ispell's affix flags) or after white space (such as how often the
+   word is used, for `--suggest') is ignored.
+   Exit with an error if the file cannot be read.  */
+
+dict_t *
+dict_load (const char *file)
+{
+  return load (file, EXIT_FAILURE);
+}
+
+/* Load the dictionary in the file FILE as `dict_load' does, but if it
+   cannot be read, or is a compiled dictionary `dict_map' would not
+   take, print why and return NULL.  */
+
+dict_t *
+dict_try_load (const char *file)
+{
+  return load (file, 0);
+}
+
+/* Load the dictionary in the file FILE for `dict_load' and
+   `dict_try_load'.  If it cannot be, print why, and exit with STATUS
+   if it is nonzero or return NULL.  */
+
+static dict_t *
+load (const char *file, int status)
+{
+  dict_t *dict;
+  FILE *stream;
+  struct stat stat_buf;
+  char *text;
+  size_t len;
+  size_t pos = 0;
+
+  if (dict_is_compiled (file))
+    return map_file (file, status);
+
+  stream = fopen (file, "r");
+  if (!stream)
+    {
+      error (status, errno, "%s: cannot open", file);
+      return NULL;
+    }
+  if (fstat (fileno (stream), &stat_buf) == -1)
+    {
+      error (status, errno, "%s: stat error", file);
+      fclose (stream);
+      return NULL;
+    }
+
+  text = xmalloc (stat_buf.st_size + 1);
+  len = fread (text, 1, stat_buf.st_size, stream);
+  if (ferror (stream))
+    {
+      error (status, errno, "%s: read error", file);
+      fclose (stream);
+      free (text);
+      return NULL;
+    }
+  fclose (stream);
+
+  dict = dict_make ();
+
+  while (pos < len)
+    {
+      size_t start = pos;
+      size_t end;
+
+      while (pos < len && text[pos] != '\n')
+	pos++;
+      for (end = start; end < pos && text[end] != '/'
+	   && !isspace ((unsigned char) text[end]); end++);
+
+      dict_add (dict, text + start, end - start);
+      pos++;
+    }
+
+  free (text);
+  return dict;
+}
+
+/* Return nonzero if the file FILE is a compiled dictionary, judging
+   by its first bytes.  */
+
+int
+dict_is_compiled (const char *file)
+{
+  char magic[sizeof DICT_MAGIC - 1];
+  FILE *stream = fopen (file, "r");
+  int compiled;
+
+  if (!stream)
+    return 0;
+  compiled = (fread (magic, 1, sizeof magic, stream) == sizeof magic
+	      && (!memcmp (magic, DICT_MAGIC, sizeof magic)
+		  || !memcmp (magic, DAWG_MAGIC, sizeof magic)));
+  fclose (stream);
+
+  return compiled;
+}
+
+/* Return a checksum of the LEN bytes at DATA, which must be aligned
+   for and a multiple in length of a `uint32_t' (32-bit FNV-1a, taken
+   a word rather than a byte at a time).  */
+
+uint32_t
+dict_checksum (const void *data, size_t len)
+{
+  const uint32_t *word = data;
+  uint32_t sum = 2166136261U;
+  size_t i;
+
+  for (i = 0; i < len / sizeof *word; i++)
+    {
+      sum ^= word[i];
+      sum *= 16777619U;
+    }
+
+  return sum;
+}
+
+/* Write *DICT to the file FILE as a compiled dictionary, which
+   `dict_map' can use as it is.  The file is written under a
+   temporary name and then renamed, so that a reader never sees half
+   of it.  Exit with an error on failure.  */
+
+void
+dict_write (dict_t * dict, const char *file)
+{
+  struct dict_header header;
+  size_t table_len = dict->size * sizeof *dict->slot;
+  size_t pool_len = (dict->pool_len + 3) & ~(size_t) 3;
+  char *image;
+  char *temp;
+  FILE *stream;
+
+  if (dict->dawg)
+    {
+      dawg_write (dict->dawg, file);
+      return;
+    }
+
+  /* Build the table and padded pool in one block to checksum it.  */
+  image = xmalloc (table_len + pool_len);
+  memcpy (image, dict->slot, table_len);
+  memset (image + table_len, 0, pool_len);
+  memcpy (image + table_len, dict->pool, dict->pool_len);
+
+  memset (&header, 0, sizeof header);
+  memcpy (header.magic, DICT_MAGIC, sizeof header.magic);
+  header.version = DICT_VERSION;
+  header.byte_order = 0x01020304;
+  header.size = dict->size;
+  header.count = dict->count;
+  header.pool_len = dict->pool_len;
+  header.checksum = dict_checksum (image, table_len + pool_len);
+
+  temp = xmalloc (strlen (file) + sizeof ".tmp");
+  strcpy (temp, file);
+  strcat (temp, ".tmp");
+
+  stream = fopen (temp, "wb");
+  if (!stream)
+    error (EXIT_FAILURE, errno, "%s: cannot create", temp);
+  if (fwrite (&header, sizeof header, 1, stream) != 1
+      || fwrite (image, 1, table_len + pool_len, stream)
+      != table_len + pool_len
+      || fclose (stream) == EOF)
+    error (EXIT_FAILURE, errno, "%s: write error", temp);
+  if (rename (temp, file) == -1)
+    error (EXIT_FAILURE, errno, "%s: cannot rename to %s", temp, file);
+
+  free (temp);
+  free (image);
+}
+
+/* Map the compiled dictionary in the file FILE (written by
+   `dict_write', as a table or as a word graph) and return it.  Exit
+   with an error if the file cannot be mapped, or is not a compiled
+   dictionary of the version and byte order we understand, or fails
+   its checksum.  */
+
+dict_t *
+dict_map (const char *file)
+{
+  return map_file (file, EXIT_FAILURE);
+}
+
+/* Map the compiled dictionary in the file FILE for `dict_map' and
+   `dict_try_load'.  If it cannot be, print why, and exit with STATUS
+   if it is nonzero or return NULL.  */
+
+static dict_t *
+map_file (const char *file, int status)
+{
+  dict_t *dict;
+  struct dict_header header;
+  struct stat stat_buf;
+  size_t table_len;
+  size_t pool_len;
+  const char *problem = NULL;
+  char *map;
+  int desc;
+
+  desc = open (file, O_RDONLY);
+  if (desc == -1)
+    {
+      error (status, errno, "%s: cannot open", file);
+      return NULL;
+    }
+  if (fstat (desc, &stat_buf) == -1)
+    {
+      error (status, errno, "%s: stat error", file);
+      close (desc);
+      return NULL;
+    }
+  if (stat_buf.st_size < sizeof header)
+    {
+      error (status, 0, "%s: not a compiled dictionary", file);
+      close (desc);
+      return NULL;
+    }
+
+  map = mmap (NULL, stat_buf.st_size, PROT_READ, MAP_SHARED, desc, 0);
+  if (map == MAP_FAILED)
+    {
+      error (status, errno, "%s: cannot map", file);
+      close (desc);
+      return NULL;
+    }
+  close (desc);
+
+  if (!memcmp (map, DAWG_MAGIC, sizeof header.magic))
+    {
+      dawg_t *dawg = dawg_map (map, stat_buf.st_size, file);
+
+      if (!dawg)
+	{
+	  munmap (map, stat_buf.st_size);
+	  if (status)
+	    exit (status);
+	  return NULL;
+	}
+      dict = xmalloc (sizeof *dict);
+      dict->map = map;
+      dict->map_len = stat_buf.st_size;
+      dict->dawg = dawg;
+      dict->slot = NULL;
+      dict->size = 0;
+      dict->count = dict->dawg->count;
+      dict->pool = NULL;
+      dict->pool_len = 0;
+      dict->pool_mem = 0;
+      return dict;
+    }
+
+  memcpy (&header, map, sizeof header);
+  table_len = (size_t) header.size * sizeof (struct dict_slot);
+  pool_len = ((size_t) header.pool_len + 3) & ~(size_t) 3;
+  if (memcmp (header.magic, DICT_MAGIC, sizeof header.magic))
+    problem = "not a compiled dictionary";
+  else if (header.byte_order != 0x01020304)
+    problem = "compiled on a machine of different byte order";
+  else if (header.version != DICT_VERSION)
+    {
+      munmap (map, stat_buf.st_size);
+      error (status, 0, "%s: compiled dictionary version %lu, "
+	     "expected %d; recompile it", file,
+	     (unsigned long) header.version, DICT_VERSION);
+      return NULL;
+    }
+  else if (!header.size || (header.size & (header.size - 1))
+	   || header.count >= header.size
+	   || stat_buf.st_size != sizeof header + table_len + pool_len
+	   || dict_checksum (map + sizeof header, table_len + pool_len)
+	   != header.checksum)
+    problem = "compiled dictionary is corrupt";
+  if (problem)
+    {
+      munmap (map, stat_buf.st_size);
+      error (status, 0, "%s: %s", file, problem);
+      return NULL;
+    }
+
+  dict = xmalloc (sizeof *dict);
+  dict->map = map;
+  dict->map_len = stat_buf.st_size;
+  dict->dawg = NULL;
+  dict->slot = (struct dict_slot *) (map + sizeof header);
+  dict->size = header.size;
+  dict->count = header.count;
+  dict->pool = map + sizeof header + table_len;
+  dict->pool_len = header.pool_len;
+  dict->pool_mem = 0;
+
+  return dict;
+}
+
+/* Put the words of *DICT, which must not be mapped, into a word graph
+   and free its table and pool.  */
+
+void
+dict_make_dawg (dict_t * dict)
+{
+  const char **entry = xmalloc (dict->count * sizeof *entry);
+  size_t pos;
+  uint32_t i = 0;
+
+  /* Each word in the pool is a length byte followed by its
+     characters.  */
+  for (pos = 0; pos < dict->pool_len;
+       pos += 1 + (unsigned char) dict->pool[pos])
+    entry[i++] = dict->pool + pos;
+  qsort (entry, dict->count, sizeof *entry, compare_entries);
+
+  dict->dawg = dawg_make ();
+  for (i = 0; i < dict->count; i++)
+    dawg_add (dict->dawg, entry[i] + 1, (unsigned char) entry[i][0]);
+  dawg_finish (dict->dawg);
+
+  free (entry);
+  free (dict->slot);
+  free (dict->pool);
+  dict->slot = NULL;
+  dict->size = 0;
+  dict->pool = NULL;
+  dict->pool_len = 0;
+  dict->pool_mem = 0;
+}
+
+/* Compare the words of the pool entries pointed to by A and B, in
+   the order of their bytes, taken as unsigned.  */
+
+static int
+compare_entries (const void *a, const void *b)
+{
+  const unsigned char *x = *(const unsigned char *const *) a;
+  const unsigned char *y = *(const unsigned char *const *) b;
+  int diff = memcmp (x + 1, y + 1, x[0] < y[0] ? x[0] : y[0]);
+
+  return diff ? diff : x[0] - y[0];
+}
+
+/* Call FN with each word in *DICT that begins with the LEN characters
+   at PREFIX, with its length and ARG, and return how many there
+   were.  The words come in order from a word graph, and otherwise in
+   the order they were added.  */
+
+long
+dict_enumerate (dict_t * dict, const char *prefix, int len,
+		void (*fn) (const char *, int, void *), void *arg)
+{
+  long count = 0;
+  size_t pos;
+
+  if (dict->dawg)
+    return dawg_enumerate (dict->dawg, prefix, len, fn, arg);
+
+  for (pos = 0; pos < dict->pool_len;
+       pos += 1 + (unsigned char) dict->pool[pos])
+    {
+      int word_len = (unsigned char) dict->pool[pos];
+
+      if (word_len >= len && !memcmp (dict->pool + pos + 1, prefix, len))
+	{
+	  fn (dict->pool + pos + 1, word_len, arg);
+	  count++;
+	}
+    }
+  return count;
+}
+
+/* Return how many bytes the words of *DICT take, in its table and
+   pool or its word graph.  */
+
+size_t
+dict_size (dict_t * dict)
+{
+  if (dict->dawg)
+    return dict->dawg->arcs * sizeof *dict->dawg->arc;
+  return dict->size * sizeof *dict->slot + dict->pool_len;
+}
+
+/* Free *DICT and all it holds, unmapping its file if it was mapped.  */
+
+void
+dict_free (dict_t * dict)
+{
+  if (dict->dawg)
+    dawg_free (dict->dawg);
+  if (dict->map)
+    munmap (dict->map, dict->map_len);
+  else
+    {
+      free (dict->slot);
+      free (dict->pool);
+    }
+  free (dict);
+}
+
+/* Print the program name and error message MESSAGE, which is a
+   printf-style format string with optional args.  If ERRNUM is
+   nonzero, print its corresponding system error message.  Exit with
+   status STATUS if it is nonzero.  This function was written by David
+   MacKenzie <djm@gnu.ai.mit.edu>.  */
+
+static void
+error (int status, int errnum, const char *message,...)
+{
+  va_list args;
+
+  fflush (stdout);
+  fprintf (stderr, "%s: ", program_name);
+
+  va_start (args, message);
+  vfprintf (stderr, message, args);
+  va_end (args);
+
+  if (errnum)
+    fprintf (stderr, ": %s", strerror (errnum));
+  putc ('\n', stderr);
+  fflush (stderr);
+  if (status)
+    exit (status);
+}
+
+/* Allocate SIZE bytes of memory dynamically, with error checking,
+   returning a pointer to that memory.  */
+
+static void *
+xmalloc (size_t size)
+{
+  void *ptr = malloc (size);
+
+  if (!ptr)
+    error (EXIT_FAILURE, 0, "virtual memory exhausted");
+  return ptr;
+}
+
+/* Change the size of an allocated block of memory *PTR to SIZE bytes,
+   with error checking, returning the new pointer.  If PTR is NULL,
+   run `xmalloc'.  */
+
+static void *
+xrealloc (void *ptr, size_t size)
+{
+  if (!ptr)
+    return xmalloc (size);
+  ptr = realloc (ptr, size);
+  if (!ptr)
+    error (EXIT_FAILURE, 0, "virtual memory exhausted");
+  return ptr;
+}
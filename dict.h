@@ -0,0 +1,105 @@
+/* dict.h -- header for dict.c.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Words longer than this are never in a dictionary.  */
+#define DICT_MAX_WORD 255
+
+/* The first bytes of a compiled dictionary, and the version of the
+   format written by `dict_write'.  */
+#define DICT_MAGIC "GNUSDICT"
+#define DICT_VERSION 1
+
+/* Ways a dictionary can keep its words in memory.  */
+enum dict_format
+  {
+    DICT_HASH,			/* A hash table of the words.  */
+    DICT_DAWG			/* A minimal acyclic word graph (see
+				   dawg.h).  */
+  };
+
+/* The header of a compiled dictionary.  It is followed by the table
+   (`size' slots) and then by the pool (`pool_len' bytes, padded to a
+   multiple of four).  */
+struct dict_header
+  {
+    char magic[8];		/* `DICT_MAGIC', without the NUL.  */
+    uint32_t version;		/* `DICT_VERSION'.  */
+    uint32_t byte_order;	/* `0x01020304' as the writer saw it.  */
+    uint32_t size;		/* Number of slots.  */
+    uint32_t count;		/* Number of words.  */
+    uint32_t pool_len;		/* Bytes of the pool in use.  */
+    uint32_t checksum;		/* `dict_checksum' of the table and
+				   pool.  */
+  };
+
+/* One slot of the hash table.  */
+struct dict_slot
+  {
+    uint32_t hash;		/* The hash of the word.  */
+    uint32_t word;		/* Offset of the word in the pool plus
+				   one, or zero if the slot is empty.  */
+  };
+
+/* A set of correctly spelled words, kept in an open-addressing hash
+   table with linear probing.  The table is never more than half
+   full, and a slot holds the word's hash, so a probe usually touches
+   one cache line of the table and one of the pool.  Words are placed
+   Robin Hood fashion: a word may take the slot of one that is nearer
+   its home slot, which keeps probe sequences short and lets a search
+   for a missing word stop early.
+
+   A dictionary loaded from a compiled file points into the file's
+   mapping and cannot have words added.  So does one turned into a
+   word graph by `dict_make_dawg', whose table and pool are then
+   gone; every lookup goes to the graph.  */
+struct dict
+  {
+    struct dict_slot *slot;	/* The table.  */
+    uint32_t size;		/* Number of slots; a power of two.  */
+    uint32_t count;		/* Number of words in the table.  */
+    char *pool;			/* Each word as a length byte followed
+				   by its characters.  */
+    size_t pool_len;		/* Bytes of the pool in use.  */
+    size_t pool_mem;		/* Bytes of the pool allocated.  */
+    void *map;			/* The mapped compiled file, or NULL.  */
+    size_t map_len;		/* Its length.  */
+    struct dawg *dawg;		/* The word graph holding the words
+				   instead, or NULL.  */
+  };
+typedef struct dict dict_t;
+
+dict_t *dict_load (const char *);
+dict_t *dict_make (void);
+dict_t *dict_map (const char *);
+dict_t *dict_try_load (const char *);
+int dict_check (dict_t *, const char *, int);
+int dict_find (dict_t *, const char *, int);
+int dict_is_compiled (const char *);
+long dict_enumerate (dict_t *, const char *, int,
+		     void (*) (const char *, int, void *), void *);
+size_t dict_size (dict_t *);
+uint32_t dict_checksum (const void *, size_t);
+uint32_t dict_hash (const char *, int);
+void dict_add (dict_t *, const char *, int);
+void dict_free (dict_t *);
+void dict_make_dawg (dict_t *);
+void dict_write (dict_t *, const char *);
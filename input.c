@@ -0,0 +1,383 @@
+/* input.c -- read the files to be checked.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+   Regular files are mapped, and each line is handed out as a pointer
+   into the mapping, found with `memchr'; nothing is copied.  Pipes,
+   terminals, the standard input and files that cannot be mapped are
+   read from the stream's descriptor into a buffer instead, so that
+   the caller can ask whether a whole line has arrived before waiting
+   for one.  Either way the caller sees the same lines.  A compressed
+   file is read as a stream from the pipe it is unpacked into (see
+   unpack.c).
+
+   A line longer than `INPUT_PIECE' is handed out in pieces, each cut
+   after a character that cannot be part of a word, so that no word
+   is split.  A run of that many letters leaves no choice: it is cut,
+   and the rest of the run is skipped, so that the word it makes is
+   checked once, cut short, rather than as several words.
+   The pages of a mapped file that have been read are dropped as it
+   goes on, so that neither way needs memory in proportion to the
+   length of a line or of the file.  */
+
+/* Local headers.  */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "str.h"
+#include "input.h"
+
+/* System headers.  */
+
+#include <sys/types.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else /* not HAVE_STRING_H */
+#include <strings.h>
+#endif /* not HAVE_STRING_H */
+
+/* Whether the end of the standard input has been reached.  The
+   descriptor is read directly, and a terminal would go on giving
+   lines after an EOF, so this stands in for the stream's EOF
+   indicator: once one `-' has read it all, the others see EOF.  Only
+   one `-' of a run reads the standard input (the others are given no
+   stream; see `open_input'), so no two threads ever touch this.  */
+static int stdin_eof = 0;
+
+static int cut_piece (const char *, int);
+static int word_byte (int);
+static void drop_read (input_t *);
+
+/* Set up *INPUT to read from the file stream *STREAM, a line at a
+   time into the string *BUF (created by `str_make').  */
+
+void
+input_stream (input_t * input, FILE * stream, str_t * buf)
+{
+  input->stream = stream;
+  input->desc = stream ? desc_buf_make (fileno (stream)) : NULL;
+  input->buf = buf;
+  input->map = NULL;
+  input->unmap = 0;
+  input->map_len = input->pos = input->dropped = 0;
+  input->keep = input->cut = input->continued = input->skip = 0;
+  input->ended = 0;
+  input->eof = stream == stdin && stdin_eof;
+  input->unpack = NULL;
+}
+
+/* Try to set up *INPUT to read the regular file FILE by mapping it.
+   Return zero if successful, or else `errno' (FILE could not be
+   opened) or -1 (it could not be mapped; read it with a stream).
+   *BUF is used as with `input_stream' only to make the two
+   interchangeable.  */
+
+int
+input_map (input_t * input, const char *file, str_t * buf)
+{
+  struct stat stat_buf;
+  int desc;
+
+  input_stream (input, NULL, buf);
+
+  desc = open (file, O_RDONLY);
+  if (desc == -1)
+    return errno;
+
+  if (fstat (desc, &stat_buf) == -1 || !S_ISREG (stat_buf.st_mode)
+      || stat_buf.st_size != (size_t) stat_buf.st_size)
+    {
+      close (desc);
+      return -1;
+    }
+
+  /* There is nothing to map in an empty file.  */
+  if (!stat_buf.st_size)
+    {
+      close (desc);
+      input->eof = 1;
+      return 0;
+    }
+
+  input->map = mmap (NULL, stat_buf.st_size, PROT_READ, MAP_PRIVATE,
+		     desc, 0);
+  close (desc);
+  if (input->map == MAP_FAILED)
+    {
+      input->map = NULL;
+      return -1;
+    }
+  input->map_len = stat_buf.st_size;
+  input->unmap = 1;
+
+#ifdef MADV_SEQUENTIAL
+  madvise (input->map, input->map_len, MADV_SEQUENTIAL);
+#endif
+
+  return 0;
+}
+
+/* Set up *INPUT to read the LEN characters at TEXT as if they were a
+   mapped file.  They must stay as they are until `input_close'.  */
+
+void
+input_mem (input_t * input, char *text, size_t len)
+{
+  input_stream (input, NULL, NULL);
+  input->map = text;
+  input->map_len = len;
+  input->eof = !len;
+}
+
+/* Get the next line from *INPUT (set up by `input_stream',
+   `input_map' or `input_mem'), setting *TEXT to point to it and *LEN
+   to its length, which includes the newline unless it is the last
+   line and has none.  A line longer than `INPUT_PIECE' comes a piece
+   at a time instead, INPUT->cut telling whether the line goes on and
+   INPUT->continued whether a piece is not the first of its line; of a
+   run of more letters than that, only the first piece's are handed
+   out.  The line stays valid until the next call.  Return `ADD_LINE_OK' for a
+   line, or `ADD_LINE_EOF' if there are no more lines.  */
+
+int
+input_line (input_t * input, char **text, int *len)
+{
+  str_t *buf;
+  int skip;
+
+  input->continued = input->cut;
+  if (input->eof && !input->keep)
+    return ADD_LINE_EOF;
+
+  if (input->map)
+    {
+      char *start;
+      size_t left;
+      char *newline;
+
+      if (input->skip)
+	{
+	  while (input->pos < input->map_len
+		 && word_byte (input->map[input->pos]))
+	    input->pos++;
+	  input->skip = 0;
+	  if (input->pos >= input->map_len)
+	    {
+	      input->eof = 1;
+	      return ADD_LINE_EOF;
+	    }
+	}
+
+      start = input->map + input->pos;
+      left = input->map_len - input->pos;
+      input->cut = 0;
+      if (left > INPUT_PIECE)
+	{
+	  newline = memchr (start, '\n', INPUT_PIECE);
+	  if (!newline)
+	    {
+	      left = cut_piece (start, INPUT_PIECE);
+	      input->cut = 1;
+	      input->skip = word_byte (start[left - 1]);
+	    }
+	}
+      else
+	newline = memchr (start, '\n', left);
+
+      *text = start;
+      *len = newline ? newline - start + 1 : left;
+      if (input->unmap && input->pos - input->dropped >= INPUT_DROP)
+	drop_read (input);
+      input->pos += *len;
+      if (input->pos >= input->map_len)
+	input->eof = 1;
+      return ADD_LINE_OK;
+    }
+
+  /* Begin with what was left over when the last piece was cut.  */
+  buf = input->buf;
+  if (input->keep)
+    {
+      memmove (buf->str, buf->str + buf->len, input->keep);
+      buf->len = input->keep;
+      input->keep = 0;
+    }
+  else
+    buf = input->buf = str_make (buf);
+
+  /* Should the last piece have been cut inside a word, skip the rest
+     of it, reading on for as long as it goes.  */
+  skip = input->skip;
+  for (;;)
+    {
+      int run;
+
+      input->cut = 0;
+      input->skip = 0;
+      while (!input->eof
+	     && !desc_buf_take_upto (input->desc, buf,
+				     INPUT_PIECE - buf->len))
+	{
+	  if (buf->len >= INPUT_PIECE)
+	    {
+	      int piece = cut_piece (buf->str, buf->len);
+
+	      input->keep = buf->len - piece;
+	      buf->len = piece;
+	      input->cut = 1;
+	      input->skip = word_byte (buf->str[piece - 1]);
+	      break;
+	    }
+	  if (input->ended || desc_buf_fill (input->desc) <= 0)
+	    {
+	      input->eof = 1;
+	      if (input->stream == stdin)
+		stdin_eof = 1;
+	    }
+	}
+      if (!skip)
+	break;
+
+      for (run = 0; run < buf->len && word_byte (buf->str[run]); run++);
+      if (run < buf->len || !input->cut)
+	{
+	  memmove (buf->str, buf->str + run,
+		   buf->len - run + input->keep);
+	  buf->len -= run;
+	  break;
+	}
+
+      /* The whole piece was more of the word.  */
+      memmove (buf->str, buf->str + buf->len, input->keep);
+      buf->len = input->keep;
+      input->keep = 0;
+    }
+
+  if (!buf->len)
+    return ADD_LINE_EOF;
+  *text = buf->str;
+  *len = buf->len;
+  return ADD_LINE_OK;
+}
+
+/* Return where to cut the LEN characters at TEXT, the beginning of a
+   line too long to hand out whole: after the last blank in their
+   second half, or failing that after the last character that can be
+   part of no word, or failing that at LEN, inside a word.  */
+
+static int
+cut_piece (const char *text, int len)
+{
+  int i;
+
+  for (i = len; i > len / 2; i--)
+    if (text[i - 1] == ' ' || text[i - 1] == '\t')
+      return i;
+  for (i = len; i > 0; i--)
+    if (!word_byte (text[i - 1]))
+      return i;
+  return len;
+}
+
+/* Return nonzero if the character C may be part of a word, as far as
+   cutting lines into pieces goes.  Bytes beyond ASCII are taken for
+   letters, so that a character of several bytes is not cut.  */
+
+static int
+word_byte (int c)
+{
+  c = (unsigned char) c;
+  return c >= 0x80 || isalpha (c) || c == '\'';
+}
+
+/* Drop from memory the pages of the file mapped by *INPUT that lie
+   wholly before the line being handed out, which would otherwise stay
+   counted against the process until the file is closed.  Should one be
+   touched again, it is read from the file again.  */
+
+static void
+drop_read (input_t * input)
+{
+  static long page;
+  size_t end;
+
+  if (!page)
+    page = sysconf (_SC_PAGESIZE);
+  if (page <= 0)
+    return;
+
+  end = input->pos - input->pos % page;
+#ifdef MADV_DONTNEED
+  if (end > input->dropped)
+    {
+      madvise (input->map + input->dropped, end - input->dropped,
+	       MADV_DONTNEED);
+      input->dropped = end;
+    }
+#endif
+}
+
+/* Return nonzero if the next call to `input_line' for *INPUT would
+   not wait for more to be read: the file is mapped, its end has been
+   reached, or a whole line is already in the buffer.  */
+
+int
+input_ready (input_t * input)
+{
+  return input->map || input->eof || input->ended
+    || desc_buf_has_line (input->desc);
+}
+
+/* Read once from the descriptor of *INPUT, a stream, into its buffer,
+   as `input_line' would when it needed more.  Call this only when the
+   descriptor has something to read (or is at its end), or it will
+   wait.  */
+
+void
+input_fill (input_t * input)
+{
+  if (!input->desc || input->ended || input->eof)
+    return;
+  if (desc_buf_fill (input->desc) <= 0)
+    input->ended = 1;
+}
+
+/* Stop reading from *INPUT, unmapping the file if it was mapped.  The
+   stream, if any, is left for the caller to close.  */
+
+void
+input_close (input_t * input)
+{
+  if (input->unmap)
+    munmap (input->map, input->map_len);
+  input->map = NULL;
+  input->unmap = 0;
+  desc_buf_free (input->desc);
+  input->desc = NULL;
+}
@@ -0,0 +1,74 @@
+/* input.h -- header for input.c.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+/* The longest piece of a line `input_line' hands out at once.  A
+   longer line is cut, between words, into pieces no longer than this,
+   so that a file of one enormous line can be checked in little
+   memory.  */
+#define INPUT_PIECE 4096
+
+/* How far a mapped file is read before the pages already read are
+   dropped from memory.  */
+#define INPUT_DROP (1 << 22)
+
+/* A file being read line by line.  A regular file is mapped into
+   memory and its lines are handed out where they lie; anything else
+   is read through a stream into a buffer.  */
+struct input
+  {
+    FILE *stream;		/* The stream, or NULL if mapped.  */
+    desc_buf_t *desc;		/* Read-ahead for the stream's
+				   descriptor, which is read directly
+				   so that whether a line is at hand
+				   can be told.  */
+    str_t *buf;			/* Holds the line read from `stream'.  */
+    char *map;			/* The mapped file (or the text given
+				   to `input_mem'), or NULL.  */
+    int unmap;			/* Whether `map' is to be unmapped.  */
+    size_t map_len;		/* Its length.  */
+    size_t pos;			/* Offset of the next line in `map'.  */
+    size_t dropped;		/* How much of `map' has been dropped
+				   from memory.  */
+    int keep;			/* How many characters at the end of
+				   `buf' are the rest of a line cut
+				   short, to begin the next piece.  */
+    int cut;			/* Whether the piece last handed out
+				   was cut short of the end of its
+				   line.  */
+    int continued;		/* Whether it continues a line the one
+				   before it was cut from.  */
+    int skip;			/* Whether it was cut inside a word,
+				   the rest of which is to be
+				   skipped.  */
+    int ended;			/* Whether the descriptor has given
+				   EOF (or an error), leaving only what
+				   is in `desc'.  */
+    int eof;			/* Whether the end has been reached.  */
+    struct unpack *unpack;	/* The thread unpacking a compressed
+				   file into `stream', or NULL.  */
+  };
+typedef struct input input_t;
+
+int input_line (input_t *, char **, int *);
+int input_map (input_t *, const char *, str_t *);
+int input_ready (input_t *);
+void input_close (input_t *);
+void input_fill (input_t *);
+void input_mem (input_t *, char *, size_t);
+void input_stream (input_t *, FILE *, str_t *);
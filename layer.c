@@ -0,0 +1,400 @@
+/* layer.c -- stacks of dictionaries, reloaded as their files change.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+   A stack is a base dictionary with others on top of it (a team's
+   words, a project's, a user's), any of which may be edited while a
+   server (`--serve') goes on checking with the rest.  Each version of
+   the stack is a small array of pointers to the dictionaries; a
+   dictionary reloaded is put in a copy of the array, and the others
+   are shared, not copied.
+
+   Readers are never made to wait.  Each counts itself in one of two
+   counters while it uses a version, the one the low bit of `epoch'
+   says.  The one thread reloading publishes the new version, then
+   moves the epoch on and waits for the counter of the old epoch to
+   drain, twice over, so that both counters have been empty since the
+   new version was published.  Any reader counted after that has the
+   new version, so the old one is no longer in use and can be freed;
+   this is sleepable RCU.  */
+
+/* Local headers.  */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dict.h"
+#include "layer.h"
+
+/* System headers.  */
+
+#include <sys/types.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else /* not HAVE_STRING_H */
+#include <strings.h>
+#endif /* not HAVE_STRING_H */
+
+/* Learn of changes to the files with inotify where there is one, and
+   by looking at them every `POLL_INTERVAL' seconds elsewhere.  */
+#ifdef __linux__
+#define USE_INOTIFY 1
+#include <sys/inotify.h>
+#endif /* __linux__ */
+
+#ifndef EXIT_FAILURE
+#define EXIT_FAILURE 1
+#endif
+
+/* Seconds between looks at the files without inotify.  */
+#define POLL_INTERVAL 1
+
+/* Microseconds to sleep between looks at a counter of readers.  */
+#define DRAIN_INTERVAL 1000
+
+extern char *program_name;
+
+static void *xmalloc (size_t);
+static void error (int, int, const char *,...);
+static dict_t *load (layers_t *, int, int);
+static int changed (layers_t *, int, struct stat *);
+static int same_stat (struct stat *, struct stat *);
+static void synchronize (layers_t *);
+static void *watch (void *);
+
+/* Make an empty stack, whose dictionaries that are word lists are to
+   be kept as FORMAT says, and return it.  */
+
+layers_t *
+layers_make (enum dict_format format)
+{
+  layers_t *layers = xmalloc (sizeof *layers);
+
+  layers->count = 0;
+  layers->format = format;
+  layers->current = xmalloc (sizeof *layers->current);
+  layers->current->count = 0;
+  layers->current->version = 0;
+  layers->epoch = 0;
+  layers->readers[0] = layers->readers[1] = 0;
+  pthread_mutex_init (&layers->lock, NULL);
+
+  return layers;
+}
+
+/* Load the dictionary in the file FILE onto the top of *LAYERS.  Exit
+   with an error if it cannot be loaded, or there are too many.  Must
+   be done before there are readers.  */
+
+void
+layers_add (layers_t * layers, const char *file)
+{
+  int i = layers->count;
+
+  if (i == LAYER_MAX)
+    error (EXIT_FAILURE, 0, "%s: more than %d dictionaries", file,
+	   LAYER_MAX);
+  layers->file[i] = xmalloc (strlen (file) + 1);
+  strcpy (layers->file[i], file);
+  layers->current->dict[i] = load (layers, i, EXIT_FAILURE);
+  layers->current->count = ++layers->count;
+}
+
+/* Return the version of *LAYERS published, which stays as it is,
+   dictionaries and all, until it is given back with `layers_leave'
+   and TICKET.  Never waits.  */
+
+struct layer_stack *
+layers_enter (layers_t * layers, int *ticket)
+{
+  *ticket = __atomic_load_n (&layers->epoch, __ATOMIC_SEQ_CST) & 1;
+  __atomic_add_fetch (&layers->readers[*ticket], 1, __ATOMIC_SEQ_CST);
+  return __atomic_load_n (&layers->current, __ATOMIC_SEQ_CST);
+}
+
+/* Give back the version of *LAYERS taken by `layers_enter' with
+   TICKET.  */
+
+void
+layers_leave (layers_t * layers, int ticket)
+{
+  __atomic_sub_fetch (&layers->readers[ticket], 1, __ATOMIC_SEQ_CST);
+}
+
+/* Return nonzero if the LEN characters at WORD are in any of the
+   dictionaries of *STACK from the FROMth up, in any case
+   `dict_check' allows.  */
+
+int
+layers_check (struct layer_stack *stack, int from, const char *word,
+	      int len)
+{
+  int i;
+
+  for (i = from; i < stack->count; i++)
+    if (dict_check (stack->dict[i], word, len))
+      return 1;
+  return 0;
+}
+
+/* Load the Ith dictionary of *LAYERS again from its file, publish a
+   version of the stack with it in place of the old, and free the old
+   once no reader has it.  Return nonzero if it was reloaded; if it
+   could not be, print why and keep the old one.  */
+
+int
+layers_reload (layers_t * layers, int i)
+{
+  struct layer_stack *old;
+  struct layer_stack *stack;
+  dict_t *dict = load (layers, i, 0);
+
+  if (!dict)
+    {
+      error (0, 0, "%s: keeping the dictionary loaded before",
+	     layers->file[i]);
+      return 0;
+    }
+
+  pthread_mutex_lock (&layers->lock);
+  old = layers->current;
+  stack = xmalloc (sizeof *stack);
+  *stack = *old;
+  stack->dict[i] = dict;
+  stack->version = old->version + 1;
+  __atomic_store_n (&layers->current, stack, __ATOMIC_SEQ_CST);
+  synchronize (layers);
+  pthread_mutex_unlock (&layers->lock);
+
+  dict_free (old->dict[i]);
+  free (old);
+  return 1;
+}
+
+/* Reload the dictionaries of *LAYERS as their files change, from a
+   thread of its own, for as long as the program runs.  */
+
+void
+layers_watch (layers_t * layers)
+{
+  pthread_attr_t attr;
+  pthread_t thread;
+  int err;
+
+  pthread_attr_init (&attr);
+  pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+  err = pthread_create (&thread, &attr, watch, layers);
+  if (err)
+    error (EXIT_FAILURE, err, "cannot start a thread");
+  pthread_attr_destroy (&attr);
+}
+
+/* Wait until every reader of *LAYERS that might have had the version
+   published before the last has given it back.  */
+
+static void
+synchronize (layers_t * layers)
+{
+  int pass;
+
+  for (pass = 0; pass < 2; pass++)
+    {
+      unsigned int old = __atomic_fetch_add (&layers->epoch, 1,
+					     __ATOMIC_SEQ_CST) & 1;
+
+      while (__atomic_load_n (&layers->readers[old], __ATOMIC_SEQ_CST))
+	usleep (DRAIN_INTERVAL);
+    }
+}
+
+/* Load the Ith dictionary of *LAYERS from its file, noting what the
+   file was, and return it.  If it cannot be, print why, and exit with
+   STATUS if it is nonzero or return NULL.  */
+
+static dict_t *
+load (layers_t * layers, int i, int status)
+{
+  const char *file = layers->file[i];
+  dict_t *dict;
+
+  if (stat (file, &layers->stat[i]) == -1)
+    memset (&layers->stat[i], 0, sizeof layers->stat[i]);
+  dict = status ? dict_load (file) : dict_try_load (file);
+  if (dict && layers->format == DICT_DAWG && !dict->map)
+    dict_make_dawg (dict);
+  return dict;
+}
+
+/* Return nonzero if the file of the Ith dictionary of *LAYERS is not
+   what it was when loaded, and put what it is in *NOW.  A file being
+   replaced may be missing for a moment; it is reloaded once it is
+   back.  */
+
+static int
+changed (layers_t * layers, int i, struct stat *now)
+{
+  struct stat *was = &layers->stat[i];
+
+  if (stat (layers->file[i], now) == -1)
+    return 0;
+  return !same_stat (now, was);
+}
+
+/* Return nonzero if *A and *B are of the same file, unchanged.  */
+
+static int
+same_stat (struct stat *a, struct stat *b)
+{
+  return (a->st_ino == b->st_ino && a->st_dev == b->st_dev
+	  && a->st_size == b->st_size
+	  && a->st_mtim.tv_sec == b->st_mtim.tv_sec
+	  && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec);
+}
+
+/* Reload the dictionaries of the stack ARG as their files change;
+   the body of the thread `layers_watch' starts.  With inotify, each
+   directory holding one is watched, rather than the file, so that a
+   file replaced by renaming another over it (as `--compile-dict' and
+   many editors do) is seen, and a dictionary is reloaded when its
+   file is closed after writing or renamed into place.  Otherwise the
+   files are looked at every `POLL_INTERVAL' seconds, and one is
+   reloaded once it has changed and then stayed as it is for a look,
+   so that it is not read half written.  */
+
+static void *
+watch (void *arg)
+{
+  layers_t *layers = arg;
+  struct stat seen[LAYER_MAX];
+  struct stat now;
+  int i;
+#ifdef USE_INOTIFY
+  char events[4096]
+    __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+  int watch[LAYER_MAX];
+  const char *name[LAYER_MAX];
+  int desc = inotify_init1 (IN_CLOEXEC);
+
+  if (desc == -1)
+    error (0, errno, "cannot watch the dictionaries for changes");
+  for (i = 0; desc != -1 && i < layers->count; i++)
+    {
+      char *dir = xmalloc (strlen (layers->file[i]) + 2);
+      char *slash;
+
+      strcpy (dir, layers->file[i]);
+      slash = strrchr (dir, '/');
+      name[i] = slash ? layers->file[i] + (slash - dir) + 1
+	: layers->file[i];
+      if (!slash)
+	strcpy (dir, ".");
+      else
+	slash[slash == dir] = '\0';
+      watch[i] = inotify_add_watch (desc, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+      if (watch[i] == -1)
+	error (0, errno, "%s: cannot watch for changes", dir);
+      free (dir);
+    }
+
+  while (desc != -1)
+    {
+      ssize_t len = read (desc, events, sizeof events);
+      char *pos;
+
+      if (len <= 0)
+	{
+	  if (len == -1 && errno == EINTR)
+	    continue;
+	  error (0, errno, "cannot watch the dictionaries for changes");
+	  break;
+	}
+      for (pos = events; pos < events + len;
+	   pos += sizeof (struct inotify_event)
+	   + ((struct inotify_event *) pos)->len)
+	{
+	  struct inotify_event *event = (struct inotify_event *) pos;
+
+	  for (i = 0; i < layers->count; i++)
+	    if (event->len && event->wd == watch[i]
+		&& !strcmp (event->name, name[i])
+		&& changed (layers, i, &now))
+	      layers_reload (layers, i);
+	}
+    }
+
+  /* Without inotify, fall back on looking.  */
+#endif /* USE_INOTIFY */
+
+  memcpy (seen, layers->stat, sizeof seen);
+  while (1)
+    {
+      sleep (POLL_INTERVAL);
+      for (i = 0; i < layers->count; i++)
+	{
+	  if (changed (layers, i, &now) && same_stat (&now, &seen[i]))
+	    layers_reload (layers, i);
+	  seen[i] = now;
+	}
+    }
+
+  return NULL;
+}
+
+/* Print the program name and error message MESSAGE, which is a
+   printf-style format string with optional args.  If ERRNUM is
+   nonzero, print its corresponding system error message.  Exit with
+   status STATUS if it is nonzero.  This function was written by David
+   MacKenzie <djm@gnu.ai.mit.edu>.  */
+
+static void
+error (int status, int errnum, const char *message,...)
+{
+  va_list args;
+
+  fflush (stdout);
+  fprintf (stderr, "%s: ", program_name);
+
+  va_start (args, message);
+  vfprintf (stderr, message, args);
+  va_end (args);
+
+  if (errnum)
+    fprintf (stderr, ": %s", strerror (errnum));
+  putc ('\n', stderr);
+  fflush (stderr);
+  if (status)
+    exit (status);
+}
+
+static void *
+xmalloc (size_t size)
+{
+  void *ptr = malloc (size);
+
+  if (!ptr)
+    error (EXIT_FAILURE, 0, "virtual memory exhausted");
+  return ptr;
+}
@@ -0,0 +1,65 @@
+/* layer.h -- header for layer.c.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* The most dictionaries that may be stacked.  */
+#define LAYER_MAX 16
+
+/* One version of a stack of dictionaries.  It is never changed once
+   published: reloading a dictionary makes a new version, which
+   shares every other dictionary with the old one.  */
+struct layer_stack
+  {
+    int count;			/* Number of dictionaries.  */
+    dict_t *dict[LAYER_MAX];	/* The dictionaries, bottom first.  */
+    unsigned long version;	/* How many reloads there were before
+				   it; zero for the one first loaded.  */
+  };
+
+/* A stack of dictionaries loaded from files, which a word is in if it
+   is in any of them, reloaded as the files change.  Readers take the
+   version published with `layers_enter' and give it back with
+   `layers_leave', and never wait.  A reload publishes a new version
+   and then, as RCU does, waits until no reader can still have the old
+   one before freeing what only the old one had.  */
+struct layers
+  {
+    char *file[LAYER_MAX];	/* The file of each dictionary.  */
+    struct stat stat[LAYER_MAX];	/* What each was when loaded.  */
+    int count;			/* Number of them.  */
+    enum dict_format format;	/* How to keep those that are word
+				   lists.  */
+    struct layer_stack *current;	/* The version published.  */
+    unsigned int epoch;		/* Which of `readers' new readers are
+				   counted in, in its low bit.  */
+    unsigned int readers[2];	/* Readers in each.  */
+    pthread_mutex_t lock;	/* Held while reloading.  */
+  };
+typedef struct layers layers_t;
+
+int layers_check (struct layer_stack *, int, const char *, int);
+int layers_reload (layers_t *, int);
+layers_t *layers_make (enum dict_format);
+struct layer_stack *layers_enter (layers_t *, int *);
+void layers_add (layers_t *, const char *);
+void layers_leave (layers_t *, int);
+void layers_watch (layers_t *);
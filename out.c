@@ -0,0 +1,219 @@
+/* out.c -- write the misspellings to the standard output.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+   Output is gathered in a buffer of `OUT_BUF_SIZE' bytes and written
+   with one system call when it fills, or when the caller flushes it:
+   at the end of each file, before waiting for input, and before
+   anything is printed on the standard error output.  Stdio is not
+   used, so that a terminal does not cost a `write' a line, and
+   something too big for the buffer is written with `writev' straight
+   from where it lies.  Only one thread may write output.  */
+
+/* Local headers.  */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "out.h"
+
+/* System headers.  */
+
+#include <sys/types.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else /* not HAVE_STRING_H */
+#include <strings.h>
+#endif /* not HAVE_STRING_H */
+
+#ifndef STDOUT_FILENO
+#define STDOUT_FILENO 1
+#endif
+
+#ifndef EXIT_SUCCESS
+#define EXIT_SUCCESS 0
+#define EXIT_FAILURE 1
+#endif /* EXIT_SUCCESS */
+
+extern char *program_name;
+
+static void error (int status, int errnum, const char *message,...);
+static void write_all (struct iovec *, int);
+
+/* The output not yet written.  */
+static char out_buf[OUT_BUF_SIZE];
+static int out_len = 0;
+
+/* The two-digit numbers, for formatting two digits at a time.  */
+static const char digit_pairs[] =
+  "00010203040506070809101112131415161718192021222324252627282930313233"
+  "34353637383940414243444546474849505152535455565758596061626364656667"
+  "6869707172737475767778798081828384858687888990919293949596979899";
+
+/* Write NUM in decimal to the `NUMBER_SIZE' bytes at BUF, without a
+   NUL, and return how many characters it took.  */
+
+int
+format_number (char *buf, long num)
+{
+  char digits[NUMBER_SIZE];
+  char *pos = digits + sizeof digits;
+  unsigned long left = num < 0 ? -(unsigned long) num : (unsigned long) num;
+  int len;
+
+  while (left >= 100)
+    {
+      int pair = left % 100 * 2;
+
+      left /= 100;
+      *--pos = digit_pairs[pair + 1];
+      *--pos = digit_pairs[pair];
+    }
+  if (left >= 10)
+    {
+      *--pos = digit_pairs[left * 2 + 1];
+      *--pos = digit_pairs[left * 2];
+    }
+  else
+    *--pos = '0' + left;
+  if (num < 0)
+    *--pos = '-';
+
+  len = digits + sizeof digits - pos;
+  memcpy (buf, pos, len);
+  return len;
+}
+
+/* Output the LEN characters at TEXT.  */
+
+void
+out_mem (const char *text, int len)
+{
+  struct iovec iov[2];
+
+  if (out_len + len <= OUT_BUF_SIZE)
+    {
+      memcpy (out_buf + out_len, text, len);
+      out_len += len;
+      return;
+    }
+
+  /* Write what is held and TEXT together, without copying TEXT.  */
+  iov[0].iov_base = out_buf;
+  iov[0].iov_len = out_len;
+  iov[1].iov_base = (char *) text;
+  iov[1].iov_len = len;
+  out_len = 0;
+  write_all (iov, 2);
+}
+
+/* Output the character C.  */
+
+void
+out_char (int c)
+{
+  if (out_len == OUT_BUF_SIZE)
+    out_flush ();
+  out_buf[out_len++] = c;
+}
+
+/* Output NUM in decimal.  */
+
+void
+out_number (long num)
+{
+  if (out_len + NUMBER_SIZE > OUT_BUF_SIZE)
+    out_flush ();
+  out_len += format_number (out_buf + out_len, num);
+}
+
+/* Write all the output held so far.  */
+
+void
+out_flush (void)
+{
+  struct iovec iov;
+
+  if (!out_len)
+    return;
+  iov.iov_base = out_buf;
+  iov.iov_len = out_len;
+  out_len = 0;
+  write_all (&iov, 1);
+}
+
+/* Write the COUNT pieces at IOV to the standard output, whatever it
+   takes.  IOV is used up in the process.  */
+
+static void
+write_all (struct iovec *iov, int count)
+{
+  while (count)
+    {
+      ssize_t written = writev (STDOUT_FILENO, iov, count);
+
+      if (written < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  error (EXIT_FAILURE, errno, "write error");
+	}
+
+      for (; count && (size_t) written >= iov->iov_len; iov++, count--)
+	written -= iov->iov_len;
+      if (count)
+	{
+	  iov->iov_base = (char *) iov->iov_base + written;
+	  iov->iov_len -= written;
+	}
+    }
+}
+
+/* Print the program name and error message MESSAGE, which is a
+   printf-style format string with optional args.  If ERRNUM is
+   nonzero, print its corresponding system error message.  Exit with
+   status STATUS if it is nonzero.  This function was written by David
+   MacKenzie <djm@gnu.ai.mit.edu>.  Unlike the others, it cannot
+   flush the output, as that is what went wrong.  */
+
+static void
+error (int status, int errnum, const char *message,...)
+{
+  va_list args;
+
+  fprintf (stderr, "%s: ", program_name);
+
+  va_start (args, message);
+  vfprintf (stderr, message, args);
+  va_end (args);
+
+  if (errnum)
+    fprintf (stderr, ": %s", strerror (errnum));
+  putc ('\n', stderr);
+  fflush (stderr);
+  if (status)
+    exit (status);
+}
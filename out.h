@@ -0,0 +1,30 @@
+/* out.h -- header for out.c.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+/* Bytes of output held before they are written.  */
+#define OUT_BUF_SIZE 65536
+
+/* Room enough for any number `format_number' is given.  */
+#define NUMBER_SIZE 24
+
+int format_number (char *, long);
+void out_char (int);
+void out_flush (void);
+void out_mem (const char *, int);
+void out_number (long);
@@ -0,0 +1,478 @@
+/* results.c -- remember the results of checking whole files.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+   Most files checked are often the same from one run to the next, so
+   with `--cache-dir', the misspellings found in a file are kept in a
+   cache directory, under the hash of its contents and of the options
+   that affect what is found, and are printed from there the next
+   time without the file being checked.
+
+   An entry is written under a temporary name and renamed, so any
+   number of runs may share a directory.  Each time an entry is used,
+   its modification time is set to the present, and when the entries
+   take more than their share of space, those used least recently are
+   removed.  */
+
+/* Local headers.  */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "str.h"
+#include "results.h"
+
+/* System headers.  */
+
+#include <sys/types.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else /* not HAVE_STRING_H */
+#include <strings.h>
+#endif /* not HAVE_STRING_H */
+
+#ifndef EXIT_FAILURE
+#define EXIT_FAILURE 1
+#endif
+
+/* The constants of the hash (those of xxHash64).  */
+#define PRIME1 11400714785074694791ULL
+#define PRIME2 14029467366897019727ULL
+#define PRIME3 1609587929392839161ULL
+#define PRIME4 9650029242287828579ULL
+#define PRIME5 2870177450012600261ULL
+
+/* Rotate the 64 bits of X left by N.  */
+#define ROTATE(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+/* When trimming, remove entries until they take no more than this
+   fraction of the cap, so as not to trim again at once.  */
+#define TRIM_TO 0.9
+
+/* An entry found when trimming.  */
+struct entry
+  {
+    char *name;			/* Its file name.  */
+    off_t size;			/* Its size.  */
+    time_t used;		/* When it was last used.  */
+  };
+
+static void *xmalloc (size_t);
+static void *xrealloc (void *, size_t);
+static char *xstrdup (const char *);
+static void error (int, int, const char *,...);
+static char *entry_name (results_t *, const char *, size_t);
+static int older (const void *, const void *);
+static uint64_t round64 (uint64_t, uint64_t);
+static uint64_t read64 (const unsigned char *);
+
+/* The name of the executable this process comes from.  This should be
+   set by the caller.  */
+extern char *program_name;
+
+/* Use the directory DIR, creating it if need be, to keep the results
+   of checking files with OPTIONS (text that differs whenever the
+   results could), and keep the entries there to CAP bytes.  Return
+   NULL, having said why, if DIR cannot be used.  */
+
+results_t *
+results_open (const char *dir, const char *options, off_t cap)
+{
+  results_t *results;
+  struct stat stat_buf;
+
+  if (mkdir (dir, 0777) == -1 && errno != EEXIST)
+    {
+      error (0, errno, "%s: cannot create", dir);
+      return NULL;
+    }
+  if (stat (dir, &stat_buf) == -1 || !S_ISDIR (stat_buf.st_mode))
+    {
+      error (0, errno, "%s: not a directory", dir);
+      return NULL;
+    }
+
+  results = xmalloc (sizeof *results);
+  results->dir = xstrdup (dir);
+  results->options = xstrdup (options);
+  results->seed = results_hash (options, strlen (options), 0);
+  results->cap = cap;
+  results->stored = 0;
+
+  return results;
+}
+
+/* If *RESULTS has an entry for the LEN bytes at TEXT, append what it
+   holds to *OUT, mark it used, and return nonzero.  */
+
+int
+results_fetch (results_t * results, const char *text, size_t len,
+	       str_t * out)
+{
+  char *name = entry_name (results, text, len);
+  char head[sizeof RESULTS_MAGIC + 64];
+  struct stat stat_buf;
+  size_t head_len;
+  size_t options_len = strlen (results->options);
+  char *body;
+  int desc;
+  int found = 0;
+
+  desc = open (name, O_RDONLY);
+  if (desc == -1)
+    {
+      free (name);
+      return 0;
+    }
+
+  /* The entry must be for text of the same length checked with the
+     same options, so that a clash of hashes does no harm.  */
+  head_len = sprintf (head, "%s%lu\n", RESULTS_MAGIC, (unsigned long) len);
+  if (fstat (desc, &stat_buf) == 0
+      && stat_buf.st_size >= head_len + options_len
+      && stat_buf.st_size == (size_t) stat_buf.st_size)
+    {
+      body = xmalloc (stat_buf.st_size);
+      if (read (desc, body, stat_buf.st_size) == stat_buf.st_size
+	  && !memcmp (body, head, head_len)
+	  && !memcmp (body + head_len, results->options, options_len))
+	{
+	  str_add_mem (out, body + head_len + options_len,
+		       stat_buf.st_size - head_len - options_len);
+	  found = 1;
+	}
+      free (body);
+    }
+  close (desc);
+
+  if (found)
+    utimes (name, NULL);
+  free (name);
+
+  return found;
+}
+
+/* Keep the BODY_LEN bytes at BODY in *RESULTS as the results for the
+   LEN bytes at TEXT.  A cache is only a cache, so on failure just say
+   so.  */
+
+void
+results_store (results_t * results, const char *text, size_t len,
+	       const char *body, size_t body_len)
+{
+  char *name = entry_name (results, text, len);
+  char *temp = xmalloc (strlen (name) + 32);
+  FILE *stream;
+
+  sprintf (temp, "%s.%ld.tmp", name, (long) getpid ());
+  stream = fopen (temp, "wb");
+  if (!stream)
+    error (0, errno, "%s: cannot create", temp);
+  else if (fprintf (stream, "%s%lu\n%s", RESULTS_MAGIC,
+		    (unsigned long) len, results->options) < 0
+	   || fwrite (body, 1, body_len, stream) != body_len
+	   || fclose (stream) == EOF)
+    {
+      error (0, errno, "%s: write error", temp);
+      unlink (temp);
+    }
+  else if (rename (temp, name) == -1)
+    {
+      error (0, errno, "%s: cannot rename to %s", temp, name);
+      unlink (temp);
+    }
+  else
+    results->stored = 1;
+
+  free (temp);
+  free (name);
+}
+
+/* If entries were added to *RESULTS and the entries now take more
+   than its cap, remove those used least recently.  Only one run
+   trims a directory at a time; should another be at it, leave it
+   be.  */
+
+void
+results_trim (results_t * results)
+{
+  struct entry *entry = NULL;
+  struct dirent *dirent;
+  struct stat stat_buf;
+  DIR *dir;
+  char *path;
+  char *lock_name;
+  off_t total = 0;
+  int count = 0;
+  int mem = 0;
+  int lock;
+  int i;
+
+  if (!results->stored)
+    return;
+
+  path = xmalloc (strlen (results->dir) + NAME_MAX + 2);
+  lock_name = xmalloc (strlen (results->dir) + sizeof "/lock");
+  sprintf (lock_name, "%s/lock", results->dir);
+  lock = open (lock_name, O_RDONLY | O_CREAT, 0666);
+  if (lock == -1 || flock (lock, LOCK_EX | LOCK_NB) == -1)
+    goto done;
+
+  dir = opendir (results->dir);
+  if (!dir)
+    goto done;
+  while ((dirent = readdir (dir)))
+    {
+      sprintf (path, "%s/%s", results->dir, dirent->d_name);
+      if (!strcmp (dirent->d_name, "lock") || stat (path, &stat_buf) == -1
+	  || !S_ISREG (stat_buf.st_mode))
+	continue;
+
+      if (count == mem)
+	entry = xrealloc (entry, (mem = mem * 2 + 256) * sizeof *entry);
+      entry[count].name = xstrdup (dirent->d_name);
+      entry[count].size = stat_buf.st_size;
+      entry[count].used = stat_buf.st_mtime;
+      total += stat_buf.st_size;
+      count++;
+    }
+  closedir (dir);
+
+  if (total > results->cap)
+    {
+      qsort (entry, count, sizeof *entry, older);
+      for (i = 0; i < count && total > results->cap * TRIM_TO; i++)
+	{
+	  sprintf (path, "%s/%s", results->dir, entry[i].name);
+	  if (unlink (path) == 0)
+	    total -= entry[i].size;
+	}
+    }
+
+  for (i = 0; i < count; i++)
+    free (entry[i].name);
+  free (entry);
+
+done:
+  if (lock != -1)
+    close (lock);
+  free (lock_name);
+  free (path);
+}
+
+/* Return the hash of the LEN bytes at DATA, starting from SEED.  This
+   is xxHash64: fast, and good enough to tell files apart, though not
+   against someone set on making two files clash.  */
+
+uint64_t
+results_hash (const void *data, size_t len, uint64_t seed)
+{
+  const unsigned char *pos = data;
+  const unsigned char *end = pos + len;
+  uint64_t hash;
+
+  if (len >= 32)
+    {
+      uint64_t v1 = seed + PRIME1 + PRIME2;
+      uint64_t v2 = seed + PRIME2;
+      uint64_t v3 = seed;
+      uint64_t v4 = seed - PRIME1;
+
+      /* Four lanes, so that the multiplications overlap.  */
+      for (; pos + 32 <= end; pos += 32)
+	{
+	  v1 = round64 (v1, read64 (pos));
+	  v2 = round64 (v2, read64 (pos + 8));
+	  v3 = round64 (v3, read64 (pos + 16));
+	  v4 = round64 (v4, read64 (pos + 24));
+	}
+
+      hash = ROTATE (v1, 1) + ROTATE (v2, 7) + ROTATE (v3, 12)
+	+ ROTATE (v4, 18);
+      hash = (hash ^ round64 (0, v1)) * PRIME1 + PRIME4;
+      hash = (hash ^ round64 (0, v2)) * PRIME1 + PRIME4;
+      hash = (hash ^ round64 (0, v3)) * PRIME1 + PRIME4;
+      hash = (hash ^ round64 (0, v4)) * PRIME1 + PRIME4;
+    }
+  else
+    hash = seed + PRIME5;
+
+  hash += len;
+
+  for (; pos + 8 <= end; pos += 8)
+    {
+      hash ^= round64 (0, read64 (pos));
+      hash = ROTATE (hash, 27) * PRIME1 + PRIME4;
+    }
+  if (pos + 4 <= end)
+    {
+      hash ^= (uint64_t) (pos[0] | pos[1] << 8 | pos[2] << 16
+			  | (uint32_t) pos[3] << 24) * PRIME1;
+      hash = ROTATE (hash, 23) * PRIME2 + PRIME3;
+      pos += 4;
+    }
+  for (; pos < end; pos++)
+    {
+      hash ^= *pos * PRIME5;
+      hash = ROTATE (hash, 11) * PRIME1;
+    }
+
+  hash ^= hash >> 33;
+  hash *= PRIME2;
+  hash ^= hash >> 29;
+  hash *= PRIME3;
+  hash ^= hash >> 32;
+
+  return hash;
+}
+
+/* Return the file name of the entry of *RESULTS for the LEN bytes at
+   TEXT.  */
+
+static char *
+entry_name (results_t * results, const char *text, size_t len)
+{
+  char *name = xmalloc (strlen (results->dir) + 18);
+
+  sprintf (name, "%s/%016llx", results->dir,
+	   (unsigned long long) results_hash (text, len, results->seed));
+
+  return name;
+}
+
+/* Compare the entries at A and B for `qsort', the one used least
+   recently first.  */
+
+static int
+older (const void *a, const void *b)
+{
+  const struct entry *entry_a = a;
+  const struct entry *entry_b = b;
+
+  return (entry_a->used > entry_b->used) - (entry_a->used < entry_b->used);
+}
+
+/* Mix INPUT into the lane ACC of `results_hash'.  */
+
+static uint64_t
+round64 (uint64_t acc, uint64_t input)
+{
+  acc += input * PRIME2;
+  acc = ROTATE (acc, 31);
+  return acc * PRIME1;
+}
+
+/* Return the eight bytes at POS as a little-endian number.  */
+
+static uint64_t
+read64 (const unsigned char *pos)
+{
+  uint64_t value;
+
+#if defined (__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy (&value, pos, sizeof value);
+#else
+  int i;
+
+  for (value = 0, i = 7; i >= 0; i--)
+    value = value << 8 | pos[i];
+#endif
+
+  return value;
+}
+
+/* Print the program name and error message MESSAGE, which is a
+   printf-style format string with optional args.  If ERRNUM is
+   nonzero, print its corresponding system error message.  Exit with
+   status STATUS if it is nonzero.  This function was written by David
+   MacKenzie <djm@gnu.ai.mit.edu>.  */
+
+static void
+error (int status, int errnum, const char *message,...)
+{
+  va_list args;
+
+  fflush (stdout);
+  fprintf (stderr, "%s: ", program_name);
+
+  va_start (args, message);
+  vfprintf (stderr, message, args);
+  va_end (args);
+
+  if (errnum)
+    fprintf (stderr, ": %s", strerror (errnum));
+  putc ('\n', stderr);
+  fflush (stderr);
+  if (status)
+    exit (status);
+}
+
+/* Allocate SIZE bytes of memory dynamically, with error checking,
+   returning a pointer to that memory.  */
+
+static void *
+xmalloc (size_t size)
+{
+  void *ptr = malloc (size);
+
+  if (!ptr)
+    error (EXIT_FAILURE, 0, "virtual memory exhausted");
+  return ptr;
+}
+
+/* Change the size of an allocated block of memory *PTR to SIZE bytes,
+   with error checking, returning the new pointer.  If PTR is NULL,
+   run `xmalloc'.  */
+
+static void *
+xrealloc (void *ptr, size_t size)
+{
+  if (!ptr)
+    return xmalloc (size);
+  ptr = realloc (ptr, size);
+  if (!ptr)
+    error (EXIT_FAILURE, 0, "virtual memory exhausted");
+  return ptr;
+}
+
+/* Duplicate STR, returning an identical malloc'd string.  I first
+   just did this for error checking, calling `strdup', but the task is
+   so simple I decided to just do it here--it saves a call.  */
+
+static char *
+xstrdup (const char *str)
+{
+  size_t len = strlen (str) + 1;
+  void *new = xmalloc (len);
+
+  memcpy (new, (void *) str, len);
+
+  return (char *) new;
+}
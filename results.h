@@ -0,0 +1,45 @@
+/* results.h -- header for results.c.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* The first line of a cache entry, with the version of its format.  */
+#define RESULTS_MAGIC "GNU Spell results 1\n"
+
+/* A directory of the results of checking files (--cache-dir).  Each
+   entry is a file named for a hash of the contents checked and of
+   the options they were checked with.  */
+struct results
+  {
+    char *dir;			/* The directory.  */
+    char *options;		/* The options that affect the results,
+				   one per line.  */
+    uint64_t seed;		/* The hash of `options'.  */
+    off_t cap;			/* Most bytes the entries may take.  */
+    int stored;			/* Whether an entry has been added.  */
+  };
+typedef struct results results_t;
+
+int results_fetch (results_t *, const char *, size_t, str_t *);
+results_t *results_open (const char *, const char *, off_t);
+uint64_t results_hash (const void *, size_t, uint64_t);
+void results_store (results_t *, const char *, size_t, const char *,
+		    size_t);
+void results_trim (results_t *);
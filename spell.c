@@ -24,23 +24,40 @@
 #include "config.h"
 #endif
 
+#include "dict.h"
+#include "affix.h"
 #include "getopt.h"
 #include "str.h"
+#include "input.h"
+#include "layer.h"
+#include "out.h"
+#include "results.h"
+#include "stats.h"
+#include "suggest.h"
+#include "token.h"
+#include "unpack.h"
+#include "verdict.h"
 
 /* System headers.  */
 
 #include <sys/types.h>
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <memory.h>
+#include <pthread.h>
 #include <pwd.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/file.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <unistd.h>
 
 #ifdef HAVE_STRING_H
@@ -49,9 +66,36 @@
 #include <strings.h>
 #endif /* not HAVE_STRING_H */
 
+/* Wait on Ispell's pipes with epoll where there is one, and with
+   poll elsewhere.  */
+#ifdef __linux__
+#define USE_EPOLL 1
+#include <sys/epoll.h>
+#else /* not __linux__ */
+#include <poll.h>
+#endif /* not __linux__ */
+
+/* Default for `--cache-size'.  */
+#define DEFAULT_CACHE_SIZE (64L * 1024 * 1024)
+
+/* The most suggestions printed for a misspelled word (--suggest).  */
+#define SUGGEST_COUNT 5
+
 /* Always add at least this many bytes when extending the buffer.  */
 #define MIN_CHUNK 64
 
+/* Default number of lines that may be sent to Ispell before its
+   answer to the first of them has been read.  */
+#define DEFAULT_WINDOW 256
+
+/* How many bytes may be queued for Ispell, when its pipe is full,
+   before sending another line waits for it to take some.  */
+#define MAX_QUEUED (64 * 1024)
+
+/* How many files per worker may be checked ahead of the output with
+   --jobs.  */
+#define MAX_AHEAD 4
+
 #ifndef STDIN_FILENO
 #define STDIN_FILENO 0
 #define STDOUT_FILENO 1
@@ -62,11 +106,64 @@
 #define SIG_ERR (-1)
 #endif
 
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/* What a client and a server (--connect, --serve) say first, to be
+   sure they speak the same protocol.  */
+#define SERVE_PROTOCOL "spell 1"
+
+/* The most bytes a client may send in one message.  */
+#define SERVE_CHUNK 65536
+
 #ifndef EXIT_SUCCESS
 #define EXIT_SUCCESS 0
 #define EXIT_FAILURE 1
 #endif /* EXIT_SUCCESS */
 
+/* Word lists used by the builtin engine when no dictionary is
+   given.  */
+#ifndef WORD_LIST
+#define WORD_LIST "/usr/local/share/spell/words"
+#endif
+#ifndef BRITISH_WORD_LIST
+#define BRITISH_WORD_LIST "/usr/local/share/spell/british"
+#endif
+
+/* Ways of deciding whether words are spelled correctly.  */
+enum engine
+  {
+    ENGINE_ISPELL,		/* Ask Ispell, through a pipe.  */
+    ENGINE_BUILTIN		/* Look words up in `dict_layers'.  */
+  };
+
+/* A line whose misspelled words have not yet been printed, because
+   Ispell has not yet answered for it or for a line before it.  */
+struct pending
+  {
+    char *file;			/* The file the line came from.  */
+    int line;			/* Its line number in that file.  */
+    str_t *out;			/* Where its output goes; NULL for
+				   stdout.  */
+    int asked;			/* How many of its words were sent to
+				   Ispell, or -1 if the whole line was
+				   (`--no-word-cache').  */
+    uint64_t sent_at;		/* When it was sent, if `show_stats'.  */
+
+    /* The rest is used only when `word_verdicts' is, or the line has
+       a word in `stop_dict', and is kept from one use of the record
+       to the next.  */
+    str_t *text;		/* A copy of the line.  */
+    span_list_t spans;		/* The words in it.  */
+    int *ask;			/* For each word, which of those sent
+				   it is, or -1 if it was not sent.  */
+    int *sent;			/* For each word sent, the first word
+				   of the line it is.  */
+    char *verdict;		/* For each word, its `enum verdict'.  */
+    int mem;			/* The words these have room for.  */
+  };
+
 /* Used for communication through a pipe.  */
 struct pipe
   {
@@ -80,11 +177,118 @@ struct pipe
     int cout;			/* Output channel.  */
     int cerr;			/* Error channel (for writing).  */
 
-    fd_set error_set;		/* Descriptor set used to check for
-				   errors (contains perr).  */
+    int events;			/* The epoll instance watching pin,
+				   pout and perr, with `USE_EPOLL'.  */
+    int watch_out;		/* Whether it watches pout for room.  */
+
+    desc_buf_t *in_buf;		/* Read-ahead for pin.  */
+    desc_buf_t *err_buf;	/* Read-ahead for perr.  */
+    str_t *answer;		/* Line of Ispell's output being read.  */
+    str_t *nul_free;		/* Copy of a line with NULs blanked.  */
+    str_t *request;		/* The words of a line to be sent.  */
+    str_t *named;		/* Words Ispell named in an answer.  */
+    str_t *error_line;		/* Line of Ispell's errors being read.  */
+    str_t *queue;		/* What pout had no room for yet.  */
+    int queue_pos;		/* How much of `queue' has been
+				   written.  */
+
+    long words;			/* Words looked up in `word_verdicts'.  */
+    long hits;			/* Those that had a verdict there.  */
+    stats_t stats;		/* What was sent and answered, for
+				   `--stats'.  */
+    struct layer_stack *layers;	/* The version of `dict_layers' lines
+				   are being sent with, or NULL.  */
+
+    /* Lines in flight, oldest first.  `send_line' adds to the tail as
+       it writes lines, and `take_answers' removes from the head as
+       Ispell's answers come in and are printed.  A pipe is used by one
+       thread only, which does both in turn, so none of this is
+       locked.  */
+    struct pending *pending;	/* Ring of `window' records.  */
+    int head;			/* Index of the oldest record.  */
+    int count;			/* Number of records in the ring.  */
+    int answered;		/* Answers read so far for the oldest.  */
+    int agree;			/* Whether they were for the words
+				   sent.  */
   };
 typedef struct pipe pipe_t;
 
+/* Space reused from line to line when checking with the builtin
+   engine.  Each thread has its own.  */
+struct scratch
+  {
+    str_t *line;		/* Holds lines read from a stream.  */
+    span_list_t spans;		/* The words in it.  */
+  };
+
+/* What a thread checking files uses to do it.  */
+struct worker
+  {
+    pipe_t *pipe;		/* The pipe to its Ispell, or NULL for
+				   the builtin engine.  */
+    struct scratch scratch;	/* Its scratch space.  */
+    str_t *found;		/* The misspellings found in a file, for
+				   `file_results'.  */
+    stats_t stats;		/* What it did, for `--stats'.  */
+    struct layer_stack *layers;	/* The version of `dict_layers' it is
+				   checking a file with, or NULL.  */
+  };
+
+/* A file to be checked by the pool of workers run by `run_jobs'.  */
+struct job
+  {
+    char *file;			/* The file's name.  */
+    str_t *out;			/* The output for it.  */
+    const char *problem;	/* If it could not be opened, why.  */
+    int errnum;			/* The error number for `problem'.  */
+    int done;			/* Whether `out' is complete.  */
+  };
+
+/* Kinds of message between a client and a server (--connect,
+   --serve).  Each message is the kind, in a byte, then the length of
+   its data, in four bytes, most significant first, then the data.  A
+   client says hello, then sends each file: its name, its contents in
+   pieces, and the end.  The server answers each file with what was
+   found in it, then says it is done with it, and the client sends the
+   next.  */
+enum message
+  {
+    MESSAGE_HELLO = 'H',	/* `SERVE_PROTOCOL'.  */
+    MESSAGE_FILE = 'F',		/* The name of a file to check.  */
+    MESSAGE_DATA = 'D',		/* Some of its contents.  */
+    MESSAGE_END = 'E',		/* The end of its contents.  */
+    MESSAGE_FOUND = 'O',	/* The misspellings found, each on a line
+				   after its line number and `: '.  */
+    MESSAGE_ERROR = 'X',	/* Why the server will go no further.  */
+    MESSAGE_DONE = 'Z'		/* The file has been checked.  */
+  };
+
+/* The Ispells kept ready by `--serve', each checking for one client
+   at a time.  */
+struct pipe_pool
+  {
+    pipe_t *pipes;		/* The pipes to them.  */
+    char *busy;			/* Whether each is in use.  */
+    int count;			/* How many there are.  */
+    int clients;		/* Client threads still running.  */
+    pthread_mutex_t lock;	/* Protects `busy', `clients' and
+				   `run_stats'.  */
+    pthread_cond_t changed;	/* Signaled when one is freed.  */
+    pthread_cond_t gone;	/* Signaled when a client thread
+				   ends.  */
+  };
+
+/* The files to be checked by the pool, in command-line order.  */
+struct job_queue
+  {
+    struct job *job;		/* The jobs.  */
+    int count;			/* The number of jobs.  */
+    int next;			/* The first job not yet taken.  */
+    int flushed;		/* The number of jobs printed.  */
+    pthread_mutex_t lock;	/* Protects all of the above.  */
+    pthread_cond_t changed;	/* Signaled when any of it changes.  */
+  };
+
 #ifndef HAVE_STRERROR
 static char *strerror (int);
 #endif
@@ -96,31 +300,124 @@ static void *xrealloc (void *, size_t);
 static void error (int status, int errnum, const char *message,...);
 static void sig_chld (int);
 static void sig_pipe (int);
+static void sig_stop (int);
+static void *pool_worker (void *);
+static void *serve_client (void *);
+const char *open_input (char *, input_t *, str_t *, int *);
+void check_file (struct worker *, input_t *, char *, str_t *);
+void check_input (struct worker *, input_t *, char *, str_t *);
+void check_served (int, input_t *, char *, str_t *);
+void close_input (input_t *, char *);
+long count_lines (str_t *);
+void drain_pipe (pipe_t *);
+int find_sent (struct pending *, char *, int);
+void flush_queue (pipe_t *);
+void give_pipe (pipe_t *);
+int has_listed_word (pipe_t *, char *, int, span_list_t *);
+int has_8bit (const char *, int);
+int is_stop_word (const char *, int);
+int format_suggestions (char *, char *, int);
+void init_worker (struct worker *, pipe_t *);
+void load_affixes (void);
+void load_dict (void);
+void load_stop_list (void);
+static void add_stop_word (const char *, int, void *);
+static uint32_t stop_hash (const char *, int);
+void load_suggestions (void);
 void new_pipe (pipe_t *);
+void open_results (void);
+void open_word_cache (void);
 void parent (pipe_t *, int, char **);
-void read_file (pipe_t *, FILE *, char *);
-void read_ispell (pipe_t *, char *, int);
+int pipe_wait (pipe_t *, int);
+int print_pending (struct pending *);
+void print_results (str_t *, char *, str_t *);
+void print_derived (str_t *, char *, int, char *, int, char *, int);
+void print_line (str_t *, char *, int, char *, int, char *, int);
+void print_served (char *, str_t *);
+void print_word (str_t *, char *, int, char *, int);
+void queue_write (pipe_t *, struct iovec *, int);
+void read_file (pipe_t *, input_t *, char *, str_t *);
+void read_files (pipe_t *, int, char **);
+int read_ispell (pipe_t *, struct pending *);
 void read_ispell_errors (pipe_t *);
+int read_message (int, str_t *, long);
+int replay_results (int, char **);
+void report_cache (pipe_t *, int);
+void report_stats (pipe_t *, int);
+void run_client (int, char **);
 void run_ispell_in_child (pipe_t *);
+void run_jobs (pipe_t *, int, char **);
+void send_line (pipe_t *, char *, int, char *, int, str_t *);
+int send_message (int, int, const char *, long);
+void send_words (pipe_t *, struct pending *, char *, int);
+void serve (pipe_t *, int);
+void start_ispell (pipe_t *);
+pipe_t *start_ispells (int);
+void start_loop (pipe_t *);
+void take_answers (pipe_t *);
+pipe_t *take_pipe (void);
 
 /* Version of this program.  */
 //const char version[] = "version " VERSION;
 const char version[] = "version TEST";
+/* Values returned by `getopt_long' for options without a short
+   form.  */
+enum
+  {
+    WINDOW_OPTION = CHAR_MAX + 1,
+    ENGINE_OPTION,
+    COMPILE_DICT_OPTION,
+    NO_WORD_CACHE_OPTION,
+    CACHE_STATS_OPTION,
+    WORD_CACHE_OPTION,
+    CACHE_DIR_OPTION,
+    CACHE_SIZE_OPTION,
+    STATS_OPTION,
+    SERVE_OPTION,
+    CONNECT_OPTION,
+    SUGGEST_OPTION,
+    SUGGEST_PREFIX_OPTION,
+    AFFIX_FILE_OPTION,
+    AFFIXES_OPTION,
+    NO_AFFIXES_OPTION,
+    DICT_FORMAT_OPTION,
+    OVERLAY_OPTION
+  };
+
 /* Switch information for `getopt'.  */
 const struct option long_options[] =
 {
+  {"affix-file", required_argument, NULL, AFFIX_FILE_OPTION},
+  {"affixes", no_argument, NULL, AFFIXES_OPTION},
   {"all-chains", no_argument, NULL, 'l'},
   {"british", no_argument, NULL, 'b'},
+  {"cache-dir", required_argument, NULL, CACHE_DIR_OPTION},
+  {"cache-size", required_argument, NULL, CACHE_SIZE_OPTION},
+  {"cache-stats", no_argument, NULL, CACHE_STATS_OPTION},
+  {"compile-dict", required_argument, NULL, COMPILE_DICT_OPTION},
+  {"connect", required_argument, NULL, CONNECT_OPTION},
+  {"dict-format", required_argument, NULL, DICT_FORMAT_OPTION},
   {"dictionary", required_argument, NULL, 'd'},
+  {"engine", required_argument, NULL, ENGINE_OPTION},
   {"help", no_argument, NULL, 'h'},
   {"ispell", required_argument, NULL, 'i'},
   {"ispell-version", no_argument, NULL, 'I'},
+  {"jobs", required_argument, NULL, 'j'},
+  {"no-affixes", no_argument, NULL, NO_AFFIXES_OPTION},
+  {"no-word-cache", no_argument, NULL, NO_WORD_CACHE_OPTION},
   {"number", no_argument, NULL, 'n'},
+  {"overlay", required_argument, NULL, OVERLAY_OPTION},
   {"print-file-name", no_argument, NULL, 'o'},
   {"print-stems", no_argument, NULL, 'x'},
+  {"serve", required_argument, NULL, SERVE_OPTION},
+  {"stats", no_argument, NULL, STATS_OPTION},
   {"stop-list", required_argument, NULL, 's'},
+  {"suggest", no_argument, NULL, SUGGEST_OPTION},
+  {"suggest-prefix", required_argument, NULL, SUGGEST_PREFIX_OPTION},
   {"verbose", no_argument, NULL, 'v'},
   {"version", no_argument, NULL, 'V'},
+  {"window", required_argument, NULL, WINDOW_OPTION},
+  {"word-cache", required_argument, NULL, WORD_CACHE_OPTION},
   {NULL, 0, NULL, 0}
 };
 
@@ -133,11 +430,16 @@ char *ispell_prog = NULL;
 /* Dictionary to use.  Just use the default if NULL.  */
 char *dictionary = NULL;
 
+/* Word list to compile into a dictionary file (--compile-dict), or
+   NULL if we're checking spelling.  */
+char *compile_dict = NULL;
+
 /* Display Ispell's version (--ispell-version, -I). */
 int show_ispell_version = 0;
 
-/* Whether we've read from stdin already.  */
-int read_stdin = 0;
+/* The operand `-' that reads the standard input, which is the first
+   one given, or NULL if there is none.  */
+char *stdin_operand = NULL;
 
 /* Whether we're using the British dictionary (--british, -b).  */
 int british = 0;
@@ -146,6 +448,10 @@ int british = 0;
    be spelled correctly (--verbose, -v).  */
 int verbose = 0;
 
+/* Whether we're printing the stem of each word found only through
+   its affixes (--print-stems, -x).  */
+int print_stems = 0;
+
 /* Whether we're prepending line numbers to the lines (--number, -n).  */
 int number_lines = 0;
 
@@ -155,11 +461,151 @@ int print_file_names = 0;
 
 /* Whether we're reading from the terminal.  We never will.  */
 int interactive = 0;
+
+/* How many lines may be awaiting Ispell's answer at once
+   (--window).  */
+int window = DEFAULT_WINDOW;
+
+/* How words are checked (--engine).  */
+enum engine engine = ENGINE_ISPELL;
+
+/* Dictionaries whose words are accepted on top of the engine's
+   (--overlay), in the order given.  */
+char *overlay[LAYER_MAX];
+int overlays = 0;
+
+/* The builtin engine's dictionary, with the overlays on top of it;
+   with Ispell, the overlays alone, or NULL if there are none.
+   `--serve' reloads them as their files change.  */
+layers_t *dict_layers = NULL;
+
+/* The first of `dict_layers' that is an overlay.  */
+int first_overlay = 0;
+
+/* File of words to report as misspelled whatever the engine says of
+   them (--stop-list, -s), or NULL.  */
+char *stop_list = NULL;
+
+/* Its words, if one was given.  */
+dict_t *stop_dict = NULL;
+
+/* A Bloom filter of those words, so that most words of the input
+   are known not to be in the stop list without probing its table:
+   each sets the two bits `STOP_BITS' of its `stop_hash' in element
+   `stop_hash' & `stop_mask', so that a word is tested with one load
+   from memory.  */
+uint32_t *stop_filter = NULL;
+uint32_t stop_mask;
+
+/* Each character in lower case, for `stop_hash'.  */
+unsigned char stop_fold[256];
+
+/* The bits of its element of `stop_filter' set for a word whose
+   `stop_hash' is HASH, taken from the high bits of HASH mixed.  */
+#define STOP_BITS(hash) \
+  (1U << ((hash) * 0x9e3779b1U >> 27) \
+   | 1U << ((hash) * 0x9e3779b1U >> 22 & 31))
+
+/* How the builtin engine keeps the words of a word list, and how
+   `--compile-dict' compiles one (--dict-format).  */
+enum dict_format dict_format = DICT_HASH;
+
+/* Whether the builtin engine strips affixes from words not in
+   the builtin engine's dictionary literally (--affixes, or
+   --no-affixes), or -1 if neither was given.  The word lists have no
+   flags to say which words take which affixes, so rules tried on
+   every word accept misspellings such as `runing'; they are used
+   only when asked for, as by `--affix-file', `--verbose' or
+   `--print-stems'.  */
+int use_affixes = -1;
+
+/* Ispell affix file with the rules for doing so (--affix-file), or
+   NULL for the builtin English ones.  */
+char *affix_file = NULL;
+
+/* Those rules, if `use_affixes' and the builtin engine is used.  */
+affixes_t *word_affixes = NULL;
+
+/* How many files to check at once (--jobs, -j).  */
+int jobs = 1;
+
+/* Whether to send Ispell only the words it has not yet given a
+   verdict on, rather than whole lines (--no-word-cache turns this
+   off).  */
+int use_word_cache = 1;
+
+/* Whether to print how often a word's verdict was already known
+   (--cache-stats).  */
+int show_cache_stats = 0;
+
+/* Whether to print counts and timings of the run at exit
+   (--stats).  */
+int show_stats = 0;
+
+/* What the threads checking files did, added up as each finishes,
+   for `--stats'.  */
+stats_t run_stats;
+
+/* When the run began, for `--stats'.  */
+uint64_t run_start;
+
+/* The verdicts Ispell has given, if `use_word_cache'.  */
+verdicts_t *word_verdicts = NULL;
+
+/* File to keep `word_verdicts' in from one run to the next
+   (--word-cache), or NULL.  */
+char *word_cache_file = NULL;
+
+/* The version of Ispell, from its banner.  */
+char *ispell_version = NULL;
+
+/* Directory to keep the misspellings found in each file in
+   (--cache-dir), or NULL.  */
+char *cache_dir = NULL;
+
+/* How many bytes the entries of `cache_dir' may take
+   (--cache-size).  */
+off_t cache_size = DEFAULT_CACHE_SIZE;
+
+/* The results kept in `cache_dir', if it is in use.  */
+results_t *file_results = NULL;
+
+/* Whether to print words near each misspelled word (--suggest).  */
+int suggest = 0;
+
+/* The characters of each word that the index of words to suggest
+   makes its deletes from, or zero for all (--suggest-prefix).  */
+int suggest_prefix = 0;
+
+/* The index of words to suggest, if `suggest'.  */
+suggest_t *word_suggest = NULL;
+
+/* How long building `word_suggest' took, for `--stats'.  */
+uint64_t suggest_build_time;
+
+/* How long loading `dict_layers' took, for `--stats'.  */
+uint64_t dict_load_time;
+
+/* The files being checked when `jobs' is more than one.  */
+struct job_queue queue;
+
+/* Socket to check the files sent to (--serve), or NULL.  */
+char *serve_socket = NULL;
+
+/* Socket of the server to have check the files (--connect), or
+   NULL.  */
+char *connect_socket = NULL;
+
+/* The Ispells that `serve' hands out to clients.  */
+struct pipe_pool pool;
+
+/* Set by a signal telling `serve' to stop.  */
+volatile sig_atomic_t stop_serving = 0;
 
 int
 main (int argc, char **argv)
 {
-  char opt = 0;			/* Current option.  */
+  int opt = 0;			/* Current option.  */
   int opt_error = 0;		/* Whether an option error occurred.  */
   int show_help = 0;		/* Display help (--help, -h).  */
   int show_version = 0;		/* Display the version (--version, -V).  */
@@ -168,10 +614,13 @@ main (int argc, char **argv)
 
   program_name = argv[0];
 
+  /* However the program exits, what it found is written.  */
+  atexit (out_flush);
+
   /* Option processing loop.  */
   while (1)
     {
-      opt = getopt_long (argc, argv, "IVbdhilnosvx", long_options,
+      opt = getopt_long (argc, argv, "IVbd:hi:j:lnos:vx", long_options,
 			 (int *) 0);
 
       if (opt == EOF)
@@ -203,6 +652,14 @@ main (int argc, char **argv)
 	  else
 	    error (0, 0, "option argument not given");
 	  break;
+	case 'j':
+	  jobs = atoi (optarg);
+	  if (jobs < 1)
+	    {
+	      error (0, 0, "%s: invalid number of jobs", optarg);
+	      opt_error = 1;
+	    }
+	  break;
 	case 'l':
 	  break;
 	case 'n':
@@ -212,11 +669,116 @@ main (int argc, char **argv)
 	  print_file_names = 1;
 	  break;
 	case 's':
+	  stop_list = optarg;
 	  break;
 	case 'v':
 	  verbose = 1;
 	  break;
 	case 'x':
+	  print_stems = 1;
+	  break;
+	case CACHE_DIR_OPTION:
+	  cache_dir = xstrdup (optarg);
+	  break;
+	case CACHE_SIZE_OPTION:
+	  {
+	    char *end;
+
+	    cache_size = strtol (optarg, &end, 10);
+	    if (*end == 'k' || *end == 'K')
+	      cache_size *= 1024, end++;
+	    else if (*end == 'M')
+	      cache_size *= 1024 * 1024, end++;
+	    else if (*end == 'G')
+	      cache_size *= 1024 * 1024 * 1024, end++;
+	    if (end == optarg || *end || cache_size < 0)
+	      {
+		error (0, 0, "%s: invalid cache size", optarg);
+		opt_error = 1;
+	      }
+	  }
+	  break;
+	case CACHE_STATS_OPTION:
+	  show_cache_stats = 1;
+	  break;
+	case STATS_OPTION:
+	  show_stats = 1;
+	  break;
+	case COMPILE_DICT_OPTION:
+	  compile_dict = xstrdup (optarg);
+	  break;
+	case SERVE_OPTION:
+	  serve_socket = xstrdup (optarg);
+	  break;
+	case CONNECT_OPTION:
+	  connect_socket = xstrdup (optarg);
+	  break;
+	case SUGGEST_OPTION:
+	  suggest = 1;
+	  break;
+	case SUGGEST_PREFIX_OPTION:
+	  {
+	    char *end;
+
+	    suggest_prefix = strtol (optarg, &end, 10);
+	    if (end == optarg || *end || suggest_prefix < 0
+		|| suggest_prefix > DICT_MAX_WORD)
+	      {
+		error (0, 0, "%s: invalid prefix length", optarg);
+		opt_error = 1;
+	      }
+	  }
+	  break;
+	case NO_WORD_CACHE_OPTION:
+	  use_word_cache = 0;
+	  break;
+	case AFFIX_FILE_OPTION:
+	  affix_file = xstrdup (optarg);
+	  break;
+	case AFFIXES_OPTION:
+	  use_affixes = 1;
+	  break;
+	case NO_AFFIXES_OPTION:
+	  use_affixes = 0;
+	  break;
+	case DICT_FORMAT_OPTION:
+	  if (!strcmp (optarg, "hash"))
+	    dict_format = DICT_HASH;
+	  else if (!strcmp (optarg, "dawg"))
+	    dict_format = DICT_DAWG;
+	  else
+	    {
+	      error (0, 0, "%s: unknown dictionary format", optarg);
+	      opt_error = 1;
+	    }
+	  break;
+	case OVERLAY_OPTION:
+	  if (overlays == LAYER_MAX - 1)
+	    error (EXIT_FAILURE, 0, "%s: more than %d overlays", optarg,
+		   LAYER_MAX - 1);
+	  overlay[overlays++] = optarg;
+	  break;
+	case ENGINE_OPTION:
+	  if (!strcmp (optarg, "ispell"))
+	    engine = ENGINE_ISPELL;
+	  else if (!strcmp (optarg, "builtin"))
+	    engine = ENGINE_BUILTIN;
+	  else
+	    {
+	      error (0, 0, "%s: unknown engine", optarg);
+	      opt_error = 1;
+	    }
+	  break;
+	case WORD_CACHE_OPTION:
+	  word_cache_file = xstrdup (optarg);
+	  break;
+	case WINDOW_OPTION:
+	  window = atoi (optarg);
+	  if (window < 1)
+	    {
+	      error (0, 0, "%s: invalid window size", optarg);
+	      opt_error = 1;
+	    }
 	  break;
 	default:
 	  opt_error = 1;
@@ -230,6 +792,12 @@ main (int argc, char **argv)
       exit (EXIT_FAILURE);
     }
 
+  if (use_affixes < 0)
+    use_affixes = affix_file || verbose || print_stems;
+
+  if (show_stats)
+    run_start = stats_now ();
+
   if (show_version)
     {
       error (0, 0, version);
@@ -244,23 +812,211 @@ main (int argc, char **argv)
       fputs ("This is GNU Spell, a Unix spell emulator.\n\n"
 	     "  -I, --ispell-version\t\tPrint Ispell's version.\n"
 	     "  -V, --version\t\t\tPrint the version number.\n"
+	     "      --affix-file=FILE\t\tStrip the affixes in Ispell affix\n"
+	     "\t\t\t\tfile FILE with the builtin engine.\n"
+	     "      --affixes\t\t\tStrip affixes with the builtin\n"
+	     "\t\t\t\tengine's English rules.\n"
 	     "  -b, --british\t\t\tUse the British dictionary.\n"
+	     "      --cache-dir=DIR\t\tKeep the misspellings found in each\n"
+	     "\t\t\t\tfile in DIR, for when it is checked\n"
+	     "\t\t\t\tagain unchanged.\n"
+	     "      --cache-size=SIZE\t\tKeep DIR to SIZE bytes (or k, M, G).\n"
+	     "      --cache-stats\t\tReport how many words Ispell was\n"
+	     "\t\t\t\tspared asking about.\n"
+	     "      --compile-dict=FILE\tCompile word list FILE into the\n"
+	     "\t\t\t\tdictionary file given as operand.\n"
+	     "      --connect=SOCKET\t\tHave the server at SOCKET check the\n"
+	     "\t\t\t\tfiles.\n"
+	     "      --dict-format=FORMAT\tKeep words in a `hash' table or a\n"
+	     "\t\t\t\t`dawg' (word graph).\n"
 	     "  -d, --dictionary=FILE\t\tUse FILE to look up words.\n"
+	     "      --engine=NAME\t\tCheck with `ispell' or `builtin'.\n"
 	     "  -h, --help\t\t\tPrint a summary of the options.\n"
 	     "  -i, --ispell=PROGRAM\t\tCalls PROGRAM as Ispell.\n"
+	     "  -j, --jobs=N\t\t\tCheck N files at once.\n"
 	     "  -l, --all-chains\t\tIgnored; for compatibility.\n"
 	     "  -n, --number\t\t\tPrint line numbers before lines.\n"
+	     "      --no-affixes\t\tLook words up only as they are with\n"
+	     "\t\t\t\tthe builtin engine.\n"
+	     "      --no-word-cache\t\tSend Ispell every line whole.\n"
 	     "  -o, --print-file-name\t\tPrint file names before lines.\n"
-	     "  -s, --stop-list=FILE\t\tIgnored; for compatibility.\n"
+	     "      --overlay=FILE\t\tAlso accept the words in FILE.\n"
+	     "      --serve=SOCKET\t\tCheck files sent to SOCKET by\n"
+	     "\t\t\t\t`--connect', keeping the engine ready.\n"
+	     "  -s, --stop-list=FILE\t\tAlways report the words in FILE as\n"
+	     "\t\t\t\tmisspelled.\n"
+	     "      --stats\t\t\tReport counts and timings of the run.\n"
+	     "      --suggest\t\t\tPrint words near each misspelled word.\n"
+	     "      --suggest-prefix=N\tIndex only the first N characters\n"
+	     "\t\t\t\tof words to suggest (0 for all).\n"
 	     "  -v, --verbose\t\t\tPrint words not literally found.\n"
-	     "  -x, --print-stems\t\tIgnored; for compatibility.\n\n"
+	     "  -x, --print-stems\t\tPrint the stem of each word found\n"
+	     "\t\t\t\tthrough its affixes.\n"
+	     "      --window=LINES\t\tKeep up to LINES lines in Ispell.\n"
+	     "      --word-cache=FILE\t\tKeep Ispell's verdicts on words in\n"
+	     "\t\t\t\tFILE from one run to the next.\n\n"
 	     "Please use Info to read more (type `info spell').\n", stderr);
       exit (EXIT_SUCCESS);
     }
 
+  if (compile_dict)
+    {
+      dict_t *dict;
+
+      /* `-o' may come before the output file, as in `spell
+         --compile-dict words.txt -o words.sdict'; it means nothing
+         here.  */
+      if (argc - optind != 1)
+	error (EXIT_FAILURE, 0, "--compile-dict needs one output file");
+      dict = dict_load (compile_dict);
+      if (dict_format == DICT_DAWG && !dict->map)
+	dict_make_dawg (dict);
+      dict_write (dict, argv[optind]);
+      exit (EXIT_SUCCESS);
+    }
+
+  if (serve_socket && connect_socket)
+    error (EXIT_FAILURE, 0, "--serve and --connect cannot both be given");
+
+  {
+    int i;
+
+    for (i = optind; i < argc && !stdin_operand; i++)
+      if (argv[i][0] == '-' && argv[i][1] == 0)
+	stdin_operand = argv[i];
+  }
+
+  /* A client has the server do the checking.  */
+  if (connect_socket)
+    {
+      run_client (argc, argv);
+      exit (EXIT_SUCCESS);
+    }
+
+  /* Ispell cannot read a compiled dictionary, so it implies the
+     builtin engine.  */
+  if (dictionary && dict_is_compiled (dictionary))
+    engine = ENGINE_BUILTIN;
+
+  /* Only the American word list is installed with Spell, so the
+     builtin engine has no British one to fall back on.  */
+  if (british && engine == ENGINE_BUILTIN && !dictionary
+      && !show_ispell_version)
+    error (EXIT_FAILURE, 0, "--british with the builtin engine needs "
+	   "--dictionary");
+
+  /* Ispell names the stem of a word only when it is sent the whole
+     line.  */
+  if (print_stems)
+    use_word_cache = 0;
+
+  if (serve_socket)
+    {
+      /* What is found goes to each client numbered and without file
+         names, to be put as it asked (see `print_served').  */
+      number_lines = 1;
+      print_file_names = 0;
+      if (cache_dir)
+	open_results ();
+      load_stop_list ();
+
+      /* A server runs on as the dictionaries are edited.  */
+      load_dict ();
+      if (dict_layers)
+	layers_watch (dict_layers);
+
+      if (engine == ENGINE_BUILTIN)
+	{
+	  load_affixes ();
+	  load_suggestions ();
+	  serve (NULL, 0);
+	  report_stats (NULL, 0);
+	}
+      else
+	{
+	  pipe_t *pipes;
+
+	  if (!ispell_prog)
+	    ispell_prog = find_ispell ();
+	  if (use_word_cache)
+	    word_verdicts = verdict_make ();
+	  load_suggestions ();
+	  pipes = start_ispells (jobs);
+	  open_word_cache ();
+	  serve (pipes, jobs);
+	  report_cache (pipes, jobs);
+	  report_stats (pipes, jobs);
+	}
+      if (word_verdicts)
+	verdict_save (word_verdicts);
+      if (file_results)
+	results_trim (file_results);
+      exit (EXIT_SUCCESS);
+    }
+
+  /* If every file has been checked before, just print what was found
+     then, without starting an engine.  */
+  if (cache_dir && !show_ispell_version)
+    {
+      open_results ();
+      if (file_results && replay_results (argc, argv))
+	{
+	  report_stats (NULL, 0);
+	  exit (EXIT_SUCCESS);
+	}
+    }
+
+  if (!show_ispell_version)
+    {
+      load_stop_list ();
+      load_dict ();
+      load_suggestions ();
+    }
+
+  /* The builtin engine needs no Ispell, unless we were asked for its
+     version.  */
+  if (engine == ENGINE_BUILTIN && !show_ispell_version)
+    {
+      load_affixes ();
+
+      if (jobs > argc - optind)
+	jobs = argc - optind;
+
+      if (jobs > 1)
+	run_jobs (NULL, argc, argv);
+      else
+	read_files (NULL, argc, argv);
+      report_stats (NULL, 0);
+      if (file_results)
+	results_trim (file_results);
+      exit (EXIT_SUCCESS);
+    }
+
   if (!ispell_prog)
     ispell_prog = find_ispell ();
 
+  if (use_word_cache)
+    word_verdicts = verdict_make ();
+
+  /* There is no use in more Ispells than files.  */
+  if (jobs > argc - optind)
+    jobs = argc - optind;
+
+  if (jobs > 1 && !show_ispell_version)
+    {
+      pipe_t *pipes = start_ispells (jobs);
+
+      open_word_cache ();
+      run_jobs (pipes, argc, argv);
+      report_cache (pipes, jobs);
+      report_stats (pipes, jobs);
+      if (word_verdicts)
+	verdict_save (word_verdicts);
+      if (file_results)
+	results_trim (file_results);
+      exit (EXIT_SUCCESS);
+    }
+
   new_pipe (&ispell_pipe);
 
   pid = fork ();
@@ -320,285 +1076,2513 @@ find_ispell ()
   abort ();
 }
 
-/* Read the file *FILE, opened in the file stream *STREAM.  Send
-   output, line by line, through *THE_PIPE (created by `new_pipe').  */
+/* Read the file *FILE, opened as *INPUT by `open_input'.  Send
+   output, line by line, through *THE_PIPE (created by `new_pipe').
+   Ispell's answers are read as they come in, between lines (see
+   `pipe_wait'), and the answers to the last lines may still be on
+   their way on return; their output goes to *OUT, or to stdout if OUT
+   is NULL.  */
 
 void
-read_file (pipe_t * the_pipe, FILE * stream, char *file)
+read_file (pipe_t * the_pipe, input_t * input, char *file, str_t * out)
 {
-  str_t *str = str_make (0);
-  enum add_line_return add_line_ret = 0;
+  stats_t *stats = &the_pipe->stats;
+  uint64_t start = 0;
+  char *text;
+  int len;
   int line = 0;
 
   while (1)
     {
-      str = str_make (str);
-
-      str_add_char (str, '^');
-      add_line_ret = str_add_line (str, stream);
-      line++;
-
-      if (add_line_ret == ADD_LINE_ERR)
-	error (EXIT_FAILURE, errno, "%s: error reading line", file);
-      if (add_line_ret == ADD_LINE_EOF && !str->len)
-	return;
-
-      /* In case there was no newline at the end of the file.  */
-      if (str->str[str->len - 1] != '\n')
-	str_add_char (str, '\n');
-
-      if (write (the_pipe->pout, str_to_nstr (str), str->len) != str->len)
-	error (EXIT_FAILURE, errno, "error writing to Ispell");
+      /* Rather than wait for a line that has not come yet, with
+         answers to earlier ones unprinted, wait for either, showing
+         what has been printed first.  */
+      while (!input_ready (input))
+	{
+	  if (!out)
+	    out_flush ();
+	  if (!the_pipe->count)
+	    break;
+	  if (pipe_wait (the_pipe, fileno (input->stream)))
+	    input_fill (input);
+	}
 
-      read_ispell_errors (the_pipe);
-      read_ispell (the_pipe, file, line);
-      read_ispell_errors (the_pipe);
+      if (show_stats)
+	start = stats_now ();
+      if (input_line (input, &text, &len) != ADD_LINE_OK)
+	break;
+      if (show_stats)
+	stats->read_time += stats_now () - start;
+      stats->bytes += len;
 
-      if (add_line_ret == ADD_LINE_EOF)
-	return;
+      /* The pieces of a long line (see `input_line') all have its
+         number.  */
+      if (!input->continued)
+	{
+	  stats->lines++;
+	  line++;
+	}
+      send_line (the_pipe, text, len, file, line, out);
     }
-
-  if (fclose (stream) == EOF)
-    error (0, errno, "%s: close error", file);
 }
 
-/* Read all of Ispell's corrections for a line of text (already
-   submitted) from the open pipe *ISPELL_PIPE (created by `new_pipe').
-   Must be called from the parent process communicating with Ispell.
-   Print out the misspelled words, processing until seeing a blank
-   line.  */
+/* Check the file *FILE, opened as *INPUT by `open_input', line by
+   line against the version of `dict_layers' in WORKER->layers,
+   printing the misspelled words just as `read_ispell' does, to *OUT
+   or to stdout if OUT is NULL.  A word in no dictionary of the stack
+   literally is looked for again in the first, the builtin engine's
+   own, with its affixes stripped by `word_affixes', and if found is
+   printed only as `--verbose' and `--print-stems' ask (see
+   `print_derived').  A word in `stop_dict' is printed whatever the
+   dictionaries say.  Use the
+   space in WORKER->scratch and count in WORKER->stats; the worker
+   belongs to the calling thread.  Nothing is written but *WORKER and
+   *OUT, so threads may do this at once.  */
 
 void
-read_ispell (pipe_t * ispell_pipe, char *file, int line)
+check_file (struct worker *worker, input_t * input, char *file,
+	    str_t * out)
 {
-  str_t *str = str_make (0);
+  span_list_t *spans = &worker->scratch.spans;
+  stats_t *stats = &worker->stats;
+  struct layer_stack *layers = worker->layers;
+  dict_t *dict = layers->dict[0];
+  uint64_t start = 0;
+  char stem[DICT_MAX_WORD];
+  int stem_len;
+  char *text;
+  int len;
+  int line = 0;
+  int i;
 
+  if (show_stats)
+    start = stats_now ();
   while (1)
     {
-      str = str_make (str);
-
-      if (str_add_line_from_desc (str, ispell_pipe->pin) == ADD_LINE_EOF)
-	exit (EXIT_SUCCESS);
-
-      /* Ispell gives us a blank line when it's finished processing
-         the line we just gave it.  */
-      if (str->len == 1 && str->str[0] == '\n')
-	return;
+      /* Show what has been printed before waiting for more input.  */
+      if (!out && !input_ready (input))
+	out_flush ();
+      if (input_line (input, &text, &len) != ADD_LINE_OK)
+	break;
 
-      /* There was no problem with this word.  */
-      if (str->str[0] == '*' || str->str[0] == '+'
-	  || str->str[0] == '-')
-	continue;
+      stats->bytes += len;
+      if (!input->continued)
+	{
+	  stats->lines++;
+	  line++;
+	}
 
-      /* The word appears to have been misspelled.  */
-      if (str->str[0] == '&' || str->str[0] == '#'
-	  || (str->str[0] == '?' && verbose))
+      stats->words += token_scan (text, len, spans);
+      for (i = 0; i < spans->len; i++)
 	{
-	  int pos;
+	  char *word = text + spans->span[i].start;
+	  int word_len = spans->span[i].len;
 
-	  if (print_file_names)
+	  /* A word in the stop list is misspelled, whatever the
+	     dictionary says.  */
+	  if (!stop_dict || !is_stop_word (word, word_len))
 	    {
-	      printf ("%s:", file);
-	      if (!number_lines)
-		putchar (' ');
+	      if (dict_check (dict, word, word_len)
+		  || (layers->count > 1
+		      && layers_check (layers, 1, word, word_len)))
+		continue;
+	      if (word_affixes
+		  && affix_check (word_affixes, dict, word, word_len,
+				  stem, &stem_len))
+		{
+		  print_derived (out, file, line, word, word_len, stem,
+				 stem_len);
+		  continue;
+		}
 	    }
-	  if (number_lines)
-	    printf ("%d: ", line);
-
-	  for (pos = 2; str->str[pos] != ' '; pos++)
-	    putchar (str->str[pos]);
-	  putchar ('\n');
-
-	  continue;
+	  stats->misspelled++;
+	  print_word (out, file, line, word, word_len);
 	}
 
-      if (str->str[0] == '?' && !verbose)
-	continue;
+      /* A line is timed from the end of the one before, reading it
+         included, so that it costs one reading of the clock.  */
+      if (show_stats)
+	{
+	  uint64_t now = stats_now ();
 
-      error (0, 0, "unrecognized Ispell line `%s'", str_to_nstr (str));
+	  histogram_record (&stats->line_time, now - start);
+	  start = now;
+	}
     }
 }
 
-/* Read from the stderr of the connected process as long as there
-   remains data in the channel, and print each error.  Must be called
-   from the parent process connected with Ispell by *THE_PIPE (created
-   by `new_pipe').  */
+/* Send the LEN characters at TEXT, which are line number LINE of
+   *FILE, through *THE_PIPE (created by `new_pipe') as an Ispell
+   command: a `^', the line, and a newline if the line lacks one.
+   The pieces go in one `writev', so the line is not copied.  If
+   `word_verdicts' is in use, or the line has a word in `stop_dict'
+   or an overlay, send instead only the words of the line that have
+   no verdict yet (see `send_words').  A line with characters beyond
+   ASCII goes whole all the same, unless it has such a word: Ispell
+   may split its words otherwise than `token_scan' does, naming
+   misspelled words that were not sent.  First wait until
+   fewer than `window' lines are awaiting Ispell's answer, then
+   record the line so that `take_answers' can attribute the answer to
+   it, and print it to *OUT (or stdout if OUT is NULL).  */
 
 void
-read_ispell_errors (pipe_t * the_pipe)
+send_line (pipe_t * the_pipe, char *text, int len, char *file, int line,
+	   str_t * out)
 {
-  struct timeval time_out;
-  str_t *str = str_make (0);
-
-  time_out.tv_sec = time_out.tv_usec = 0;
+  stats_t *stats = &the_pipe->stats;
+  struct pending *rec;
+  struct iovec iov[3];
+  int iov_count = 0;
+  uint64_t start = 0;
+  char *nul;
+
+  if (show_stats && the_pipe->count >= window)
+    start = stats_now ();
+  while (the_pipe->count >= window)
+    pipe_wait (the_pipe, -1);
+  rec = &the_pipe->pending[(the_pipe->head + the_pipe->count) % window];
+
+  rec->file = file;
+  rec->line = line;
+  rec->out = out;
+  rec->asked = -1;
+  if (show_stats)
+    {
+      rec->sent_at = stats_now ();
+      if (start)
+	stats->window_time += rec->sent_at - start;
+    }
 
-  while (select (FD_SETSIZE, &(the_pipe->error_set), NULL, NULL,
-		 &time_out) == 1)
+  if ((word_verdicts && !has_8bit (text, len))
+      || ((stop_dict || the_pipe->layers)
+	  && has_listed_word (the_pipe, text, len, &rec->spans)))
     {
-      str = str_make (str);
+      send_words (the_pipe, rec, text, len);
+      return;
+    }
 
-      if (str_add_line_from_desc (str, the_pipe->perr) == ADD_LINE_EOF)
-	/* Ispell closed its stderr.  */
-	error (EXIT_FAILURE, 0, "premature EOF from Ispell's stderr");
+  /* Nothing else splits the line into words.  */
+  if (show_stats)
+    stats->words += token_scan (text, len, &rec->spans);
 
-      /* Strip the crlf.  */
-      str->len -= 2;
-      str->str[str->len - 1] = 0;
+  the_pipe->count++;
 
-      if (!memcmp (str->str, "Can't open ", strlen ("Can't open ")))
-	error (EXIT_FAILURE, 0, "%s: cannot open",
-	       str->str + strlen ("Can't open "));
+  /* Ispell would take a NUL for the end of the line, so give it a
+     copy with spaces instead, as `str_to_nstr' would.  */
+  if (memchr (text, 0, len))
+    {
+      str_t *copy = str_make (the_pipe->nul_free);
 
-      fprintf (stderr, "%s: %s\n", ispell_prog, str->str);
+      str_add_mem (copy, text, len);
+      for (nul = memchr (copy->str, 0, len); nul;
+	   nul = memchr (nul, 0, copy->str + len - nul))
+	*nul = ' ';
+      text = copy->str;
+    }
+
+  iov[iov_count].iov_base = "^";
+  iov[iov_count++].iov_len = 1;
+  iov[iov_count].iov_base = text;
+  iov[iov_count++].iov_len = len;
+  if (!len || text[len - 1] != '\n')
+    {
+      iov[iov_count].iov_base = "\n";
+      iov[iov_count++].iov_len = 1;
     }
+
+  queue_write (the_pipe, iov, iov_count);
 }
-
-/* Create *THE_PIPE, setting up the file descriptors and streams, and
-   activating the SIGPIPE handler.  */
+
+/* Finish recording in *REC, the record `send_line' has taken for the
+   LEN characters at TEXT, which words are in the line and what is
+   known of each, and send Ispell the words that have no verdict in
+   `word_verdicts' (if it is in use), each once, on one line.  Words
+   in `stop_dict' are misspelled without asking, and then those in
+   the overlays of THE_PIPE->layers spelled correctly.  If no word needs
+   sending and none is misspelled, there is nothing to print, so the
+   record is not kept.  */
 
 void
-new_pipe (pipe_t * the_pipe)
+send_words (pipe_t * the_pipe, struct pending *rec, char *text, int len)
 {
-  int ifd[2];
-  int ofd[2];
-  int efd[2];
+  span_list_t *spans = &rec->spans;
+  str_t *request = str_make (the_pipe->request);
+  struct iovec iov;
+  int misspelled = 0;
+  int i;
+
+  rec->asked = 0;
+  the_pipe->stats.words += token_scan (text, len, spans);
+  if (spans->len > rec->mem)
+    {
+      rec->mem = spans->mem;
+      rec->ask = xrealloc (rec->ask, rec->mem * sizeof *rec->ask);
+      rec->sent = xrealloc (rec->sent, rec->mem * sizeof *rec->sent);
+      rec->verdict = xrealloc (rec->verdict, rec->mem);
+    }
 
-  if (signal (SIGPIPE, sig_pipe) == SIG_ERR)
-    error (EXIT_FAILURE, errno, "error creating SIGPIPE handler");
-  if (signal (SIGCHLD, sig_chld) == SIG_ERR)
-    error (EXIT_FAILURE, errno, "error creating SIGCHLD handler");
+  str_add_char (request, '^');
+  for (i = 0; i < spans->len; i++)
+    {
+      char *word = text + spans->span[i].start;
+      int word_len = spans->span[i].len;
+      int j;
 
-  if (pipe (ifd) < 0)
-    error (EXIT_FAILURE, errno, "error creating pipe to Ispell");
-  the_pipe->pin = ifd[0];
-  the_pipe->cout = ifd[1];
+      rec->ask[i] = -1;
+      if (stop_dict && is_stop_word (word, word_len))
+	{
+	  rec->verdict[i] = VERDICT_MISSPELLED;
+	  misspelled = 1;
+	  continue;
+	}
+      if (the_pipe->layers
+	  && layers_check (the_pipe->layers, 0, word, word_len))
+	{
+	  rec->verdict[i] = VERDICT_OK;
+	  continue;
+	}
+      rec->verdict[i] = VERDICT_UNKNOWN;
+      if (word_verdicts)
+	{
+	  rec->verdict[i] = verdict_find (word_verdicts, word, word_len);
+	  the_pipe->words++;
+	}
+      if (rec->verdict[i] != VERDICT_UNKNOWN)
+	{
+	  the_pipe->hits++;
+	  if (rec->verdict[i] != VERDICT_OK)
+	    misspelled = 1;
+	  continue;
+	}
 
-  if (pipe (ofd) < 0)
-    error (EXIT_FAILURE, errno, "error creating pipe to Ispell");
-  the_pipe->cin = ofd[0];
-  the_pipe->pout = ofd[1];
+      /* Ask about a word only once per line.  Look back only so far,
+         so a huge line costs no more than asking twice.  */
+      for (j = i - 1; j >= 0 && j >= i - 64; j--)
+	if (rec->ask[j] >= 0 && spans->span[j].len == word_len
+	    && !memcmp (text + spans->span[j].start, word, word_len))
+	  break;
+      if (j >= 0 && j >= i - 64)
+	{
+	  rec->ask[i] = rec->ask[j];
+	  continue;
+	}
 
-  if (pipe (efd) < 0)
-    error (EXIT_FAILURE, errno, "error creating pipe to Ispell");
-  the_pipe->perr = efd[0];
-  the_pipe->cerr = efd[1];
+      if (rec->asked)
+	str_add_char (request, ' ');
+      str_add_mem (request, word, word_len);
+      rec->sent[rec->asked] = i;
+      rec->ask[i] = rec->asked++;
+    }
+  str_add_char (request, '\n');
+
+  if (!rec->asked && !misspelled)
+    return;
+
+  rec->text = str_make (rec->text);
+  str_add_mem (rec->text, text, len);
 
-  FD_ZERO (&(the_pipe->error_set));
-  FD_SET (the_pipe->perr, &(the_pipe->error_set));
+  the_pipe->count++;
+
+  if (!rec->asked)
+    return;
+  iov.iov_base = request->str;
+  iov.iov_len = request->len;
+  queue_write (the_pipe, &iov, 1);
 }
 
-/* Handle the SIGPIPE signal.  */
+/* Return nonzero if any word of the LEN characters at TEXT is in
+   `stop_dict' or in the overlays of THE_PIPE->layers, using *SPANS to
+   split them into words.  */
 
-static void
-sig_pipe (int signo)
+int
+has_listed_word (pipe_t * the_pipe, char *text, int len,
+		 span_list_t * spans)
+{
+  int i;
+
+  token_scan (text, len, spans);
+  for (i = 0; i < spans->len; i++)
+    {
+      char *word = text + spans->span[i].start;
+      int word_len = spans->span[i].len;
+
+      if ((stop_dict && is_stop_word (word, word_len))
+	  || (the_pipe->layers
+	      && layers_check (the_pipe->layers, 0, word, word_len)))
+	return 1;
+    }
+  return 0;
+}
+
+/* Return nonzero if any of the LEN characters at TEXT is beyond
+   ASCII.  */
+
+int
+has_8bit (const char *text, int len)
+{
+  int i;
+
+  for (i = 0; i < len; i++)
+    if ((unsigned char) text[i] >= 0x80)
+      return 1;
+  return 0;
+}
+
+/* Return nonzero if the LEN characters at WORD are in `stop_dict',
+   in any case `dict_check' allows.  */
+
+int
+is_stop_word (const char *word, int len)
+{
+  uint32_t hash = stop_hash (word, len);
+  uint32_t bits = STOP_BITS (hash);
+
+  if ((stop_filter[hash & stop_mask] & bits) != bits)
+    return 0;
+  return dict_check (stop_dict, word, len);
+}
+
+/* Return a hash of the LEN characters at WORD in lower case (32-bit
+   FNV-1a), which is the same for every case of a word that
+   `dict_check' allows.  */
+
+static uint32_t
+stop_hash (const char *word, int len)
+{
+  uint32_t hash = 2166136261U;
+  int pos;
+
+  for (pos = 0; pos < len; pos++)
+    {
+      hash ^= stop_fold[(unsigned char) word[pos]];
+      hash *= 16777619U;
+    }
+
+  return hash;
+}
+
+/* Write the COUNT pieces at IOV to Ispell through *THE_PIPE (created
+   by `new_pipe') as far as its pipe has room for them, and queue the
+   rest for `pipe_wait' to write as room is made.  If `MAX_QUEUED'
+   bytes are queued already, first wait until Ispell has taken some,
+   so that the queue stays bounded however far Ispell falls behind.  */
+
+void
+queue_write (pipe_t * the_pipe, struct iovec *iov, int count)
+{
+  stats_t *stats = &the_pipe->stats;
+  uint64_t start = 0;
+  ssize_t written = 0;
+  int i;
+
+  while (the_pipe->queue->len - the_pipe->queue_pos >= MAX_QUEUED)
+    pipe_wait (the_pipe, -1);
+
+  /* Only with nothing queued may this go straight to the pipe, or it
+     would overtake what is.  */
+  if (the_pipe->queue_pos == the_pipe->queue->len)
+    {
+      if (show_stats)
+	start = stats_now ();
+      written = writev (the_pipe->pout, iov, count);
+      if (written < 0 && errno != EAGAIN)
+	error (EXIT_FAILURE, errno, "error writing to Ispell");
+      stats->writes++;
+      if (show_stats)
+	stats->write_time += stats_now () - start;
+      if (written < 0)
+	written = 0;
+      stats->written += written;
+    }
+
+  for (i = 0; i < count; i++)
+    {
+      if ((size_t) written >= iov[i].iov_len)
+	{
+	  written -= iov[i].iov_len;
+	  continue;
+	}
+      str_add_mem (the_pipe->queue, (char *) iov[i].iov_base + written,
+		   iov[i].iov_len - written);
+      written = 0;
+    }
+}
+
+/* Write as much of what is queued for Ispell in *THE_PIPE (created by
+   `new_pipe') as its pipe has room for.  */
+
+void
+flush_queue (pipe_t * the_pipe)
+{
+  stats_t *stats = &the_pipe->stats;
+  str_t *queue = the_pipe->queue;
+  uint64_t start = 0;
+  ssize_t written;
+
+  if (the_pipe->queue_pos == queue->len)
+    return;
+
+  if (show_stats)
+    start = stats_now ();
+  written = write (the_pipe->pout, queue->str + the_pipe->queue_pos,
+		   queue->len - the_pipe->queue_pos);
+  if (written < 0 && errno != EAGAIN)
+    error (EXIT_FAILURE, errno, "error writing to Ispell");
+  stats->writes++;
+  if (show_stats)
+    stats->write_time += stats_now () - start;
+  if (written < 0)
+    return;
+  stats->written += written;
+
+  /* Start again at the front once it is all written, or move what is
+     left there once enough has been, so the queue does not creep.  */
+  the_pipe->queue_pos += written;
+  if (the_pipe->queue_pos == queue->len)
+    {
+      str_make (queue);
+      the_pipe->queue_pos = 0;
+    }
+  else if (the_pipe->queue_pos >= MAX_QUEUED)
+    {
+      memmove (queue->str, queue->str + the_pipe->queue_pos,
+	       queue->len - the_pipe->queue_pos);
+      queue->len -= the_pipe->queue_pos;
+      the_pipe->queue_pos = 0;
+    }
+}
+
+/* Wait until Ispell has answered every line sent through *THE_PIPE
+   (created by `new_pipe') and the answers have been printed.  Must be
+   called before anything else is printed, so that the output comes
+   out in the order it always has.  If THE_PIPE is NULL (the builtin
+   engine is in use), there is nothing to wait for.  */
+
+void
+drain_pipe (pipe_t * the_pipe)
+{
+  if (!the_pipe)
+    return;
+
+  while (the_pipe->count)
+    pipe_wait (the_pipe, -1);
+}
+
+/* Get ready to wait on all the pipes of *THE_PIPE (created by
+   `new_pipe') at once.  Make the parent's ends non-blocking, so that
+   neither Spell nor Ispell can be stuck writing to the other while
+   the other is stuck writing back, and, with `USE_EPOLL', set up the
+   epoll instance that watches them.  Must be called by the parent
+   process.  */
+
+void
+start_loop (pipe_t * the_pipe)
+{
+  fcntl (the_pipe->pin, F_SETFL, fcntl (the_pipe->pin, F_GETFL) | O_NONBLOCK);
+  fcntl (the_pipe->pout, F_SETFL,
+	 fcntl (the_pipe->pout, F_GETFL) | O_NONBLOCK);
+  fcntl (the_pipe->perr, F_SETFL,
+	 fcntl (the_pipe->perr, F_GETFL) | O_NONBLOCK);
+
+#ifdef USE_EPOLL
+  {
+    struct epoll_event event;
+
+    the_pipe->events = epoll_create (3);
+    if (the_pipe->events < 0)
+      error (EXIT_FAILURE, errno, "error creating epoll instance");
+    fcntl (the_pipe->events, F_SETFD, FD_CLOEXEC);
+
+    /* pout is watched only while something is queued for it.  */
+    event.events = EPOLLIN;
+    event.data.fd = the_pipe->pin;
+    epoll_ctl (the_pipe->events, EPOLL_CTL_ADD, the_pipe->pin, &event);
+    event.data.fd = the_pipe->perr;
+    epoll_ctl (the_pipe->events, EPOLL_CTL_ADD, the_pipe->perr, &event);
+    event.events = 0;
+    event.data.fd = the_pipe->pout;
+    epoll_ctl (the_pipe->events, EPOLL_CTL_ADD, the_pipe->pout, &event);
+    the_pipe->watch_out = 0;
+  }
+#endif /* USE_EPOLL */
+}
+
+/* Wait until Ispell, at the other end of *THE_PIPE (made ready by
+   `start_loop'), has answered, has written an error, or has room for
+   what is queued for it, or until the descriptor INPUT (unless it is
+   -1) has something to read.  Then print the errors, write what
+   there is room for, and take the answers that have come (see
+   `take_answers'), all without waiting again.  Return nonzero if
+   INPUT is ready to read.  If a line in flight can be printed
+   already, just print it and return zero.  */
+
+int
+pipe_wait (pipe_t * the_pipe, int input)
+{
+  int count = the_pipe->count;
+  int want_out = the_pipe->queue_pos < the_pipe->queue->len;
+  int in_ready = 0;
+  int out_ready = 0;
+  int err_ready = 0;
+  int input_ready = 0;
+  uint64_t start = 0;
+  int nchars;
+  int ready;
+#ifdef USE_EPOLL
+  struct epoll_event events[4];
+  struct epoll_event event;
+  int i;
+#else /* not USE_EPOLL */
+  struct pollfd fds[4];
+#endif /* not USE_EPOLL */
+
+  take_answers (the_pipe);
+  if (the_pipe->count < count)
+    return 0;
+
+  if (show_stats)
+    start = stats_now ();
+
+#ifdef USE_EPOLL
+  if (want_out != the_pipe->watch_out)
+    {
+      event.events = want_out ? EPOLLOUT : 0;
+      event.data.fd = the_pipe->pout;
+      epoll_ctl (the_pipe->events, EPOLL_CTL_MOD, the_pipe->pout, &event);
+      the_pipe->watch_out = want_out;
+    }
+
+  /* epoll refuses regular files and some devices, which never need
+     waiting for anyway.  */
+  event.events = EPOLLIN;
+  event.data.fd = input;
+  if (input >= 0
+      && epoll_ctl (the_pipe->events, EPOLL_CTL_ADD, input, &event) < 0)
+    return 1;
+
+  do
+    ready = epoll_wait (the_pipe->events, events, 4, -1);
+  while (ready < 0 && errno == EINTR);
+  if (ready < 0)
+    error (EXIT_FAILURE, errno, "error waiting for Ispell");
+  if (input >= 0)
+    epoll_ctl (the_pipe->events, EPOLL_CTL_DEL, input, &event);
+
+  for (i = 0; i < ready; i++)
+    if (events[i].data.fd == the_pipe->pin)
+      in_ready = 1;
+    else if (events[i].data.fd == the_pipe->pout)
+      out_ready = 1;
+    else if (events[i].data.fd == the_pipe->perr)
+      err_ready = 1;
+    else
+      input_ready = 1;
+#else /* not USE_EPOLL */
+  /* `poll' skips the entries with negative descriptors.  */
+  fds[0].fd = the_pipe->pin;
+  fds[0].events = POLLIN;
+  fds[1].fd = want_out ? the_pipe->pout : -1;
+  fds[1].events = POLLOUT;
+  fds[2].fd = the_pipe->perr;
+  fds[2].events = POLLIN;
+  fds[3].fd = input;
+  fds[3].events = POLLIN;
+
+  do
+    ready = poll (fds, 4, -1);
+  while (ready < 0 && errno == EINTR);
+  if (ready < 0)
+    error (EXIT_FAILURE, errno, "error waiting for Ispell");
+
+  in_ready = fds[0].revents != 0;
+  out_ready = fds[1].revents != 0;
+  err_ready = fds[2].revents != 0;
+  input_ready = fds[3].revents != 0;
+#endif /* not USE_EPOLL */
+
+  the_pipe->stats.polls++;
+  if (show_stats)
+    the_pipe->stats.poll_time += stats_now () - start;
+
+  if (out_ready)
+    flush_queue (the_pipe);
+
+  /* Print Ispell's errors before its answers, which may depend on
+     them.  */
+  if (err_ready)
+    {
+      nchars = desc_buf_fill (the_pipe->err_buf);
+      if (!nchars)
+	/* Ispell closed its stderr.  */
+	error (EXIT_FAILURE, 0, "premature EOF from Ispell's stderr");
+      if (nchars < 0 && errno != EAGAIN)
+	error (EXIT_FAILURE, errno, "error reading from Ispell");
+      read_ispell_errors (the_pipe);
+    }
+
+  if (in_ready)
+    {
+      nchars = desc_buf_fill (the_pipe->in_buf);
+      if (!nchars && !the_pipe->pending)
+	error (EXIT_FAILURE, 0, "premature EOF from Ispell's stdout");
+      if (!nchars)
+	exit (EXIT_SUCCESS);
+      if (nchars < 0 && errno != EAGAIN)
+	error (EXIT_FAILURE, errno, "error reading from Ispell");
+      take_answers (the_pipe);
+    }
+
+  return input_ready;
+}
+
+/* Print the misspelled words of each line in flight in *THE_PIPE
+   (created by `new_pipe'), oldest first, whose answer from Ispell has
+   come in whole, with the file name and line number the line was
+   recorded with.  Use only what has been read already; an answer that
+   has come in part is kept to be finished by a later call.  */
+
+void
+take_answers (pipe_t * the_pipe)
+{
+  stats_t *stats = &the_pipe->stats;
+  uint64_t start = 0;
+
+  if (!the_pipe->count)
+    return;
+  if (show_stats)
+    start = stats_now ();
+
+  while (the_pipe->count)
+    {
+      struct pending *rec = &the_pipe->pending[the_pipe->head];
+
+      if (rec->asked && !read_ispell (the_pipe, rec))
+	break;
+      if (rec->asked >= 0)
+	stats->misspelled += print_pending (rec);
+      if (show_stats)
+	histogram_record (&stats->line_time, stats_now () - rec->sent_at);
+
+      the_pipe->head = (the_pipe->head + 1) % window;
+      the_pipe->count--;
+      the_pipe->answered = 0;
+      the_pipe->agree = 1;
+      str_make (the_pipe->named);
+    }
+
+  if (show_stats)
+    stats->answer_time += stats_now () - start;
+}
+
+/* Read Ispell's corrections for the line *REC (already submitted)
+   from the read-ahead buffer of the open pipe *ISPELL_PIPE (created by
+   `new_pipe'), without reading more from the pipe, until seeing a
+   blank line.  Return nonzero if the blank line was seen.  Otherwise
+   all there was has been used, and a later call carries on where
+   this one stopped.  Must be called from the parent process
+   communicating with Ispell.
+
+   If the whole line was sent, print out the misspelled words, to
+   REC->out or to stdout if that is NULL.  Otherwise, the answers are
+   for the words sent, in order; store each as the verdict on every
+   word of the line it stands for, and in `word_verdicts'.  Should
+   Ispell not have answered for exactly those words, make do with the
+   words it named as misspelled, and keep nothing.  */
+
+int
+read_ispell (pipe_t * ispell_pipe, struct pending *rec)
+{
+  str_t *str = ispell_pipe->answer;
+  str_t *named = ispell_pipe->named;
+  span_list_t *spans = &rec->spans;
+  char *line;
+  char *end;
+  int i;
+
+  /* A line is kept in `str' until it is whole, and only then is
+     `str' emptied for the next.  */
+  for (;; str_make (str))
+    {
+      enum verdict verdict;
+      int pos;
+
+      if (!desc_buf_take_line (ispell_pipe->in_buf, str))
+	return 0;
+
+      /* Ispell gives us a blank line when it's finished processing
+         the line we just gave it.  */
+      if (str->len == 1 && str->str[0] == '\n')
+	break;
+
+      /* There was no problem with this word.  Ispell names the root
+         of one made with affixes, which only `--print-stems' wants;
+         it also sends whole lines, so `rec->asked' is -1.  Ispell
+         gives the root in capitals, whatever the word's case; fold
+         it to lower case, as the builtin engine's stems are found in
+         the word list.  */
+      if (str->str[0] == '*' || str->str[0] == '+'
+	  || str->str[0] == '-')
+	{
+	  verdict = VERDICT_OK;
+	  if (str->str[0] == '+' && print_stems && str->len > 3)
+	    {
+	      for (pos = 2; pos < str->len - 1; pos++)
+		str->str[pos] = tolower ((unsigned char) str->str[pos]);
+	      print_derived (rec->out, rec->file, rec->line, NULL, 0,
+			     str->str + 2, str->len - 3);
+	    }
+	}
+
+      /* The word appears to have been misspelled.  */
+      else if (str->str[0] == '&' || str->str[0] == '#'
+	       || str->str[0] == '?')
+	{
+	  verdict = str->str[0] == '?' ? VERDICT_GUESS : VERDICT_MISSPELLED;
+
+	  for (pos = 2; str->str[pos] != ' '; pos++);
+	  if (rec->asked < 0)
+	    {
+	      if (verdict == VERDICT_MISSPELLED || verbose)
+		{
+		  ispell_pipe->stats.misspelled++;
+		  print_word (rec->out, rec->file, rec->line, str->str + 2,
+			      pos - 2);
+		}
+	      continue;
+	    }
+
+	  str_add_mem (named, str->str + 2, pos - 2);
+	  str_add_char (named, str->str[0]);
+	  str_add_char (named, '\n');
+	}
+
+      else
+	{
+	  error (0, 0, "unrecognized Ispell line `%s'", str_to_nstr (str));
+	  continue;
+	}
+
+      if (rec->asked < 0)
+	continue;
+
+      /* Check that this answer is for the word sent, if it names
+         one.  */
+      if (ispell_pipe->answered < rec->asked)
+	{
+	  span_t *word = &spans->span[rec->sent[ispell_pipe->answered]];
+
+	  if (verdict != VERDICT_OK
+	      && (pos - 2 != word->len
+		  || memcmp (str->str + 2, rec->text->str + word->start,
+			     word->len)))
+	    ispell_pipe->agree = 0;
+	  rec->verdict[rec->sent[ispell_pipe->answered]] = verdict;
+	}
+      ispell_pipe->answered++;
+    }
+  str_make (str);
+
+  if (rec->asked < 0)
+    return 1;
+
+  if (ispell_pipe->agree && ispell_pipe->answered == rec->asked)
+    {
+      for (i = 0; word_verdicts && i < rec->asked; i++)
+	{
+	  span_t *word = &spans->span[rec->sent[i]];
+
+	  verdict_add (word_verdicts, rec->text->str + word->start,
+		       word->len, rec->verdict[rec->sent[i]]);
+	}
+      for (i = 0; i < spans->len; i++)
+	if (rec->ask[i] >= 0)
+	  rec->verdict[i] = rec->verdict[rec->sent[rec->ask[i]]];
+      return 1;
+    }
+
+  /* Ispell split the words otherwise than `token_scan' did.  Give
+     each word sent the verdict Ispell named it with, or named a word
+     within it with; print a named word found in none as it is.  None
+     of this is kept in `word_verdicts'.  */
+  for (i = 0; i < rec->asked; i++)
+    rec->verdict[rec->sent[i]] = VERDICT_OK;
+  for (line = named->str; line < named->str + named->len; line = end + 1)
+    {
+      enum verdict verdict;
+      int len;
+      int j;
+
+      end = memchr (line, '\n', named->str + named->len - line);
+      len = end - line - 1;
+      verdict = line[len] == '?' ? VERDICT_GUESS : VERDICT_MISSPELLED;
+      j = find_sent (rec, line, len);
+      if (j >= 0)
+	{
+	  if (rec->verdict[j] != VERDICT_MISSPELLED)
+	    rec->verdict[j] = verdict;
+	}
+      else if (verdict == VERDICT_MISSPELLED || verbose)
+	{
+	  ispell_pipe->stats.misspelled++;
+	  print_word (rec->out, rec->file, rec->line, line, len);
+	}
+    }
+  for (i = 0; i < spans->len; i++)
+    if (rec->ask[i] >= 0)
+      rec->verdict[i] = rec->verdict[rec->sent[rec->ask[i]]];
+  return 1;
+}
+
+/* Return the index in REC->spans of the word sent for the line *REC
+   that is the LEN characters at WORD, or failing that the first that
+   holds them, or -1 if none does.  */
+
+int
+find_sent (struct pending *rec, char *word, int len)
+{
+  int i;
+  int j;
+
+  for (i = 0; i < rec->asked; i++)
+    {
+      span_t *span = &rec->spans.span[rec->sent[i]];
+
+      if (span->len == len
+	  && !memcmp (rec->text->str + span->start, word, len))
+	return rec->sent[i];
+    }
+  for (i = 0; i < rec->asked; i++)
+    {
+      span_t *span = &rec->spans.span[rec->sent[i]];
+
+      for (j = 0; j + len <= span->len; j++)
+	if (!memcmp (rec->text->str + span->start + j, word, len))
+	  return rec->sent[i];
+    }
+  return -1;
+}
+
+/* Print the misspelled words of the line *REC, whose every word has
+   a verdict, to REC->out or to stdout if that is NULL.  Return how
+   many were printed.  */
+
+int
+print_pending (struct pending *rec)
+{
+  int printed = 0;
+  int i;
+
+  for (i = 0; i < rec->spans.len; i++)
+    if (rec->verdict[i] == VERDICT_MISSPELLED
+	|| (rec->verdict[i] == VERDICT_GUESS && verbose))
+      {
+	print_word (rec->out, rec->file, rec->line,
+		    rec->text->str + rec->spans.span[i].start,
+		    rec->spans.span[i].len);
+	printed++;
+      }
+  return printed;
+}
+
+/* Print the LEN characters at WORD, a misspelled word found on line
+   LINE of FILE, with the prefixes asked for by `--print-file-name'
+   and `--number', and the words suggested for it, if `--suggest'.
+   Append it to *OUT, or print it to stdout if OUT is NULL.  If FILE
+   is NULL, leave out the file name, for `print_results' to add.  */
+
+void
+print_word (str_t * out, char *file, int line, char *word, int len)
+{
+  char suggestions[SUGGEST_COUNT * (DICT_MAX_WORD + 2) + 2];
+  int suggestions_len = 0;
+
+  if (word_suggest)
+    suggestions_len = format_suggestions (suggestions, word, len);
+  print_line (out, file, line, word, len, suggestions, suggestions_len);
+}
+
+/* Print what `--verbose' and `--print-stems' ask for of the LEN
+   characters at WORD, found on line LINE of FILE only when made from
+   the STEM_LEN characters at STEM with affixes: with the one, the
+   word, and with the other, the stem after a `='.  WORD may be NULL
+   if it is not to be printed.  Print to *OUT or stdout, with the
+   prefixes, as `print_word' does.  */
+
+void
+print_derived (str_t * out, char *file, int line, char *word, int len,
+	       char *stem, int stem_len)
+{
+  if (verbose && word)
+    print_line (out, file, line, word, len, "", 0);
+  if (print_stems)
+    print_line (out, file, line, "=", 1, stem, stem_len);
+}
+
+/* Print the LEN characters at TEXT and the TAIL_LEN characters at
+   TAIL as a line of output for line LINE of FILE, with the prefixes
+   asked for by `--print-file-name' and `--number'.  Append it to
+   *OUT, or print it to stdout if OUT is NULL.  If FILE is NULL, leave
+   out the file name, for `print_results' to add.  */
+
+void
+print_line (str_t * out, char *file, int line, char *text, int len,
+	    char *tail, int tail_len)
+{
+  if (out)
+    {
+      char number[NUMBER_SIZE];
+
+      if (print_file_names && file)
+	{
+	  str_add_mem (out, file, strlen (file));
+	  str_add_char (out, ':');
+	  if (!number_lines)
+	    str_add_char (out, ' ');
+	}
+      if (number_lines)
+	{
+	  str_add_mem (out, number, format_number (number, line));
+	  str_add_mem (out, ": ", 2);
+	}
+
+      str_add_mem (out, text, len);
+      str_add_mem (out, tail, tail_len);
+      str_add_char (out, '\n');
+      return;
+    }
+
+  if (print_file_names && file)
+    {
+      out_mem (file, strlen (file));
+      out_char (':');
+      if (!number_lines)
+	out_char (' ');
+    }
+  if (number_lines)
+    {
+      out_number (line);
+      out_mem (": ", 2);
+    }
+
+  out_mem (text, len);
+  out_mem (tail, tail_len);
+  out_char ('\n');
+}
+
+/* Write into BUF the words in `word_suggest' nearest the LEN
+   characters at WORD, as `: ' followed by them separated by `, ', and
+   return its length, or zero if there are none.  A suggestion is
+   capitalized if WORD is, and put in capitals if WORD is in
+   capitals.  BUF must have room for `SUGGEST_COUNT' of the longest
+   words.  */
+
+int
+format_suggestions (char *buf, char *word, int len)
+{
+  suggestion_t found[SUGGEST_COUNT];
+  int count = suggest_find (word_suggest, word, len, found, SUGGEST_COUNT);
+  int capital = len && isupper ((unsigned char) word[0]);
+  int capitals = capital && len > 1;
+  int pos = 0;
+  int i;
+  int j;
+
+  for (i = 1; i < len && capitals; i++)
+    if (islower ((unsigned char) word[i]))
+      capitals = 0;
+
+  for (i = 0; i < count; i++)
+    {
+      char *to = buf + pos + 2;
+
+      memcpy (buf + pos, i ? ", " : ": ", 2);
+      memcpy (to, found[i].word, found[i].len);
+      if (capitals)
+	for (j = 0; j < found[i].len; j++)
+	  to[j] = toupper ((unsigned char) to[j]);
+      else if (capital)
+	to[0] = toupper ((unsigned char) to[0]);
+      pos += 2 + found[i].len;
+    }
+  return pos;
+}
+
+/* Print each whole line of errors from Ispell in the read-ahead buffer
+   for its stderr, without reading more; a line that has come in part
+   is kept for a later call.  Must be called from the parent process
+   connected with Ispell by *THE_PIPE (created by `new_pipe').  */
+
+void
+read_ispell_errors (pipe_t * the_pipe)
+{
+  str_t *str = the_pipe->error_line;
+
+  for (; desc_buf_take_line (the_pipe->err_buf, str); str_make (str))
+    {
+      /* Strip the crlf.  */
+      str->len -= 2;
+      str->str[str->len - 1] = 0;
+
+      if (!memcmp (str->str, "Can't open ", strlen ("Can't open ")))
+	error (EXIT_FAILURE, 0, "%s: cannot open",
+	       str->str + strlen ("Can't open "));
+
+      out_flush ();
+      fprintf (stderr, "%s: %s\n", ispell_prog, str->str);
+    }
+}
+
+/* If `--cache-stats' was given, print to stderr how many words were
+   looked up in `word_verdicts' through the COUNT pipes at PIPES, and
+   how many of them had a verdict there already.  */
+
+void
+report_cache (pipe_t * pipes, int count)
+{
+  long words = 0;
+  long hits = 0;
+  int i;
+
+  if (!show_cache_stats)
+    return;
+
+  for (i = 0; i < count; i++)
+    {
+      words += pipes[i].words;
+      hits += pipes[i].hits;
+    }
+
+  if (!word_verdicts)
+    error (0, 0, "the word cache was not used");
+  else
+    error (0, 0, "word cache: %ld words, %ld verdicts known (%.1f%%)",
+	   words, hits, words ? 100.0 * hits / words : 0.0);
+}
+
+/* If `--stats' was given, print to stderr what was done through the
+   COUNT pipes at PIPES and by the threads that checked files, and
+   how long it took.  PIPES is NULL if Ispell was not used.  The
+   times spent by different threads overlap.  */
+
+void
+report_stats (pipe_t * pipes, int count)
+{
+  stats_t *total = &run_stats;
+  int i;
+
+  if (!show_stats)
+    return;
+
+  out_flush ();
+  for (i = 0; i < count; i++)
+    {
+      pipe_t *the_pipe = &pipes[i];
+
+      stats_add (total, &the_pipe->stats);
+      fprintf (stderr, "%s: Ispell %d: %ld bytes sent in %ld writes, "
+	       "%ld bytes answered in %ld reads, %ld bytes of errors in "
+	       "%ld reads, %ld waits\n", program_name, i + 1,
+	       the_pipe->stats.written, the_pipe->stats.writes,
+	       the_pipe->in_buf->bytes, the_pipe->in_buf->reads,
+	       the_pipe->err_buf->bytes, the_pipe->err_buf->reads,
+	       the_pipe->stats.polls);
+    }
+
+  fprintf (stderr, "%s: %ld files (%ld from the cache directory), "
+	   "%ld lines, %ld words, %ld misspelled, %ld bytes, in %.3f s\n",
+	   program_name, total->files, total->cached, total->lines,
+	   total->words, total->misspelled, total->bytes,
+	   (stats_now () - run_start) / 1e9);
+  if (pipes)
+    fprintf (stderr, "%s: seconds reading input %.3f, waiting for the "
+	     "window %.3f, writing to Ispell %.3f, waiting for it "
+	     "%.3f, reading its answers %.3f\n", program_name,
+	     total->read_time / 1e9, total->window_time / 1e9,
+	     total->write_time / 1e9, total->poll_time / 1e9,
+	     total->answer_time / 1e9);
+
+  if (dict_layers)
+    {
+      int ticket;
+      struct layer_stack *layers = layers_enter (dict_layers, &ticket);
+
+      /* The time is that of loading them all.  */
+      for (i = 0; i < layers->count; i++)
+	{
+	  dict_t *dict = layers->dict[i];
+
+	  if (i < first_overlay)
+	    fprintf (stderr, "%s: dictionary: ", program_name);
+	  else
+	    fprintf (stderr, "%s: overlay %s: ", program_name,
+		     dict_layers->file[i]);
+	  fprintf (stderr, "%lu words as a %s, %.1f MB, %.1f bytes a word",
+		   (unsigned long) dict->count,
+		   dict->dawg ? "word graph" : "hash table",
+		   dict_size (dict) / 1048576.0,
+		   dict->count ? (double) dict_size (dict) / dict->count : 0.0);
+	  if (!i)
+	    fprintf (stderr, ", loaded in %.3f s", dict_load_time / 1e9);
+	  putc ('\n', stderr);
+	}
+      if (layers->version)
+	fprintf (stderr, "%s: dictionaries reloaded %lu times\n",
+		 program_name, layers->version);
+      layers_leave (dict_layers, ticket);
+    }
+  if (word_suggest)
+    fprintf (stderr, "%s: suggestion index: %lu words, %lu keys, %lu "
+	     "postings, %.1f MB, built in %.3f s\n", program_name,
+	     (unsigned long) word_suggest->count,
+	     (unsigned long) word_suggest->keys,
+	     (unsigned long) word_suggest->postings,
+	     suggest_size (word_suggest) / 1048576.0,
+	     suggest_build_time / 1e9);
+
+  histogram_print (stderr, pipes ? "line round trip" : "line time",
+		   &total->line_time, 1e3, "us");
+  histogram_print (stderr, "file time", &total->file_time, 1e6, "ms");
+}
+
+/* Create *THE_PIPE, setting up the file descriptors and streams, and
+   activating the SIGPIPE handler.  */
+
+void
+new_pipe (pipe_t * the_pipe)
+{
+  int ifd[2];
+  int ofd[2];
+  int efd[2];
+
+  if (signal (SIGPIPE, sig_pipe) == SIG_ERR)
+    error (EXIT_FAILURE, errno, "error creating SIGPIPE handler");
+  if (signal (SIGCHLD, sig_chld) == SIG_ERR)
+    error (EXIT_FAILURE, errno, "error creating SIGCHLD handler");
+
+  if (pipe (ifd) < 0)
+    error (EXIT_FAILURE, errno, "error creating pipe to Ispell");
+  the_pipe->pin = ifd[0];
+  the_pipe->cout = ifd[1];
+
+  if (pipe (ofd) < 0)
+    error (EXIT_FAILURE, errno, "error creating pipe to Ispell");
+  the_pipe->cin = ofd[0];
+  the_pipe->pout = ofd[1];
+
+  if (pipe (efd) < 0)
+    error (EXIT_FAILURE, errno, "error creating pipe to Ispell");
+  the_pipe->perr = efd[0];
+  the_pipe->cerr = efd[1];
+
+  /* Keep every end out of the Ispells we run; each gets its own
+     ends through `dup2', which clears the flag.  Otherwise, with
+     several Ispells, one would hold the others' input open.  */
+  fcntl (ifd[0], F_SETFD, FD_CLOEXEC);
+  fcntl (ifd[1], F_SETFD, FD_CLOEXEC);
+  fcntl (ofd[0], F_SETFD, FD_CLOEXEC);
+  fcntl (ofd[1], F_SETFD, FD_CLOEXEC);
+  fcntl (efd[0], F_SETFD, FD_CLOEXEC);
+  fcntl (efd[1], F_SETFD, FD_CLOEXEC);
+
+  the_pipe->in_buf = desc_buf_make (the_pipe->pin);
+  the_pipe->err_buf = desc_buf_make (the_pipe->perr);
+  the_pipe->answer = str_make (0);
+  the_pipe->nul_free = str_make (0);
+  the_pipe->request = str_make (0);
+  the_pipe->named = str_make (0);
+  the_pipe->error_line = str_make (0);
+  the_pipe->queue = str_make (0);
+  the_pipe->queue_pos = 0;
+  the_pipe->events = -1;
+  the_pipe->pending = NULL;
+  the_pipe->head = the_pipe->count = 0;
+  the_pipe->answered = 0;
+  the_pipe->agree = 1;
+  the_pipe->words = the_pipe->hits = 0;
+  stats_init (&the_pipe->stats);
+  the_pipe->layers = NULL;
+}
+
+/* Handle the SIGPIPE signal.  */
+
+static void
+sig_pipe (int signo)
+{
+  error (EXIT_FAILURE, 0, "broken pipe");
+}
+
+/* Handle SIGINT and SIGTERM while serving, by having `serve' stop
+   taking clients and wait for those it has.  A second one ends the
+   server at once.  */
+
+static void
+sig_stop (int signo)
+{
+  if (stop_serving)
+    _exit (EXIT_FAILURE);
+  stop_serving = 1;
+}
+
+/* Handle the SIGCHLD signal.  */
+
+static void
+sig_chld (int signo)
+{
+  error (EXIT_FAILURE, 0, "Ispell died");
+}
+
+/* Send lines to and retrieve lines from *THE_PIPE (created by
+   `new_pipe').  Accept `argc' (the number of arguments) and `argv'
+   (the array of arguments), so we can search for the files we are to
+   read.  Handle all communication with Ispell at a managerial level;
+   must be called by the parent process.  */
+
+void
+parent (pipe_t * the_pipe, int argc, char **argv)
+{
+  start_ispell (the_pipe);
+  open_word_cache ();
+  read_files (the_pipe, argc, argv);
+  report_cache (the_pipe, 1);
+  report_stats (the_pipe, 1);
+  if (word_verdicts)
+    verdict_save (word_verdicts);
+  if (file_results)
+    results_trim (file_results);
+}
+
+/* Get ready to talk to the Ispell at the other end of *THE_PIPE
+   (created by `new_pipe'), which has just been started by
+   `run_ispell_in_child'.  Must be called by the parent process.  */
+
+void
+start_ispell (pipe_t * the_pipe)
+{
+  /* Close the child's end of the pipes.  This is very important, as I
+     found out the hard way.  */
+  close (the_pipe->cin);
+  close (the_pipe->cout);
+  close (the_pipe->cerr);
+
+  start_loop (the_pipe);
+
+  /* This block parses Ispell's banner and grabs its version.  It then
+     prints it if the flag `--ispell-version' or `-I' was used.
+     FIXME: check that the version is high enough that it is going to
+     be able to interact with GNU Spell sucessfully.  */
+
+  {
+    int pos = 0;
+    str_t *version = str_make (0);
+    str_t *str = str_make (0);
+
+    /* Any errors that come first are printed while waiting.  */
+    while (!desc_buf_take_line (the_pipe->in_buf, str))
+      pipe_wait (the_pipe, -1);
+
+    for (; !isdigit (str->str[pos]) && pos <= str->len; pos++);
+    for (; str->str[pos] != ' ' && pos <= str->len; pos++)
+      str_add_char (version, str->str[pos]);
+
+    if (show_ispell_version)
+      {
+	printf ("%s: Ispell version %s\n", program_name,
+		str_to_nstr (version));
+	exit (EXIT_SUCCESS);
+      }
+
+    if (!ispell_version)
+      ispell_version = xstrdup (str_to_nstr (version));
+  }
+
+  /* Until the ring is made, an EOF from Ispell means it never
+     started.  */
+  the_pipe->pending = xmalloc (window * sizeof *the_pipe->pending);
+  memset (the_pipe->pending, 0, window * sizeof *the_pipe->pending);
+}
+
+/* Start COUNT Ispells, each through a pipe of its own, and return the
+   array of pipes once all of them are ready.  They are all started
+   before any is waited for, so that they load their dictionaries at
+   once.  */
+
+pipe_t *
+start_ispells (int count)
+{
+  pipe_t *pipes = xmalloc (count * sizeof *pipes);
+  pid_t pid;
+  int i;
+
+  for (i = 0; i < count; i++)
+    {
+      new_pipe (&pipes[i]);
+
+      pid = fork ();
+
+      if (pid < 0)
+	error (EXIT_FAILURE, errno, "error forking to run Ispell");
+      else if (!pid)
+	{
+	  /* A server stopped from the terminal stops them itself; were
+	     they to get its signal, it would take them for dead.  */
+	  if (serve_socket)
+	    setpgid (0, 0);
+	  run_ispell_in_child (&pipes[i]);
+	}
+    }
+
+  for (i = 0; i < count; i++)
+    start_ispell (&pipes[i]);
+  return pipes;
+}
+
+/* Attach `word_cache_file', if there is one, to `word_verdicts', if
+   it is in use.  Its verdicts must have been given by the same
+   version of Ispell, with the same dictionary (by name and
+   modification time) and the same choice of British spelling.  Must
+   be called after Ispell's banner has been read.  */
+
+void
+open_word_cache (void)
+{
+  struct stat stat_buf;
+  char *dict_name = dictionary ? dictionary : "";
+  char *key;
+
+  if (!word_cache_file || !word_verdicts)
+    return;
+
+  key = xmalloc (strlen (ispell_version) + strlen (dict_name) + 128);
+  if (dictionary && stat (dictionary, &stat_buf) == 0)
+    sprintf (key, "ispell %s\ndictionary %s %ld.%09ld\nbritish %d\n",
+	     ispell_version, dict_name, (long) stat_buf.st_mtime,
+	     (long) stat_buf.st_mtim.tv_nsec, british);
+  else
+    sprintf (key, "ispell %s\ndictionary %s\nbritish %d\n",
+	     ispell_version, dict_name, british);
+
+  verdict_attach (word_verdicts, word_cache_file, key);
+  free (key);
+}
+
+/* Start using `cache_dir' as `file_results', keying its entries by
+   everything that bears on what is found in a file: which engine and
+   dictionary do the checking (by name and modification time), and
+   the options that change what is printed.  */
+
+void
+open_results (void)
+{
+  struct stat stat_buf;
+  str_t *options = str_make (0);
+  char *dict_name = dictionary;
+  char line[64];
+  int i;
+
+  if (!dict_name && engine == ENGINE_BUILTIN)
+    dict_name = british ? BRITISH_WORD_LIST : WORD_LIST;
+
+  if (engine == ENGINE_ISPELL)
+    {
+      if (!ispell_prog)
+	ispell_prog = find_ispell ();
+      str_add_mem (options, "ispell ", 7);
+      str_add_mem (options, ispell_prog, strlen (ispell_prog));
+      if (stat (ispell_prog, &stat_buf) == 0)
+	{
+	  sprintf (line, " %ld", (long) stat_buf.st_mtime);
+	  str_add_mem (options, line, strlen (line));
+	}
+      sprintf (line, "\nwhole-lines %d\n", !use_word_cache);
+      str_add_mem (options, line, strlen (line));
+    }
+  else
+    {
+      str_add_mem (options, "builtin\naffixes ", 16);
+      if (!use_affixes)
+	str_add_mem (options, "none", 4);
+      else if (!affix_file)
+	str_add_mem (options, "builtin", 7);
+      else
+	{
+	  str_add_mem (options, affix_file, strlen (affix_file));
+	  if (stat (affix_file, &stat_buf) == 0)
+	    {
+	      sprintf (line, " %ld.%09ld", (long) stat_buf.st_mtime,
+		       (long) stat_buf.st_mtim.tv_nsec);
+	      str_add_mem (options, line, strlen (line));
+	    }
+	}
+      str_add_char (options, '\n');
+    }
+
+  if (dict_name)
+    {
+      str_add_mem (options, "dictionary ", 11);
+      str_add_mem (options, dict_name, strlen (dict_name));
+      if (stat (dict_name, &stat_buf) == 0)
+	{
+	  sprintf (line, " %ld.%09ld", (long) stat_buf.st_mtime,
+		   (long) stat_buf.st_mtim.tv_nsec);
+	  str_add_mem (options, line, strlen (line));
+	}
+      str_add_char (options, '\n');
+    }
+
+  for (i = 0; i < overlays; i++)
+    {
+      str_add_mem (options, "overlay ", 8);
+      str_add_mem (options, overlay[i], strlen (overlay[i]));
+      if (stat (overlay[i], &stat_buf) == 0)
+	{
+	  sprintf (line, " %ld.%09ld", (long) stat_buf.st_mtime,
+		   (long) stat_buf.st_mtim.tv_nsec);
+	  str_add_mem (options, line, strlen (line));
+	}
+      str_add_char (options, '\n');
+    }
+
+  if (stop_list)
+    {
+      str_add_mem (options, "stop-list ", 10);
+      str_add_mem (options, stop_list, strlen (stop_list));
+      if (stat (stop_list, &stat_buf) == 0)
+	{
+	  sprintf (line, " %ld.%09ld", (long) stat_buf.st_mtime,
+		   (long) stat_buf.st_mtim.tv_nsec);
+	  str_add_mem (options, line, strlen (line));
+	}
+      str_add_char (options, '\n');
+    }
+
+  sprintf (line, "british %d\nverbose %d\nstems %d\nnumber %d\n", british,
+	   verbose, print_stems, number_lines);
+  str_add_mem (options, line, strlen (line));
+  /* Suggestions with Ispell come from the installed word list too.  */
+  if (suggest)
+    {
+      const char *word_list = british ? BRITISH_WORD_LIST : WORD_LIST;
+
+      sprintf (line, "suggest %d", suggest_prefix);
+      str_add_mem (options, line, strlen (line));
+      if (engine == ENGINE_ISPELL && stat (word_list, &stat_buf) == 0)
+	{
+	  sprintf (line, " %ld.%09ld", (long) stat_buf.st_mtime,
+		   (long) stat_buf.st_mtim.tv_nsec);
+	  str_add_mem (options, line, strlen (line));
+	}
+      str_add_char (options, '\n');
+    }
+
+  file_results = results_open (cache_dir, str_to_nstr (options), cache_size);
+  str_free (options);
+}
+
+/* Load `dict_layers': for the builtin engine, the dictionary given,
+   or else the installed word list, and then the overlays; for Ispell,
+   which has its own, the overlays if there are any.  Word lists are
+   kept as `--dict-format' says; a compiled dictionary keeps the form
+   it was compiled in.  */
+
+void
+load_dict (void)
+{
+  uint64_t start = stats_now ();
+  int i;
+
+  if (engine == ENGINE_ISPELL && !overlays)
+    return;
+
+  dict_layers = layers_make (dict_format);
+  if (engine == ENGINE_BUILTIN)
+    {
+      layers_add (dict_layers, dictionary ? dictionary
+		  : british ? BRITISH_WORD_LIST : WORD_LIST);
+      first_overlay = 1;
+    }
+  for (i = 0; i < overlays; i++)
+    layers_add (dict_layers, overlay[i]);
+  dict_load_time = stats_now () - start;
+}
+
+/* Compile the rules the builtin engine strips affixes with into
+   `word_affixes', if `use_affixes'.  */
+
+void
+load_affixes (void)
+{
+  if (!use_affixes)
+    return;
+
+  word_affixes = affix_make ();
+  affix_load (word_affixes, affix_file);
+  affix_build (word_affixes);
+}
+
+/* Load `stop_dict' from the file given with `--stop-list', a word
+   list or a compiled dictionary, if one was.  */
+
+void
+load_stop_list (void)
+{
+  uint32_t elements = 128;
+  int c;
+
+  if (!stop_list)
+    return;
+  stop_dict = dict_load (stop_list);
+
+  for (c = 0; c < 256; c++)
+    stop_fold[c] = tolower (c);
+
+  /* Sixteen bits a word let about one word in seventy that is not in
+     the list through to its table.  */
+  while (elements < stop_dict->count / 2 && elements < (1UL << 26))
+    elements *= 2;
+  stop_mask = elements - 1;
+  stop_filter = xmalloc (elements * sizeof *stop_filter);
+  memset (stop_filter, 0, elements * sizeof *stop_filter);
+  dict_enumerate (stop_dict, "", 0, add_stop_word, NULL);
+}
+
+/* Add the LEN characters at WORD to `stop_filter', for
+   `dict_enumerate'.  */
+
+static void
+add_stop_word (const char *word, int len, void *arg)
+{
+  uint32_t hash = stop_hash (word, len);
+
+  stop_filter[hash & stop_mask] |= STOP_BITS (hash);
+}
+
+/* Build `word_suggest' from the words of the dictionary in use, if
+   `--suggest' was given: with the builtin engine, the word list it
+   checks against; with Ispell, the personal dictionary if one was
+   given, and the installed word list.  A word in both has the
+   frequency given in the first.  */
+
+void
+load_suggestions (void)
+{
+  uint64_t start = stats_now ();
+  const char *word_list = british ? BRITISH_WORD_LIST : WORD_LIST;
+
+  if (!suggest)
+    return;
+
+  word_suggest = suggest_make (suggest_prefix);
+  if (dictionary)
+    suggest_load (word_suggest, dictionary);
+  if (engine == ENGINE_ISPELL || !dictionary)
+    suggest_load (word_suggest, word_list);
+  suggest_build (word_suggest);
+  suggest_build_time = stats_now () - start;
+}
+
+/* If every file named in `argv' (ARGC being the number of arguments)
+   has an entry in `file_results', print them all and return nonzero.
+   Otherwise, return zero, having printed nothing.  */
+
+int
+replay_results (int argc, char **argv)
+{
+  int count = argc - optind;
+  str_t **found;
+  str_t *buf = str_make (0);
+  input_t input;
+  int errnum;
+  int i;
+  int all = 1;
+
+  if (count < 1)
+    return 0;
+
+  found = xmalloc (count * sizeof *found);
+  for (i = 0; i < count; i++)
+    found[i] = NULL;
+
+  for (i = 0; all && i < count; i++)
+    {
+      char *file = argv[optind + i];
+
+      if ((file[0] == '-' && file[1] == 0)
+	  || open_input (file, &input, buf, &errnum))
+	all = 0;
+      else
+	{
+	  found[i] = str_make (0);
+	  all = (!input.stream
+		 && results_fetch (file_results, input.map, input.map_len,
+				   found[i]));
+	  close_input (&input, file);
+	}
+    }
+
+  for (i = 0; i < count; i++)
+    if (found[i])
+      {
+	if (all)
+	  {
+	    run_stats.files++;
+	    run_stats.cached++;
+	    run_stats.misspelled += count_lines (found[i]);
+	    print_results (NULL, argv[optind + i], found[i]);
+	  }
+	str_free (found[i]);
+      }
+  free (found);
+  str_free (buf);
+
+  return all;
+}
+
+/* Print the misspellings in *FOUND, which were found in FILE and
+   printed there by `print_word' without the file name, adding it if
+   `--print-file-name' was given.  Append them to *OUT, or print them
+   to stdout if OUT is NULL.  */
+
+void
+print_results (str_t * out, char *file, str_t * found)
+{
+  char *line;
+  char *end;
+
+  if (!print_file_names)
+    {
+      if (out)
+	str_add_mem (out, found->str, found->len);
+      else
+	out_mem (found->str, found->len);
+      return;
+    }
+
+  for (line = found->str; line < found->str + found->len; line = end + 1)
+    {
+      end = memchr (line, '\n', found->str + found->len - line);
+      if (out)
+	{
+	  str_add_mem (out, file, strlen (file));
+	  str_add_char (out, ':');
+	  if (!number_lines)
+	    str_add_char (out, ' ');
+	  str_add_mem (out, line, end + 1 - line);
+	}
+      else
+	{
+	  out_mem (file, strlen (file));
+	  out_char (':');
+	  if (!number_lines)
+	    out_char (' ');
+	  out_mem (line, end + 1 - line);
+	}
+    }
+}
+
+/* Check each file named in `argv' (or the standard input if there are
+   no arguments), given `argc' (the number of arguments), in order.
+   Send them to Ispell through *THE_PIPE (created by `new_pipe'), or
+   check them with the builtin engine if THE_PIPE is NULL.  */
+
+void
+read_files (pipe_t * the_pipe, int argc, char **argv)
+{
+  struct worker worker;
+  input_t input;
+  char *file = NULL;
+  const char *problem = NULL;
+  int errnum = 0;
+  int arg_index = optind;
+
+  init_worker (&worker, the_pipe);
+
+  if (optind == argc)
+    {
+      input_stream (&input, stdin, worker.scratch.line);
+      check_input (&worker, &input, "-", NULL);
+      input_close (&input);
+      out_flush ();
+    }
+
+  for (; arg_index < argc; arg_index++)
+    {
+      file = argv[arg_index];
+
+      problem = open_input (file, &input, worker.scratch.line, &errnum);
+      if (problem)
+	{
+	  drain_pipe (the_pipe);
+	  error (0, errnum, "%s: %s", file, problem);
+	  continue;
+	}
+
+      check_input (&worker, &input, file, NULL);
+      close_input (&input, file);
+      out_flush ();
+    }
+
+  drain_pipe (the_pipe);
+  stats_add (&run_stats, &worker.stats);
+}
+
+/* Check the file *FILE, opened as *INPUT by `open_input', the way
+   *WORKER (set up by `init_worker') does, with the version of
+   `dict_layers' published as it starts, all the way through.  Append
+   the output to *OUT, or print it if OUT is NULL.  */
+
+void
+check_input (struct worker *worker, input_t * input, char *file,
+	     str_t * out)
 {
-  error (EXIT_FAILURE, 0, "broken pipe");
+  uint64_t start = show_stats ? stats_now () : 0;
+  str_t *found;
+  int ticket;
+
+  worker->stats.files++;
+  if (dict_layers)
+    {
+      worker->layers = layers_enter (dict_layers, &ticket);
+      if (worker->pipe)
+	worker->pipe->layers = worker->layers;
+    }
+
+  /* Only a mapped file (or an empty one) can be hashed before it is
+     checked.  The results kept were found with the dictionaries as
+     first loaded.  */
+  if (!file_results || input->stream
+      || (worker->layers && worker->layers->version))
+    {
+      if (worker->pipe)
+	read_file (worker->pipe, input, file, out);
+      else
+	check_file (worker, input, file, out);
+    }
+  else
+    {
+      found = str_make (worker->found);
+      if (!results_fetch (file_results, input->map, input->map_len, found))
+	{
+	  if (worker->pipe)
+	    read_file (worker->pipe, input, NULL, found);
+	  else
+	    check_file (worker, input, NULL, found);
+	  drain_pipe (worker->pipe);
+	  results_store (file_results, input->map, input->map_len,
+			 found->str, found->len);
+	}
+      else
+	{
+	  worker->stats.cached++;
+	  worker->stats.misspelled += count_lines (found);
+	}
+
+      /* With the file's output in hand, print it now, after whatever
+         is still on its way from the files before.  */
+      if (!out)
+	drain_pipe (worker->pipe);
+      print_results (out, file, found);
+    }
+
+  if (dict_layers)
+    {
+      layers_leave (dict_layers, ticket);
+      worker->layers = NULL;
+      if (worker->pipe)
+	worker->pipe->layers = NULL;
+    }
+
+  /* With Ispell, this is the time to read the file and send it; the
+     answers to its last lines may still be on their way.  */
+  if (show_stats)
+    histogram_record (&worker->stats.file_time, stats_now () - start);
 }
 
-/* Handle the SIGCHLD signal.  */
+/* Return the number of lines in *STR.  */
 
-static void
-sig_chld (int signo)
+long
+count_lines (str_t * str)
 {
-  error (EXIT_FAILURE, 0, "Ispell died");
+  char *end = str->str + str->len;
+  char *pos;
+  long lines = 0;
+
+  for (pos = str->str; (pos = memchr (pos, '\n', end - pos)); pos++)
+    lines++;
+  return lines;
 }
 
-/* Send lines to and retrieve lines from *THE_PIPE (created by
-   `new_pipe').  Accept `argc' (the number of arguments) and `argv'
-   (the array of arguments), so we can search for the files we are to
-   read.  Handle all communication with Ispell at a managerial level;
-   must be called by the parent process.  */
+/* Set up *WORKER to check files through *THE_PIPE (created by
+   `new_pipe'), or with the builtin engine if THE_PIPE is NULL.  */
 
 void
-parent (pipe_t * the_pipe, int argc, char **argv)
+init_worker (struct worker *worker, pipe_t * the_pipe)
+{
+  worker->pipe = the_pipe;
+  worker->scratch.line = str_make (0);
+  worker->found = str_make (0);
+  worker->scratch.spans.span = NULL;
+  worker->scratch.spans.len = worker->scratch.spans.mem = 0;
+  stats_init (&worker->stats);
+  worker->layers = NULL;
+}
+
+/* Open the file FILE for checking as *INPUT, reading through the
+   string *BUF (created by `str_make') if it cannot be mapped; `-'
+   means the standard input.  A file compressed with gzip or Zstandard
+   is unpacked as it is read (see `unpack_input').  Return NULL if
+   successful.  Otherwise return what went wrong, setting *ERRNUM to
+   the error number that goes with it (or zero).  */
+
+const char *
+open_input (char *file, input_t * input, str_t * buf, int *errnum)
 {
+  struct stat stat_buf;
   FILE *stream;
-  char *file = NULL;
-  int arg_error = 0;
-  int arg_index = optind;
 
-  /* Close the child's end of the pipes.  This is very important, as I
-     found out the hard way.  */
-  close (the_pipe->cin);
-  close (the_pipe->cout);
-  close (the_pipe->cerr);
+  *errnum = 0;
+
+  if (file[0] == '-' && file[1] == 0)
+    {
+      /* Only the first `-' gets anything; the others see EOF, as
+         they would once it had read it all, even when they are
+         checked at the same time as it (`--jobs').  */
+      if (stdin_operand && file != stdin_operand)
+	{
+	  input_stream (input, NULL, buf);
+	  input->eof = 1;
+	  return NULL;
+	}
+      input_stream (input, stdin, buf);
+      unpack_input (input);
+      return NULL;
+    }
 
-  read_ispell_errors (the_pipe);
+  if (stat (file, &stat_buf) == -1)
+    {
+      *errnum = errno;
+      return "stat error";
+    }
+  if (S_ISDIR (stat_buf.st_mode))
+    return "is a directory";
 
-  /* This block parses Ispell's banner and grabs its version.  It then
-     prints it if the flag `--ispell-version' or `-I' was used.
-     FIXME: check that the version is high enough that it is going to
-     be able to interact with GNU Spell sucessfully.  */
+  if (S_ISREG (stat_buf.st_mode))
+    {
+      *errnum = input_map (input, file, buf);
+      if (!*errnum)
+	{
+	  unpack_input (input);
+	  return NULL;
+	}
+      if (*errnum > 0)
+	return "open error";
+      *errnum = 0;
+    }
 
-  {
-    int pos = 0;
-    str_t *ispell_version = str_make (0);
-    str_t *str = str_make (0);
+  stream = fopen (file, "r");
+  if (!stream)
+    {
+      *errnum = errno;
+      return "open error";
+    }
+  input_stream (input, stream, buf);
+  unpack_input (input);
 
-    if (str_add_line_from_desc (str, the_pipe->pin) == ADD_LINE_EOF)
-      error (EXIT_FAILURE, 0, "premature EOF from Ispell's stdout");
+  return NULL;
+}
 
-    for (; !isdigit (str->str[pos]) && pos <= str->len; pos++);
-    for (; str->str[pos] != ' ' && pos <= str->len; pos++)
-      str_add_char (ispell_version, str->str[pos]);
+/* Close *INPUT, opened for the file *FILE by `open_input'.  */
 
-    if (show_ispell_version)
-      {
-	printf ("%s: Ispell version %s\n", program_name,
-		str_to_nstr (ispell_version));
-	exit (EXIT_SUCCESS);
-      }
-  }
+void
+close_input (input_t * input, char *file)
+{
+  const char *problem;
+  int errnum;
+
+  if (input->stream && input->stream != stdin
+      && fclose (input->stream) == EOF)
+    error (0, errno, "%s: close error", file);
+  if (input->unpack)
+    {
+      problem = unpack_finish (input->unpack, &errnum);
+      if (problem)
+	error (0, errnum, "%s: %s", file, problem);
+    }
+  input_close (input);
+}
 
-  file = xstrdup ("-");
+/* Check the files named in `argv', given `argc' (the number of
+   arguments), with a pool of `jobs' worker threads.  Each talks to
+   its own Ispell through one of the array of pipes PIPES or, if PIPES
+   is NULL, checks with the builtin engine, all threads sharing
+   `dict_layers'.  A worker takes
+   the next file not yet taken; the main thread prints the output for
+   each file, in the order the files were named, once it is
+   complete.  */
 
-  if (argc == 1)
-    read_file (the_pipe, stdin, "-");
+void
+run_jobs (pipe_t * pipes, int argc, char **argv)
+{
+  struct worker *worker = xmalloc (jobs * sizeof *worker);
+  pthread_t *thread = xmalloc (jobs * sizeof *thread);
+  int err;
+  int i;
+
+  queue.count = argc - optind;
+  queue.job = xmalloc (queue.count * sizeof *queue.job);
+  for (i = 0; i < queue.count; i++)
+    {
+      queue.job[i].file = argv[optind + i];
+      queue.job[i].out = str_make (0);
+      queue.job[i].problem = NULL;
+      queue.job[i].errnum = 0;
+      queue.job[i].done = 0;
+    }
+  queue.next = queue.flushed = 0;
+  pthread_mutex_init (&queue.lock, NULL);
+  pthread_cond_init (&queue.changed, NULL);
 
-  while (arg_index < argc)
+  for (i = 0; i < jobs; i++)
     {
-      arg_error = 0;
+      init_worker (&worker[i], pipes ? &pipes[i] : NULL);
+      err = pthread_create (&thread[i], NULL, pool_worker, &worker[i]);
+      if (err)
+	error (EXIT_FAILURE, err, "error creating worker thread");
+    }
 
-      file = argv[arg_index];
+  for (i = 0; i < queue.count; i++)
+    {
+      struct job *job = &queue.job[i];
+
+      pthread_mutex_lock (&queue.lock);
+      while (!job->done)
+	pthread_cond_wait (&queue.changed, &queue.lock);
+      pthread_mutex_unlock (&queue.lock);
+
+      if (job->problem)
+	error (0, job->errnum, "%s: %s", job->file, job->problem);
+      else
+	{
+	  out_mem (job->out->str, job->out->len);
+	  out_flush ();
+	}
+      str_free (job->out);
+
+      pthread_mutex_lock (&queue.lock);
+      queue.flushed++;
+      pthread_cond_broadcast (&queue.changed);
+      pthread_mutex_unlock (&queue.lock);
+    }
+
+  /* Every job is done and printed; wait for the workers to find no
+     more, so that none is still running when the output is closed
+     and the process exits.  */
+  for (i = 0; i < jobs; i++)
+    {
+      err = pthread_join (thread[i], NULL);
+      if (err)
+	error (EXIT_FAILURE, err, "error joining worker thread");
+      stats_add (&run_stats, &worker[i].stats);
+    }
+  free (thread);
+}
+
+/* Body of a worker thread of the pool run by `run_jobs', checking
+   the way ARG (a `struct worker *') says.  Check files until there
+   are none left, keeping the output for each in its job.  A worker
+   does not run more than `MAX_AHEAD' files ahead of the output, so
+   that the output waiting to be printed stays bounded.  */
+
+static void *
+pool_worker (void *arg)
+{
+  struct worker *worker = arg;
+
+  while (1)
+    {
+      struct job *job;
+      input_t input;
+
+      pthread_mutex_lock (&queue.lock);
+      while (queue.next < queue.count
+	     && queue.next >= queue.flushed + MAX_AHEAD * jobs)
+	pthread_cond_wait (&queue.changed, &queue.lock);
+      job = queue.next < queue.count ? &queue.job[queue.next++] : NULL;
+      pthread_mutex_unlock (&queue.lock);
+
+      if (!job)
+	return NULL;
+
+      job->problem = open_input (job->file, &input, worker->scratch.line,
+				 &job->errnum);
+      if (!job->problem)
+	{
+	  check_input (worker, &input, job->file, job->out);
+	  drain_pipe (worker->pipe);
+	  close_input (&input, job->file);
+	}
+
+      pthread_mutex_lock (&queue.lock);
+      job->done = 1;
+      pthread_cond_broadcast (&queue.changed);
+      pthread_mutex_unlock (&queue.lock);
+    }
+}
 
-      if (file[0] == '-' && file[1] == 0)
+/* Check the files that clients send to `serve_socket', until told to
+   stop by a signal.  Each client is served by a thread of its own,
+   and each file is checked through whichever of the COUNT pipes at
+   PIPES is free, or with the builtin engine if PIPES is NULL, so that
+   neither Ispell nor the dictionary is started or loaded anew for
+   any of them.  */
+
+void
+serve (pipe_t * pipes, int count)
+{
+  struct sockaddr_un addr;
+  struct sigaction action;
+  pthread_attr_t attr;
+  pthread_t thread;
+  int listener;
+  int client;
+  int err;
+
+  pool.pipes = pipes;
+  pool.count = count;
+  pool.busy = xmalloc (count + 1);
+  memset (pool.busy, 0, count + 1);
+  pool.clients = 0;
+  pthread_mutex_init (&pool.lock, NULL);
+  pthread_cond_init (&pool.changed, NULL);
+  pthread_cond_init (&pool.gone, NULL);
+
+  if (strlen (serve_socket) >= sizeof addr.sun_path)
+    error (EXIT_FAILURE, 0, "%s: socket name too long", serve_socket);
+  memset (&addr, 0, sizeof addr);
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, serve_socket);
+
+  listener = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0)
+    error (EXIT_FAILURE, errno, "error creating socket");
+  fcntl (listener, F_SETFD, FD_CLOEXEC);
+
+  /* A socket left behind by a server that is gone is in the way, but
+     one that a server still answers on is not ours to take.  */
+  if (bind (listener, (struct sockaddr *) &addr, sizeof addr) < 0)
+    {
+      int probe;
+
+      if (errno != EADDRINUSE)
+	error (EXIT_FAILURE, errno, "%s: cannot bind", serve_socket);
+      probe = socket (AF_UNIX, SOCK_STREAM, 0);
+      if (probe >= 0
+	  && connect (probe, (struct sockaddr *) &addr, sizeof addr) == 0)
+	error (EXIT_FAILURE, 0, "%s: already being served", serve_socket);
+      close (probe);
+      unlink (serve_socket);
+      if (bind (listener, (struct sockaddr *) &addr, sizeof addr) < 0)
+	error (EXIT_FAILURE, errno, "%s: cannot bind", serve_socket);
+    }
+  if (listen (listener, SOMAXCONN) < 0)
+    error (EXIT_FAILURE, errno, "%s: cannot listen", serve_socket);
+
+  /* Without `SA_RESTART', as `signal' would have it, so that the
+     signal ends the wait in `accept'.  */
+  action.sa_handler = sig_stop;
+  sigemptyset (&action.sa_mask);
+  action.sa_flags = 0;
+  sigaction (SIGINT, &action, NULL);
+  sigaction (SIGTERM, &action, NULL);
+
+  pthread_attr_init (&attr);
+  pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+
+  while (!stop_serving)
+    {
+      client = accept (listener, NULL, NULL);
+      if (client < 0)
+	{
+	  if (errno == EINTR || errno == ECONNABORTED)
+	    continue;
+	  error (EXIT_FAILURE, errno, "%s: cannot accept", serve_socket);
+	}
+      fcntl (client, F_SETFD, FD_CLOEXEC);
+
+      pthread_mutex_lock (&pool.lock);
+      pool.clients++;
+      pthread_mutex_unlock (&pool.lock);
+      err = pthread_create (&thread, &attr, serve_client,
+			    (void *) (long) client);
+      if (err)
+	{
+	  error (0, err, "error creating thread");
+	  close (client);
+	  pthread_mutex_lock (&pool.lock);
+	  pool.clients--;
+	  pthread_mutex_unlock (&pool.lock);
+	}
+    }
+
+  close (listener);
+  unlink (serve_socket);
+
+  /* Let the clients already taken have all their files checked and
+     their answers sent, before the caches they use are saved.  */
+  pthread_mutex_lock (&pool.lock);
+  while (pool.clients)
+    pthread_cond_wait (&pool.gone, &pool.lock);
+  pthread_mutex_unlock (&pool.lock);
+}
+
+/* Body of the thread serving the client connected to the socket ARG
+   (an `int' in a `void *').  Check each file it sends, and send back
+   what was found in it.  */
+
+static void *
+serve_client (void *arg)
+{
+  int client = (long) arg;
+  struct worker worker;
+  str_t *message = str_make (0);
+  str_t *text = str_make (0);
+  str_t *found = str_make (0);
+  char *file = NULL;
+  input_t input;
+  int kind;
+
+  init_worker (&worker, NULL);
+
+  while ((kind = read_message (client, message, SERVE_CHUNK)) != EOF)
+    {
+      if (kind == MESSAGE_HELLO)
 	{
-	  if (!read_stdin)
+	  if (message->len != strlen (SERVE_PROTOCOL)
+	      || memcmp (message->str, SERVE_PROTOCOL, message->len))
 	    {
-	      read_stdin = 1;
-	      stream = stdin;
+	      send_message (client, MESSAGE_ERROR, "protocol mismatch", 17);
+	      break;
 	    }
 	}
+      else if (kind == MESSAGE_FILE)
+	{
+	  free (file);
+	  file = str_to_nstr (message);
+	  text = str_make (text);
+	}
+      else if (kind == MESSAGE_DATA)
+	str_add_mem (text, message->str, message->len);
+      else if (kind == MESSAGE_END && file)
+	{
+	  worker.pipe = take_pipe ();
+	  input_mem (&input, text->str, text->len);
+	  found = str_make (found);
+	  check_input (&worker, &input, file, found);
+	  drain_pipe (worker.pipe);
+	  input_close (&input);
+	  give_pipe (worker.pipe);
+
+	  if (send_message (client, MESSAGE_FOUND, found->str, found->len)
+	      || send_message (client, MESSAGE_DONE, NULL, 0))
+	    break;
+	}
       else
 	{
-	  struct stat stat_buf;
+	  send_message (client, MESSAGE_ERROR, "bad request", 11);
+	  break;
+	}
+    }
 
-	  if (stat (file, &stat_buf) == -1)
-	    {
-	      error (0, errno, "%s: stat error", file);
-	      arg_index++;
-	      continue;
-	    }
-	  if (S_ISDIR (stat_buf.st_mode))
-	    {
-	      error (0, 0, "%s: is a directory", file);
-	      arg_index++;
-	      continue;
-	    }
+  close (client);
+  free (file);
+  str_free (message);
+  str_free (text);
+  str_free (found);
+  str_free (worker.scratch.line);
+  str_free (worker.found);
+  free (worker.scratch.spans.span);
+
+  /* Only now may `serve' return.  */
+  pthread_mutex_lock (&pool.lock);
+  stats_add (&run_stats, &worker.stats);
+  pool.clients--;
+  pthread_cond_signal (&pool.gone);
+  pthread_mutex_unlock (&pool.lock);
+  return NULL;
+}
+
+/* Return a pipe from `pool' that no other thread is using, waiting for
+   one to be freed if need be, or NULL if the pool has none (the
+   builtin engine is in use).  */
+
+pipe_t *
+take_pipe (void)
+{
+  int i;
+
+  if (!pool.count)
+    return NULL;
+
+  pthread_mutex_lock (&pool.lock);
+  while (1)
+    {
+      for (i = 0; i < pool.count && pool.busy[i]; i++);
+      if (i < pool.count)
+	break;
+      pthread_cond_wait (&pool.changed, &pool.lock);
+    }
+  pool.busy[i] = 1;
+  pthread_mutex_unlock (&pool.lock);
+  return &pool.pipes[i];
+}
+
+/* Let other threads use *THE_PIPE, taken with `take_pipe'.  */
+
+void
+give_pipe (pipe_t * the_pipe)
+{
+  if (!the_pipe)
+    return;
+
+  pthread_mutex_lock (&pool.lock);
+  pool.busy[the_pipe - pool.pipes] = 0;
+  pthread_cond_signal (&pool.changed);
+  pthread_mutex_unlock (&pool.lock);
+}
+
+/* Send each file named in `argv', given `argc' (the number of
+   arguments), or the standard input if there are none, to the server
+   at `connect_socket', and print what it finds in them just as if
+   they had been checked here.  */
+
+void
+run_client (int argc, char **argv)
+{
+  struct sockaddr_un addr;
+  str_t *buf = str_make (0);
+  const char *problem;
+  input_t input;
+  int errnum;
+  int sock;
+  int i;
+
+  if (strlen (connect_socket) >= sizeof addr.sun_path)
+    error (EXIT_FAILURE, 0, "%s: socket name too long", connect_socket);
+  memset (&addr, 0, sizeof addr);
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, connect_socket);
+
+  sock = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (sock < 0)
+    error (EXIT_FAILURE, errno, "error creating socket");
+  if (connect (sock, (struct sockaddr *) &addr, sizeof addr) < 0)
+    error (EXIT_FAILURE, errno, "%s: cannot connect", connect_socket);
+  if (send_message (sock, MESSAGE_HELLO, SERVE_PROTOCOL,
+		    strlen (SERVE_PROTOCOL)))
+    error (EXIT_FAILURE, errno, "%s: write error", connect_socket);
+
+  if (argc == optind)
+    {
+      input_stream (&input, stdin, buf);
+      check_served (sock, &input, "-", buf);
+      input_close (&input);
+    }
+
+  for (i = optind; i < argc; i++)
+    {
+      problem = open_input (argv[i], &input, buf, &errnum);
+      if (problem)
+	{
+	  error (0, errnum, "%s: %s", argv[i], problem);
+	  continue;
+	}
+      check_served (sock, &input, argv[i], buf);
+      close_input (&input, argv[i]);
+    }
+
+  close (sock);
+  str_free (buf);
+}
+
+/* Send the file FILE, opened as *INPUT by `open_input', to the server
+   connected to SOCK to be checked, and print what it finds.  *BUF is
+   the string *INPUT reads lines into, and is used for the reply
+   too.  */
+
+void
+check_served (int sock, input_t * input, char *file, str_t * buf)
+{
+  str_t *chunk = str_make (0);
+  char *text;
+  int len;
+  int kind;
+
+  if (send_message (sock, MESSAGE_FILE, file, strlen (file)))
+    error (EXIT_FAILURE, errno, "%s: write error", connect_socket);
+
+  /* Lines are gathered into messages of `SERVE_CHUNK' bytes, a long
+     line being split among as many as it takes.  */
+  while (1)
+    {
+      int more = input_line (input, &text, &len) == ADD_LINE_OK;
+
+      if (!more)
+	len = 0;
+      do
+	{
+	  int take = SERVE_CHUNK - chunk->len;
+
+	  if (len < take)
+	    take = len;
 
-	  stream = fopen (file, "r");
-	  if (!stream)
+	  str_add_mem (chunk, text, take);
+	  text += take;
+	  len -= take;
+	  if (chunk->len && (chunk->len == SERVE_CHUNK || !more))
 	    {
-	      error (0, errno, "%s: open error", file);
-	      arg_error = 1;
+	      if (send_message (sock, MESSAGE_DATA, chunk->str, chunk->len))
+		error (EXIT_FAILURE, errno, "%s: write error",
+		       connect_socket);
+	      str_make (chunk);
 	    }
 	}
+      while (len);
+      if (!more)
+	break;
+    }
+  str_free (chunk);
+
+  if (send_message (sock, MESSAGE_END, NULL, 0))
+    error (EXIT_FAILURE, errno, "%s: write error", connect_socket);
+
+  while ((kind = read_message (sock, str_make (buf), LONG_MAX))
+	 != MESSAGE_DONE)
+    if (kind == MESSAGE_FOUND)
+      print_served (file, buf);
+    else if (kind == MESSAGE_ERROR)
+      error (EXIT_FAILURE, 0, "%s: %s", connect_socket, str_to_nstr (buf));
+    else
+      error (EXIT_FAILURE, 0, "%s: lost the server", connect_socket);
+
+  out_flush ();
+}
+
+/* Print the misspellings in *FOUND, which the server found in FILE and
+   put each after its line number, as `print_word' would have printed
+   them, with the file name and line number only if they were asked
+   for.  */
+
+void
+print_served (char *file, str_t * found)
+{
+  char *line;
+  char *end;
+
+  for (line = found->str; line < found->str + found->len; line = end + 1)
+    {
+      char *word = line;
+
+      end = memchr (line, '\n', found->str + found->len - line);
+      if (!end)
+	break;
+
+      if (print_file_names)
+	{
+	  out_mem (file, strlen (file));
+	  out_char (':');
+	  if (!number_lines)
+	    out_char (' ');
+	}
+      if (!number_lines)
+	word = memchr (line, ' ', end - line) + 1;
+      out_mem (word, end + 1 - word);
+    }
+}
+
+/* Send a message of kind KIND, with the LEN bytes at DATA, to the
+   socket SOCK.  Return zero if it was sent, or nonzero if the other
+   end is gone (with `errno' set).  */
+
+int
+send_message (int sock, int kind, const char *data, long len)
+{
+  unsigned char head[5];
+  struct iovec iov[2];
+  struct msghdr msg;
+  ssize_t sent;
+
+  head[0] = kind;
+  head[1] = len >> 24;
+  head[2] = len >> 16;
+  head[3] = len >> 8;
+  head[4] = len;
+  iov[0].iov_base = head;
+  iov[0].iov_len = sizeof head;
+  iov[1].iov_base = (char *) data;
+  iov[1].iov_len = len;
+  memset (&msg, 0, sizeof msg);
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+
+  /* `MSG_NOSIGNAL' keeps a client that goes away from raising
+     SIGPIPE, which would end the server.  */
+  while (msg.msg_iovlen)
+    {
+      sent = sendmsg (sock, &msg, MSG_NOSIGNAL);
+      if (sent < 0 && errno == EINTR)
+	continue;
+      if (sent < 0)
+	return -1;
+
+      for (; msg.msg_iovlen && (size_t) sent >= msg.msg_iov->iov_len;
+	   msg.msg_iov++, msg.msg_iovlen--)
+	sent -= msg.msg_iov->iov_len;
+      if (msg.msg_iovlen)
+	{
+	  msg.msg_iov->iov_base = (char *) msg.msg_iov->iov_base + sent;
+	  msg.msg_iov->iov_len -= sent;
+	}
+    }
+  return 0;
+}
+
+/* Read a message from the socket SOCK into *DATA (created with
+   `str_make'), which must have nothing in it yet, and return its
+   kind.  Return EOF if the other end has gone away, or if the
+   message is broken off or has more than MAX bytes of data.  */
+
+int
+read_message (int sock, str_t * data, long max)
+{
+  unsigned char head[5];
+  long len;
+  long got;
+  ssize_t nchars;
+
+  for (got = 0; got < 5; got += nchars)
+    {
+      nchars = read (sock, head + got, 5 - got);
+      if (nchars < 0 && errno == EINTR)
+	nchars = 0;
+      else if (nchars <= 0)
+	return EOF;
+    }
 
-      if (!arg_error)
-	read_file (the_pipe, stream, file);
+  len = (long) head[1] << 24 | head[2] << 16 | head[3] << 8 | head[4];
+  if (len > max)
+    return EOF;
 
-      arg_index++;
+  str_reserve (data, len);
+  for (got = 0; got < len; got += nchars)
+    {
+      nchars = read (sock, data->str + got, len - got);
+      if (nchars < 0 && errno == EINTR)
+	nchars = 0;
+      else if (nchars <= 0)
+	return EOF;
     }
+  data->len = len;
+
+  return head[0];
 }
 
 /* Execute the Ispell program after the fork.  Must be in the child
@@ -614,16 +3598,28 @@ run_ispell_in_child (pipe_t * the_pipe)
   close (the_pipe->perr);
 
   if (the_pipe->cin != STDIN_FILENO)
-    if (dup2 (the_pipe->cin, STDIN_FILENO) != STDIN_FILENO)
-      error (EXIT_FAILURE, errno, "error duping to stdin");
+    {
+      if (dup2 (the_pipe->cin, STDIN_FILENO) != STDIN_FILENO)
+	error (EXIT_FAILURE, errno, "error duping to stdin");
+    }
+  else
+    fcntl (STDIN_FILENO, F_SETFD, 0);
 
   if (the_pipe->cout != STDOUT_FILENO)
-    if (dup2 (the_pipe->cout, STDOUT_FILENO) != STDOUT_FILENO)
-      error (EXIT_FAILURE, errno, "error duping to stdout");
+    {
+      if (dup2 (the_pipe->cout, STDOUT_FILENO) != STDOUT_FILENO)
+	error (EXIT_FAILURE, errno, "error duping to stdout");
+    }
+  else
+    fcntl (STDOUT_FILENO, F_SETFD, 0);
 
   if (the_pipe->cerr != STDERR_FILENO)
-    if (dup2 (the_pipe->cerr, STDERR_FILENO) != STDERR_FILENO)
-      error (EXIT_FAILURE, errno, "error duping to stderr");
+    {
+      if (dup2 (the_pipe->cerr, STDERR_FILENO) != STDERR_FILENO)
+	error (EXIT_FAILURE, errno, "error duping to stderr");
+    }
+  else
+    fcntl (STDERR_FILENO, F_SETFD, 0);
 
   if (dictionary != NULL)
     if (execl (ispell_prog, "ispell", "-a", "-p", dictionary, NULL)
@@ -666,6 +3662,7 @@ error (int status, int errnum, const char *message,...)
 {
   va_list args;
 
+  out_flush ();
   fflush (stdout);
   fprintf (stderr, "%s: ", program_name);
 
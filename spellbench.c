@@ -0,0 +1,1669 @@
+/* spellbench.c -- measure how fast spell checks a made-up corpus.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+   Usage: spellbench [OPTION]...
+
+   Write a corpus of text made of words drawn from a word list, some
+   of them misspelled on purpose, then run spell over it in each of
+   the ways it can check words.  For each way, report how many lines,
+   words and megabytes a second go through, how long one line typed
+   at spell takes to come back (the median and the 99th percentile),
+   and the most memory spell used.  A few ways also check a file that
+   is all one line, hundreds of megabytes long, and fail unless spell
+   does so in a fixed amount of memory and reports the run of letters
+   in its middle, longer than spell reads at once, as just one
+   misspelled word.  A few check the corpus
+   compressed with gzip, both given to spell as it is and unpacked by
+   `zcat' into a pipe, as in `zcat FILE... | spell'.  Then time how
+   long a run of spell over a small file takes, started cold and sent
+   to a server started with `--serve'.  Each result is also appended
+   as a line of JSON to the output file, so that runs of different
+   releases can be compared.  The same seed and options always make
+   the same corpus.  */
+
+/* For `posix_openpt' and its kin, and `cfmakeraw'.  */
+#define _GNU_SOURCE
+
+/* Local headers.  */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dict.h"
+#include "getopt.h"
+
+/* System headers.  */
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else /* not HAVE_STRING_H */
+#include <strings.h>
+#endif /* not HAVE_STRING_H */
+
+/* The longest line the corpus may have.  */
+#define MAX_LINE 4096
+
+/* How many letters make the word in the middle of the file of one
+   line, and how long an output line must be to be taken for it.  */
+#define LONG_WORD 20000
+#define LONG_WORD_SEEN 1000
+
+/* The most files the corpus may have.  */
+#define MAX_FILES 1000
+
+/* How long to wait for spell to answer a line before giving up on
+   timing its latency, in milliseconds.  */
+#define LATENCY_TIMEOUT 10000
+
+/* What a case needs or does beyond running spell over the files.  */
+#define NEEDS_ISPELL 1		/* Skip it when there is no Ispell.  */
+#define WARM 2			/* Run once untimed first, to fill
+				   the caches.  */
+#define FROM_PIPE 4		/* Send the corpus through a pipe on
+				   the standard input.  */
+#define ONE_LINE 8		/* Check the file of one line instead
+				   of the corpus, untimed line by line,
+				   within `rss_limit'.  */
+#define GZIPPED 16		/* Check the corpus compressed with
+				   gzip, untimed line by line; through
+				   a pipe, unpacked by `zcat'.  */
+
+/* A way to run spell.  In its arguments, `@ispell', `@words' and
+   `@dir' stand for the Ispell program, the word list and the
+   directory the corpus is in.  */
+struct bench_case
+  {
+    const char *name;
+    int flags;
+    const char *args[6];
+  };
+
+static const struct bench_case cases[] =
+{
+  {"ispell", NEEDS_ISPELL, {"-i", "@ispell"}},
+  {"ispell-whole-lines", NEEDS_ISPELL, {"-i", "@ispell", "--no-word-cache"}},
+  {"ispell-jobs-4", NEEDS_ISPELL, {"-i", "@ispell", "-j", "4"}},
+  {"ispell-pipe", NEEDS_ISPELL | FROM_PIPE, {"-i", "@ispell"}},
+  {"ispell-word-cache", NEEDS_ISPELL | WARM,
+   {"-i", "@ispell", "--word-cache=@dir/verdicts"}},
+  {"ispell-cache-dir", NEEDS_ISPELL | WARM,
+   {"-i", "@ispell", "--cache-dir=@dir/results"}},
+  {"builtin", 0, {"--engine=builtin", "-d", "@words"}},
+  {"builtin-compiled", 0, {"-d", "@dir/words.sdict"}},
+  {"builtin-jobs-4", 0, {"--engine=builtin", "-d", "@words", "-j", "4"}},
+  {"builtin-pipe", FROM_PIPE, {"--engine=builtin", "-d", "@words"}},
+  {"builtin-cache-dir", WARM,
+   {"--engine=builtin", "-d", "@words", "--cache-dir=@dir/results"}},
+  {"builtin-affixes", 0,
+   {"--engine=builtin", "-d", "@words", "--affixes"}},
+  {"builtin-stems", 0, {"--engine=builtin", "-d", "@words", "-v", "-x"}},
+  {"builtin-dawg", 0,
+   {"--engine=builtin", "-d", "@words", "--dict-format=dawg"}},
+  {"builtin-dawg-compiled", 0, {"-d", "@dir/words.sdawg"}},
+  {"builtin-suggest", 0, {"--engine=builtin", "-d", "@words", "--suggest"}},
+  {"builtin-suggest-p7", 0,
+   {"--engine=builtin", "-d", "@words", "--suggest", "--suggest-prefix=7"}},
+  {"ispell-one-line", NEEDS_ISPELL | ONE_LINE, {"-i", "@ispell"}},
+  {"ispell-one-line-whole-lines", NEEDS_ISPELL | ONE_LINE,
+   {"-i", "@ispell", "--no-word-cache"}},
+  {"builtin-one-line", ONE_LINE, {"--engine=builtin", "-d", "@words"}},
+  {"builtin-one-line-pipe", ONE_LINE | FROM_PIPE,
+   {"--engine=builtin", "-d", "@words"}},
+  {"ispell-gzip", NEEDS_ISPELL | GZIPPED, {"-i", "@ispell"}},
+  {"ispell-zcat-pipe", NEEDS_ISPELL | GZIPPED | FROM_PIPE,
+   {"-i", "@ispell"}},
+  {"builtin-gzip", GZIPPED, {"--engine=builtin", "-d", "@words"}},
+  {"builtin-zcat-pipe", GZIPPED | FROM_PIPE,
+   {"--engine=builtin", "-d", "@words"}},
+  {NULL}
+};
+
+/* The ways to time runs over a small file, cold and served.  */
+static const struct bench_case start_cases[] =
+{
+  {"start-ispell", NEEDS_ISPELL, {"-i", "@ispell"}},
+  {"start-builtin", 0, {"--engine=builtin", "-d", "@words"}},
+  {"start-builtin-compiled", 0, {"-d", "@dir/words.sdict"}},
+  {"start-builtin-dawg-compiled", 0, {"-d", "@dir/words.sdawg"}},
+  {NULL}
+};
+
+/* The lines of the first file of the corpus that make the small
+   file.  */
+#define SMALL_LINES 20
+
+/* How the number of words on a line is chosen.  */
+enum line_dist
+  {
+    DIST_FIXED,			/* Always `words_per_line'.  */
+    DIST_UNIFORM,		/* Evenly from 1 to twice that less 1.  */
+    DIST_GEOMETRIC		/* Mostly short lines with a long tail,
+				   averaging `words_per_line'.  */
+  };
+
+static const char *const dist_names[] = {"fixed", "uniform", "geometric"};
+
+/* What the corpus came to.  */
+struct corpus
+  {
+    char *file[MAX_FILES];	/* The names of its files.  */
+    int files;			/* How many there are.  */
+    long bytes;			/* Their total length.  */
+    long lines;			/* Lines in all of them.  */
+    long words;			/* Words in all of them.  */
+    long misspelled;		/* Of those, how many were misspelled
+				   on purpose.  */
+    long packed;		/* Their total length compressed, if
+				   they are.  */
+  };
+
+/* What running one case came to.  */
+struct result
+  {
+    double seconds;		/* The median time over the corpus.  */
+    long peak_rss;		/* The most memory any run used, in
+				   kilobytes.  */
+    double p50;			/* The median latency of a line, in
+				   microseconds, or -1 if unknown.  */
+    double p99;			/* Its 99th percentile.  */
+  };
+
+/* What timing the runs of one of `start_cases' came to, in
+   milliseconds.  */
+struct start_result
+  {
+    double cold_p50;		/* The median run of spell alone.  */
+    double cold_p99;		/* Its 99th percentile.  */
+    double served_p50;		/* The median run sent to a server.  */
+    double served_p99;		/* Its 99th percentile.  */
+  };
+
+/* Options.  */
+
+static struct option const long_options[] =
+{
+  {"dir", required_argument, NULL, 'D'},
+  {"files", required_argument, NULL, 'f'},
+  {"generate-only", no_argument, NULL, 'g'},
+  {"help", no_argument, NULL, 'h'},
+  {"invocations", required_argument, NULL, 'I'},
+  {"ispell", required_argument, NULL, 'i'},
+  {"latency-lines", required_argument, NULL, 'L'},
+  {"line-dist", required_argument, NULL, 'd'},
+  {"lines", required_argument, NULL, 'l'},
+  {"misspell", required_argument, NULL, 'm'},
+  {"one-line", required_argument, NULL, 'N'},
+  {"only", required_argument, NULL, 'O'},
+  {"output", required_argument, NULL, 'o'},
+  {"repeat", required_argument, NULL, 'r'},
+  {"rss-limit", required_argument, NULL, 'R'},
+  {"seed", required_argument, NULL, 's'},
+  {"spell", required_argument, NULL, 'S'},
+  {"words", required_argument, NULL, 'w'},
+  {"words-per-line", required_argument, NULL, 'W'},
+  {NULL, 0, NULL, 0}
+};
+
+/* The name this program was run with.  */
+char *program_name;
+
+/* The directory the corpus is written to (--dir).  */
+static char *corpus_dir = "bench-corpus";
+
+/* The number of files in the corpus (--files).  */
+static int file_count = 8;
+
+/* Stop once the corpus is written (--generate-only).  */
+static int generate_only = 0;
+
+/* How many runs over the small file to time, each way
+   (--invocations).  */
+static int invocations = 50;
+
+/* The Ispell program to give spell, or NULL if there is none
+   (--ispell).  */
+static char *ispell_prog = NULL;
+
+/* How many lines to time one by one (--latency-lines).  */
+static int latency_lines = 1000;
+
+/* How line lengths are chosen (--line-dist).  */
+static enum line_dist line_dist = DIST_GEOMETRIC;
+
+/* The number of lines in each file (--lines).  */
+static long lines_per_file = 20000;
+
+/* The share of words misspelled on purpose (--misspell).  */
+static double misspell_rate = 0.02;
+
+/* The length of the file of one line, in megabytes, or zero for none
+   (--one-line).  */
+static long one_line_mb = 256;
+
+/* Run only the case of this name (--only), or all if NULL.  */
+static char *only_case = NULL;
+
+/* The file results are appended to (--output), or NULL.  */
+static char *output_file = NULL;
+
+/* How many timed runs of each case (--repeat).  */
+static int repeat = 3;
+
+/* The most memory spell may use on the file of one line, in
+   kilobytes (--rss-limit).  */
+static long rss_limit = 65536;
+
+/* Where the random numbers start (--seed).  */
+static unsigned long long seed = 1;
+
+/* The spell program to measure (--spell).  */
+static char *spell_prog = "./spell";
+
+/* The word list the corpus is drawn from (--words).  */
+static char *word_list = "corncob_lowercase.txt";
+
+/* The average number of words on a line (--words-per-line).  */
+static int words_per_line = 10;
+
+/* The state of the random number generator.  */
+static unsigned long long rng_state;
+
+/* The word list, as a dictionary to tell misspellings by.  */
+static dict_t *dict;
+
+/* Its words, shuffled, and their number.  */
+static char **words;
+static int word_count;
+
+/* For each word, the chance that a word drawn is it or one before
+   it.  */
+static double *weight;
+
+/* The lines typed at spell one by one, `latency_lines' of them.  */
+static char **latency_text;
+
+static char *expand (const char *);
+static char *find_program (const char *);
+static double now (void);
+static double percentile (double *, int, double);
+static double time_run (char **);
+static double random_unit (void);
+static int compare_doubles (const void *, const void *);
+static int make_line (char *, int, long *, long *);
+static int make_marker (char *, int);
+static long count_long_words (const char *);
+static long pick_length (void);
+static unsigned long long random_next (void);
+static void *xmalloc (size_t);
+static void error (int, int, const char *,...);
+static void feed (int, struct corpus *);
+static void feed_zcat (int, struct corpus *);
+static void generate (struct corpus *, struct corpus *, struct corpus *);
+static void load_words (void);
+static void print_result (FILE *, const struct bench_case *,
+			  struct corpus *, struct result *);
+static void print_start_result (FILE *, const struct bench_case *,
+				struct start_result *);
+static void remove_tree (const char *);
+static void run_case (const struct bench_case *, struct corpus *,
+		      struct result *);
+static void time_latency (char **, struct result *);
+static void time_starts (const struct bench_case *, struct corpus *,
+			 struct start_result *);
+static void write_small (const char *, struct corpus *);
+static void usage (int);
+
+int
+main (int argc, char **argv)
+{
+  struct corpus corpus;
+  struct corpus one_line;
+  struct corpus gzipped;
+  const struct bench_case *c;
+  FILE *output = NULL;
+  int opt;
+  int i;
+
+  program_name = argv[0];
+
+  while ((opt = getopt_long (argc, argv, "", long_options, NULL)) != EOF)
+    {
+      switch (opt)
+	{
+	case 0:
+	  break;
+
+	case 'D':
+	  corpus_dir = optarg;
+	  break;
+
+	case 'I':
+	  invocations = atoi (optarg);
+	  break;
+
+	case 'L':
+	  latency_lines = atoi (optarg);
+	  break;
+
+	case 'N':
+	  one_line_mb = atol (optarg);
+	  if (one_line_mb < 0)
+	    error (EXIT_FAILURE, 0, "%s: invalid length", optarg);
+	  break;
+
+	case 'O':
+	  only_case = optarg;
+	  break;
+
+	case 'R':
+	  rss_limit = atol (optarg);
+	  if (rss_limit < 1)
+	    error (EXIT_FAILURE, 0, "%s: invalid memory limit", optarg);
+	  break;
+
+	case 'S':
+	  spell_prog = optarg;
+	  break;
+
+	case 'W':
+	  words_per_line = atoi (optarg);
+	  if (words_per_line < 1)
+	    error (EXIT_FAILURE, 0, "%s: invalid number of words", optarg);
+	  break;
+
+	case 'd':
+	  for (i = 0; i < 3; i++)
+	    if (!strcmp (optarg, dist_names[i]))
+	      break;
+	  if (i == 3)
+	    error (EXIT_FAILURE, 0, "%s: unknown line length distribution",
+		   optarg);
+	  line_dist = i;
+	  break;
+
+	case 'f':
+	  file_count = atoi (optarg);
+	  if (file_count < 1 || file_count > MAX_FILES)
+	    error (EXIT_FAILURE, 0, "%s: invalid number of files", optarg);
+	  break;
+
+	case 'g':
+	  generate_only = 1;
+	  break;
+
+	case 'h':
+	  usage (EXIT_SUCCESS);
+
+	case 'i':
+	  ispell_prog = optarg;
+	  break;
+
+	case 'l':
+	  lines_per_file = atol (optarg);
+	  if (lines_per_file < 1)
+	    error (EXIT_FAILURE, 0, "%s: invalid number of lines", optarg);
+	  break;
+
+	case 'm':
+	  misspell_rate = atof (optarg);
+	  if (misspell_rate < 0 || misspell_rate > 1)
+	    error (EXIT_FAILURE, 0, "%s: invalid misspelling rate", optarg);
+	  break;
+
+	case 'o':
+	  output_file = optarg;
+	  break;
+
+	case 'r':
+	  repeat = atoi (optarg);
+	  if (repeat < 1)
+	    error (EXIT_FAILURE, 0, "%s: invalid number of runs", optarg);
+	  break;
+
+	case 's':
+	  seed = strtoull (optarg, NULL, 10);
+	  break;
+
+	case 'w':
+	  word_list = optarg;
+	  break;
+
+	default:
+	  usage (EXIT_FAILURE);
+	}
+    }
+
+  if (optind < argc)
+    usage (EXIT_FAILURE);
+
+  generate (&corpus, &one_line, &gzipped);
+  if (generate_only)
+    exit (EXIT_SUCCESS);
+
+  if (!ispell_prog)
+    ispell_prog = find_program ("ispell");
+  if (!ispell_prog)
+    fprintf (stderr, "%s: no Ispell found; skipping the cases that need "
+	     "it (use --ispell)\n", program_name);
+
+  /* The compiled dictionaries, one in each format, are made by the
+     spell being measured, so that they are in the format that spell
+     reads.  */
+  {
+    static const char *const formats[][2] =
+    {
+      {"--dict-format=hash", "@dir/words.sdict"},
+      {"--dict-format=dawg", "@dir/words.sdawg"},
+    };
+    char *compile = expand ("--compile-dict=@words");
+    int i;
+
+    for (i = 0; i < 2; i++)
+      {
+	char *file = expand (formats[i][1]);
+	pid_t pid = fork ();
+	int status;
+
+	if (pid == 0)
+	  {
+	    execl (spell_prog, spell_prog, formats[i][0], compile, file,
+		   (char *) NULL);
+	    error (127, errno, "%s", spell_prog);
+	  }
+	if (pid < 0 || waitpid (pid, &status, 0) < 0 || status != 0)
+	  error (EXIT_FAILURE, 0, "%s could not compile %s", spell_prog,
+		 word_list);
+	free (file);
+      }
+    free (compile);
+  }
+
+  if (output_file)
+    {
+      output = fopen (output_file, "a");
+      if (!output)
+	error (EXIT_FAILURE, errno, "%s", output_file);
+    }
+
+  printf ("%ld bytes, %ld lines, %ld words (%ld misspelled) in %d files\n",
+	  corpus.bytes, corpus.lines, corpus.words, corpus.misspelled,
+	  corpus.files);
+  if (one_line_mb)
+    printf ("%ld bytes, %ld words (%ld misspelled) in one line\n",
+	    one_line.bytes, one_line.words, one_line.misspelled);
+  printf ("%ld bytes compressed with gzip\n", gzipped.packed);
+  putchar ('\n');
+  printf ("%-20s %10s %10s %7s %9s %9s %9s\n", "case", "lines/s",
+	  "words/s", "MB/s", "p50 us", "p99 us", "RSS kB");
+
+  for (c = cases; c->name; c++)
+    {
+      struct corpus *over = ((c->flags & ONE_LINE) ? &one_line
+			     : (c->flags & GZIPPED) ? &gzipped : &corpus);
+      struct result result;
+
+      if (only_case && strcmp (only_case, c->name))
+	continue;
+      if ((c->flags & NEEDS_ISPELL) && !ispell_prog)
+	continue;
+      if ((c->flags & ONE_LINE) && !one_line_mb)
+	continue;
+
+      run_case (c, over, &result);
+      printf ("%-20s %10.0f %10.0f %7.2f ", c->name,
+	      over->lines / result.seconds, over->words / result.seconds,
+	      over->bytes / result.seconds / 1e6);
+      if (result.p50 < 0)
+	printf ("%9s %9s", "-", "-");
+      else
+	printf ("%9.1f %9.1f", result.p50, result.p99);
+      printf (" %9ld\n", result.peak_rss);
+      fflush (stdout);
+      if (output)
+	print_result (output, c, over, &result);
+
+      /* Memory that grows with the line is a failure, not a
+         measurement.  */
+      if ((c->flags & ONE_LINE) && result.peak_rss > rss_limit)
+	error (EXIT_FAILURE, 0, "%s: spell used %ld kB on a line of %ld MB "
+	       "(the limit is %ld kB)", c->name, result.peak_rss,
+	       one_line_mb, rss_limit);
+    }
+
+  if (invocations > 0)
+    {
+      printf ("\n%-24s %9s %9s %10s %9s\n", "case", "cold p50",
+	      "p99 ms", "served p50", "p99 ms");
+      for (c = start_cases; c->name; c++)
+	{
+	  struct start_result result;
+
+	  if (only_case && strcmp (only_case, c->name))
+	    continue;
+	  if ((c->flags & NEEDS_ISPELL) && !ispell_prog)
+	    continue;
+
+	  time_starts (c, &corpus, &result);
+	  printf ("%-24s %9.2f %9.2f %10.2f %9.2f\n", c->name,
+		  result.cold_p50, result.cold_p99, result.served_p50,
+		  result.served_p99);
+	  fflush (stdout);
+	  if (output)
+	    print_start_result (output, c, &result);
+	}
+    }
+
+  if (output && fclose (output) == EOF)
+    error (EXIT_FAILURE, errno, "%s", output_file);
+  exit (EXIT_SUCCESS);
+}
+
+/* Print a usage message and exit with STATUS.  */
+
+static void
+usage (int status)
+{
+  fprintf (status ? stderr : stdout,
+	   "Usage: %s [OPTION]...\n"
+	   "Measure how fast spell checks a made-up corpus.\n\n"
+	   "      --dir=DIR\t\tWrite the corpus in DIR (bench-corpus).\n"
+	   "      --files=N\t\tMake N files (8).\n"
+	   "      --generate-only\tWrite the corpus and stop.\n"
+	   "      --invocations=N\tTime N runs over a small file, cold and\n"
+	   "\t\t\tserved (50).\n"
+	   "      --ispell=PROGRAM\tGive spell PROGRAM as Ispell.\n"
+	   "      --latency-lines=N\tTime N lines one by one (1000).\n"
+	   "      --line-dist=NAME\t`fixed', `uniform' or `geometric'\n"
+	   "\t\t\tline lengths (geometric).\n"
+	   "      --lines=N\t\tMake N lines in each file (20000).\n"
+	   "      --misspell=RATE\tMisspell RATE of the words (0.02).\n"
+	   "      --one-line=MB\tAlso check a file of one line MB\n"
+	   "\t\t\tmegabytes long, or none if 0 (256).\n"
+	   "      --only=CASE\tRun only CASE.\n"
+	   "      --output=FILE\tAppend the results to FILE as JSON.\n"
+	   "      --repeat=N\tTime N runs of each case (3).\n"
+	   "      --rss-limit=KB\tFail if spell uses more than KB\n"
+	   "\t\t\tkilobytes on the file of one line (65536).\n"
+	   "      --seed=N\t\tStart the random numbers at N (1).\n"
+	   "      --spell=PROGRAM\tMeasure PROGRAM (./spell).\n"
+	   "      --words=FILE\tDraw words from FILE\n"
+	   "\t\t\t(corncob_lowercase.txt).\n"
+	   "      --words-per-line=N\tAverage N words a line (10).\n",
+	   program_name);
+  exit (status);
+}
+
+/* Write the corpus into `corpus_dir', and describe it in *CORPUS;
+   likewise the file of one line, in *ONE_LINE, and the corpus
+   compressed with gzip, in *GZIPPED.  */
+
+static void
+generate (struct corpus *corpus, struct corpus *one_line,
+	  struct corpus *gzipped)
+{
+  char line[MAX_LINE + 32];
+  double misspell_rate_saved;
+  int n;
+
+  rng_state = seed * 0x9e3779b97f4a7c15ULL + 1;
+  load_words ();
+
+  if (mkdir (corpus_dir, 0777) < 0 && errno != EEXIST)
+    error (EXIT_FAILURE, errno, "%s", corpus_dir);
+
+  memset (corpus, 0, sizeof *corpus);
+  memset (gzipped, 0, sizeof *gzipped);
+  corpus->files = gzipped->files = file_count;
+  for (n = 0; n < file_count; n++)
+    {
+      struct stat stat_buf;
+      FILE *stream;
+      gzFile packed;
+      long l;
+
+      corpus->file[n] = xmalloc (strlen (corpus_dir) + 20);
+      sprintf (corpus->file[n], "%s/corpus-%03d.txt", corpus_dir, n);
+      stream = fopen (corpus->file[n], "w");
+      if (!stream)
+	error (EXIT_FAILURE, errno, "%s", corpus->file[n]);
+      gzipped->file[n] = xmalloc (strlen (corpus_dir) + 20);
+      sprintf (gzipped->file[n], "%s/corpus-%03d.txt.gz", corpus_dir, n);
+      packed = gzopen (gzipped->file[n], "wb");
+      if (!packed)
+	error (EXIT_FAILURE, errno, "%s", gzipped->file[n]);
+
+      for (l = 0; l < lines_per_file; l++)
+	{
+	  int len = make_line (line, pick_length (), &corpus->words,
+			       &corpus->misspelled);
+
+	  fwrite (line, 1, len, stream);
+	  if (gzwrite (packed, line, len) != len)
+	    error (EXIT_FAILURE, 0, "%s: write error", gzipped->file[n]);
+	  corpus->bytes += len;
+	  corpus->lines++;
+	}
+      if (fclose (stream) == EOF)
+	error (EXIT_FAILURE, errno, "%s", corpus->file[n]);
+      if (gzclose (packed) != Z_OK
+	  || stat (gzipped->file[n], &stat_buf) < 0)
+	error (EXIT_FAILURE, errno, "%s", gzipped->file[n]);
+      gzipped->packed += stat_buf.st_size;
+    }
+  gzipped->bytes = corpus->bytes;
+  gzipped->lines = corpus->lines;
+  gzipped->words = corpus->words;
+  gzipped->misspelled = corpus->misspelled;
+
+  /* The lines to time are drawn the same way, with no misspelled
+     words but the last, which is a marker of each line's own.  */
+  misspell_rate_saved = misspell_rate;
+  misspell_rate = 0;
+  latency_text = xmalloc ((latency_lines + 1) * sizeof *latency_text);
+  for (n = 0; n < latency_lines; n++)
+    {
+      long ignored = 0;
+      int len = make_line (line, pick_length (), &ignored, &ignored);
+
+      line[len - 1] = ' ';
+      len += make_marker (line + len, n);
+      line[len++] = '\n';
+      latency_text[n] = xmalloc (len + 1);
+      memcpy (latency_text[n], line, len);
+      latency_text[n][len] = '\0';
+    }
+  misspell_rate = misspell_rate_saved;
+
+  /* The file of one line is lines drawn as for the corpus, each but
+     the last ending in a space instead of a newline, with a word of
+     `LONG_WORD' letters halfway through.  */
+  memset (one_line, 0, sizeof *one_line);
+  if (one_line_mb)
+    {
+      FILE *stream;
+      int long_word = 0;
+
+      one_line->files = 1;
+      one_line->lines = 1;
+      one_line->file[0] = xmalloc (strlen (corpus_dir) + 20);
+      sprintf (one_line->file[0], "%s/one-line.txt", corpus_dir);
+      stream = fopen (one_line->file[0], "w");
+      if (!stream)
+	error (EXIT_FAILURE, errno, "%s", one_line->file[0]);
+
+      while (one_line->bytes < one_line_mb * 1000000)
+	{
+	  int len = make_line (line, pick_length (), &one_line->words,
+			       &one_line->misspelled);
+
+	  line[len - 1] = ' ';
+	  fwrite (line, 1, len, stream);
+	  one_line->bytes += len;
+
+	  if (!long_word && one_line->bytes >= one_line_mb * 500000)
+	    {
+	      for (long_word = 0; long_word < LONG_WORD; long_word++)
+		putc ('a' + long_word % 26, stream);
+	      putc (' ', stream);
+	      one_line->bytes += LONG_WORD + 1;
+	      one_line->words++;
+	      one_line->misspelled++;
+	    }
+	}
+      putc ('\n', stream);
+      one_line->bytes++;
+      if (fclose (stream) == EOF)
+	error (EXIT_FAILURE, errno, "%s", one_line->file[0]);
+    }
+
+  /* A child's peak memory starts at what it shares with us when
+     forked, so let go of the word list before running spell.  */
+  for (n = 0; n < word_count; n++)
+    free (words[n]);
+  free (words);
+  free (weight);
+  free (dict->slot);
+  free (dict->pool);
+  free (dict);
+#ifdef __GLIBC__
+  malloc_trim (0);
+#endif
+}
+
+/* Write into MARKER the word that ends latency line N: `zqx' followed
+   by N in base 26, which no dictionary has.  Return its length.  */
+
+static int
+make_marker (char *marker, int n)
+{
+  int len = 0;
+
+  marker[len++] = 'z';
+  marker[len++] = 'q';
+  marker[len++] = 'x';
+  do
+    {
+      marker[len++] = 'a' + n % 26;
+      n /= 26;
+    }
+  while (n);
+  return len;
+}
+
+/* Load `word_list' into `dict', `words' and `weight'.  The words are
+   shuffled, and weighted by Zipf's law in their new order.  */
+
+static void
+load_words (void)
+{
+  int i;
+
+  dict = dict_load (word_list);
+
+  /* Gather the words from the dictionary's pool, where each is a
+     length byte followed by its characters.  */
+  words = xmalloc (dict->count * sizeof *words);
+  for (i = 0; i < dict->pool_len; i += 1 + (unsigned char) dict->pool[i])
+    {
+      int len = (unsigned char) dict->pool[i];
+
+      if (len == 0)
+	continue;
+      words[word_count] = xmalloc (len + 1);
+      memcpy (words[word_count], dict->pool + i + 1, len);
+      words[word_count++][len] = '\0';
+    }
+  if (word_count == 0)
+    error (EXIT_FAILURE, 0, "%s: no words", word_list);
+
+  for (i = word_count - 1; i > 0; i--)
+    {
+      int j = random_next () % (i + 1);
+      char *swap = words[i];
+
+      words[i] = words[j];
+      words[j] = swap;
+    }
+
+  weight = xmalloc (word_count * sizeof *weight);
+  for (i = 0; i < word_count; i++)
+    weight[i] = (i ? weight[i - 1] : 0) + 1.0 / (i + 1);
+  for (i = 0; i < word_count; i++)
+    weight[i] /= weight[word_count - 1];
+}
+
+/* Write into LINE a line of LENGTH words drawn from `words', adding
+   their number to *WORD_TOTAL and that of those misspelled to
+   *MISSPELLED.  Return the length of the line, with its newline.
+
+   The first words of the shuffled list are the most common, so that
+   the common words are not all at the start of the alphabet.  A word
+   chosen to be misspelled has a letter dropped, doubled, changed or
+   swapped with the next, until it is no longer in the list.  */
+
+static int
+make_line (char *line, int length, long *word_total, long *misspelled)
+{
+  int pos = 0;
+  int w;
+
+  for (w = 0; w < length; w++)
+    {
+      double u = random_unit ();
+      int lo = 0;
+      int hi = word_count - 1;
+      char word[DICT_MAX_WORD + 2];
+      int len;
+
+      while (lo < hi)
+	{
+	  int mid = (lo + hi) / 2;
+
+	  if (weight[mid] < u)
+	    lo = mid + 1;
+	  else
+	    hi = mid;
+	}
+      len = strlen (words[lo]);
+      memcpy (word, words[lo], len);
+
+      if (random_unit () < misspell_rate)
+	{
+	  int tries;
+
+	  for (tries = 0; tries < 8; tries++)
+	    {
+	      int at = random_next () % len;
+
+	      memcpy (word, words[lo], len);
+	      switch (random_next () % 4)
+		{
+		case 0:
+		  if (len > 1)
+		    {
+		      memmove (word + at, word + at + 1, len - at - 1);
+		      len--;
+		    }
+		  break;
+		case 1:
+		  memmove (word + at + 1, word + at, len - at);
+		  len++;
+		  break;
+		case 2:
+		  word[at] = 'a' + random_next () % 26;
+		  break;
+		default:
+		  if (at + 1 < len)
+		    {
+		      char swap = word[at];
+
+		      word[at] = word[at + 1];
+		      word[at + 1] = swap;
+		    }
+		}
+	      if (!dict_find (dict, word, len))
+		break;
+	      len = strlen (words[lo]);
+	    }
+	  if (tries < 8)
+	    ++*misspelled;
+	}
+
+      if (pos + len + 3 >= MAX_LINE)
+	break;
+      ++*word_total;
+      if (w > 0)
+	line[pos++] = ' ';
+      memcpy (line + pos, word, len);
+      if (w == 0 && random_next () % 4 == 0 && line[pos] >= 'a'
+	  && line[pos] <= 'z')
+	line[pos] += 'A' - 'a';
+      pos += len;
+      if (w + 1 < length && random_next () % 12 == 0)
+	line[pos++] = ',';
+    }
+
+  if (random_next () % 2)
+    line[pos++] = '.';
+  line[pos++] = '\n';
+  return pos;
+}
+
+/* Return how many words the next line should have.  */
+
+static long
+pick_length (void)
+{
+  double p;
+
+  switch (line_dist)
+    {
+    case DIST_FIXED:
+      return words_per_line;
+
+    case DIST_UNIFORM:
+      return 1 + random_next () % (2 * words_per_line - 1);
+
+    default:
+      if (words_per_line == 1)
+	return 1;
+      p = 1.0 / words_per_line;
+      return 1 + (long) (log (1 - random_unit ()) / log (1 - p));
+    }
+}
+
+/* Run spell over CORPUS as case C says, and put the outcome in
+   *RESULT.  */
+
+static void
+run_case (const struct bench_case *c, struct corpus *corpus,
+	  struct result *result)
+{
+  char *argv[sizeof c->args / sizeof *c->args + MAX_FILES + 2];
+  double *seconds = xmalloc (repeat * sizeof *seconds);
+  char *out = expand ("@dir/one-line.out");
+  int argc = 0;
+  int args;
+  int run;
+  int i;
+
+  argv[argc++] = spell_prog;
+  for (i = 0; i < sizeof c->args / sizeof *c->args && c->args[i]; i++)
+    argv[argc++] = expand (c->args[i]);
+  args = argc;
+
+  /* Start each case without what earlier ones left behind.  */
+  {
+    char *verdicts = expand ("@dir/verdicts");
+    char *results = expand ("@dir/results");
+
+    unlink (verdicts);
+    remove_tree (results);
+    free (verdicts);
+    free (results);
+  }
+
+  if (c->flags & FROM_PIPE)
+    argv[argc++] = "-";
+  else
+    for (i = 0; i < corpus->files; i++)
+      argv[argc++] = corpus->file[i];
+  argv[argc] = NULL;
+
+  result->peak_rss = 0;
+  for (run = (c->flags & WARM) ? -1 : 0; run < repeat; run++)
+    {
+      struct rusage usage;
+      int pipe_fd[2];
+      double start;
+      int status;
+      pid_t feeder = 0;
+      pid_t pid;
+
+      if ((c->flags & FROM_PIPE) && pipe (pipe_fd) < 0)
+	error (EXIT_FAILURE, errno, "pipe");
+
+      start = now ();
+      pid = fork ();
+      if (pid < 0)
+	error (EXIT_FAILURE, errno, "fork");
+      if (pid == 0)
+	{
+	  int null = open ("/dev/null", O_RDWR);
+
+	  if (c->flags & FROM_PIPE)
+	    {
+	      dup2 (pipe_fd[0], 0);
+	      close (pipe_fd[0]);
+	      close (pipe_fd[1]);
+	    }
+	  else
+	    dup2 (null, 0);
+	  if (c->flags & ONE_LINE)
+	    {
+	      int fd = open (out, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+	      if (fd < 0)
+		error (127, errno, "%s", out);
+	      dup2 (fd, 1);
+	      close (fd);
+	    }
+	  else
+	    dup2 (null, 1);
+	  close (null);
+	  execv (spell_prog, argv);
+	  error (127, errno, "%s", spell_prog);
+	}
+
+      if (c->flags & FROM_PIPE)
+	{
+	  close (pipe_fd[0]);
+	  feeder = fork ();
+	  if (feeder == 0 && (c->flags & GZIPPED))
+	    feed_zcat (pipe_fd[1], corpus);
+	  if (feeder == 0)
+	    feed (pipe_fd[1], corpus);
+	  close (pipe_fd[1]);
+	}
+
+      if (wait4 (pid, &status, 0, &usage) < 0)
+	error (EXIT_FAILURE, errno, "wait");
+      if (feeder > 0)
+	waitpid (feeder, NULL, 0);
+      if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+	error (EXIT_FAILURE, 0, "%s: spell failed", c->name);
+
+      if (run >= 0)
+	{
+	  seconds[run] = now () - start;
+	  if (usage.ru_maxrss > result->peak_rss)
+	    result->peak_rss = usage.ru_maxrss;
+	}
+    }
+  result->seconds = percentile (seconds, repeat, 0.5);
+  free (seconds);
+
+  /* However the line was cut into pieces, its long word is one.  */
+  if (c->flags & ONE_LINE)
+    {
+      long found = count_long_words (out);
+
+      if (found != 1)
+	error (EXIT_FAILURE, 0, "%s: spell reported %ld words of %d "
+	       "letters or more, not 1", c->name, found, LONG_WORD_SEEN);
+      unlink (out);
+    }
+  free (out);
+
+  argv[args] = "-";
+  argv[args + 1] = NULL;
+  if (c->flags & (ONE_LINE | GZIPPED))
+    result->p50 = result->p99 = -1;
+  else
+    time_latency (argv, result);
+
+  for (i = 1; i < args; i++)
+    free (argv[i]);
+}
+
+/* Write the files of CORPUS to FD, and exit.  */
+
+static void
+feed (int fd, struct corpus *corpus)
+{
+  char buf[65536];
+  int i;
+
+  for (i = 0; i < corpus->files; i++)
+    {
+      int in = open (corpus->file[i], O_RDONLY);
+      ssize_t len;
+
+      while (in >= 0 && (len = read (in, buf, sizeof buf)) > 0)
+	if (write (fd, buf, len) != len)
+	  _exit (1);
+      close (in);
+    }
+  _exit (0);
+}
+
+/* Run `zcat' over the files of CORPUS, writing to FD.  */
+
+static void
+feed_zcat (int fd, struct corpus *corpus)
+{
+  char *argv[MAX_FILES + 2];
+  int i;
+
+  argv[0] = "zcat";
+  for (i = 0; i < corpus->files; i++)
+    argv[i + 1] = corpus->file[i];
+  argv[i + 1] = NULL;
+  dup2 (fd, 1);
+  close (fd);
+  execvp ("zcat", argv);
+  error (127, errno, "zcat");
+}
+
+/* Run spell with ARGV, typing lines at it one by one and timing how
+   long each takes to come back, and put the median and the 99th
+   percentile in *RESULT.
+
+   Spell's output goes to a pseudo-terminal, so that it is written a
+   line at a time as on a terminal rather than held back in a buffer.
+   Each line ends with a misspelled word of its own, and is taken to
+   have come back when that word is read (with whatever is suggested
+   for it after a colon).  */
+
+static void
+time_latency (char **argv, struct result *result)
+{
+  double *sample;
+  char answer[MAX_LINE];
+  struct termios term;
+  int answer_len = 0;
+  int pipe_fd[2];
+  int master;
+  int slave;
+  int done = 0;
+  pid_t pid;
+  int n;
+
+  result->p50 = result->p99 = -1;
+  if (latency_lines < 1)
+    return;
+
+  master = posix_openpt (O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt (master) < 0 || unlockpt (master) < 0
+      || (slave = open (ptsname (master), O_RDWR | O_NOCTTY)) < 0)
+    {
+      error (0, errno, "cannot open a pseudo-terminal to time lines");
+      return;
+    }
+  tcgetattr (slave, &term);
+  cfmakeraw (&term);
+  tcsetattr (slave, TCSANOW, &term);
+
+  if (pipe (pipe_fd) < 0)
+    error (EXIT_FAILURE, errno, "pipe");
+  pid = fork ();
+  if (pid < 0)
+    error (EXIT_FAILURE, errno, "fork");
+  if (pid == 0)
+    {
+      dup2 (pipe_fd[0], 0);
+      dup2 (slave, 1);
+      close (pipe_fd[0]);
+      close (pipe_fd[1]);
+      close (slave);
+      close (master);
+      execv (spell_prog, argv);
+      error (127, errno, "%s", spell_prog);
+    }
+  close (pipe_fd[0]);
+  close (slave);
+
+  sample = xmalloc (latency_lines * sizeof *sample);
+  for (n = 0; n < latency_lines; n++)
+    {
+      char marker[16];
+      int marker_len = make_marker (marker, n);
+      int len = strlen (latency_text[n]);
+      int found = 0;
+      double start = now ();
+
+      if (write (pipe_fd[1], latency_text[n], len) != len)
+	break;
+
+      /* Read lines of output until the marker's.  */
+      while (!found)
+	{
+	  struct pollfd pfd;
+	  char *eol;
+	  ssize_t got;
+
+	  eol = memchr (answer, '\n', answer_len);
+	  if (eol)
+	    {
+	      found = (eol - answer >= marker_len
+		       && !memcmp (answer, marker, marker_len)
+		       && (eol - answer == marker_len
+			   || answer[marker_len] == ':'));
+	      answer_len -= eol + 1 - answer;
+	      memmove (answer, eol + 1, answer_len);
+	      continue;
+	    }
+
+	  pfd.fd = master;
+	  pfd.events = POLLIN;
+	  if (poll (&pfd, 1, LATENCY_TIMEOUT) <= 0
+	      || answer_len == sizeof answer
+	      || (got = read (master, answer + answer_len,
+			      sizeof answer - answer_len)) <= 0)
+	    break;
+	  answer_len += got;
+	}
+      if (!found)
+	break;
+      sample[done++] = (now () - start) * 1e6;
+    }
+
+  close (pipe_fd[1]);
+  close (master);
+  waitpid (pid, NULL, 0);
+
+  if (done < latency_lines)
+    error (0, 0, "%s: no answer to line %d; latency not timed", argv[0],
+	   done + 1);
+  else
+    {
+      result->p50 = percentile (sample, done, 0.5);
+      result->p99 = percentile (sample, done, 0.99);
+    }
+  free (sample);
+}
+
+/* Time runs of spell over a small file made from the start of CORPUS,
+   as case C (one of `start_cases') says, and put the outcome in
+   *RESULT.  Each run is timed from starting spell until it exits,
+   first with spell checking the file itself, then with it sending
+   the file to a server started once with `--serve' and the same
+   arguments, which is stopped afterwards.  */
+
+static void
+time_starts (const struct bench_case *c, struct corpus *corpus,
+	     struct start_result *result)
+{
+  char *argv[sizeof c->args / sizeof *c->args + 3];
+  char *served_argv[4];
+  char *small = expand ("@dir/small.txt");
+  char *sock = expand ("@dir/sock");
+  double *sample = xmalloc (invocations * sizeof *sample);
+  struct sockaddr_un addr;
+  double start;
+  pid_t server;
+  int argc = 0;
+  int i;
+
+  write_small (small, corpus);
+
+  argv[argc++] = spell_prog;
+  argv[argc++] = NULL;
+  for (i = 0; i < sizeof c->args / sizeof *c->args && c->args[i]; i++)
+    argv[argc++] = expand (c->args[i]);
+  argv[argc] = NULL;
+
+  /* Cold, after one run untimed to bring spell and its files into
+     memory.  */
+  argv[1] = small;
+  for (i = -1; i < invocations; i++)
+    {
+      double seconds = time_run (argv);
+
+      if (i >= 0)
+	sample[i] = seconds * 1e3;
+    }
+  result->cold_p50 = percentile (sample, invocations, 0.5);
+  result->cold_p99 = percentile (sample, invocations, 0.99);
+
+  /* The server takes the arguments but the file.  */
+  argv[1] = xmalloc (strlen (sock) + sizeof "--serve=");
+  sprintf (argv[1], "--serve=%s", sock);
+  unlink (sock);
+  server = fork ();
+  if (server < 0)
+    error (EXIT_FAILURE, errno, "fork");
+  if (server == 0)
+    {
+      int null = open ("/dev/null", O_RDWR);
+
+      dup2 (null, 0);
+      dup2 (null, 1);
+      close (null);
+      execv (spell_prog, argv);
+      error (127, errno, "%s", spell_prog);
+    }
+
+  /* Wait for it to take connections.  */
+  memset (&addr, 0, sizeof addr);
+  addr.sun_family = AF_UNIX;
+  strncpy (addr.sun_path, sock, sizeof addr.sun_path - 1);
+  for (start = now (); ; usleep (10000))
+    {
+      int probe = socket (AF_UNIX, SOCK_STREAM, 0);
+      int up = probe >= 0 && connect (probe, (struct sockaddr *) &addr,
+				      sizeof addr) == 0;
+
+      close (probe);
+      if (up)
+	break;
+      if (waitpid (server, NULL, WNOHANG) != 0
+	  || now () - start > LATENCY_TIMEOUT / 1e3)
+	error (EXIT_FAILURE, 0, "%s: the server did not start", c->name);
+    }
+
+  served_argv[0] = spell_prog;
+  served_argv[1] = xmalloc (strlen (sock) + sizeof "--connect=");
+  sprintf (served_argv[1], "--connect=%s", sock);
+  served_argv[2] = small;
+  served_argv[3] = NULL;
+  for (i = -1; i < invocations; i++)
+    {
+      double seconds = time_run (served_argv);
+
+      if (i >= 0)
+	sample[i] = seconds * 1e3;
+    }
+  result->served_p50 = percentile (sample, invocations, 0.5);
+  result->served_p99 = percentile (sample, invocations, 0.99);
+
+  kill (server, SIGTERM);
+  waitpid (server, NULL, 0);
+
+  for (i = 1; i < argc; i++)
+    if (argv[i] != small)
+      free (argv[i]);
+  free (served_argv[1]);
+  free (sample);
+  unlink (small);
+  free (small);
+  free (sock);
+}
+
+/* Run spell with ARGV, with nothing on its standard input and its
+   output thrown away, and return how many seconds it took.  */
+
+static double
+time_run (char **argv)
+{
+  double start = now ();
+  int status;
+  pid_t pid;
+
+  pid = fork ();
+  if (pid < 0)
+    error (EXIT_FAILURE, errno, "fork");
+  if (pid == 0)
+    {
+      int null = open ("/dev/null", O_RDWR);
+
+      dup2 (null, 0);
+      dup2 (null, 1);
+      close (null);
+      execv (spell_prog, argv);
+      error (127, errno, "%s", spell_prog);
+    }
+  if (waitpid (pid, &status, 0) < 0)
+    error (EXIT_FAILURE, errno, "wait");
+  if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+    error (EXIT_FAILURE, 0, "%s failed", argv[0]);
+  return now () - start;
+}
+
+/* Write the first `SMALL_LINES' lines of the first file of CORPUS to
+   the file FILE.  */
+
+static void
+write_small (const char *file, struct corpus *corpus)
+{
+  char line[MAX_LINE + 32];
+  FILE *in = fopen (corpus->file[0], "r");
+  FILE *out = fopen (file, "w");
+  int n;
+
+  if (!in)
+    error (EXIT_FAILURE, errno, "%s", corpus->file[0]);
+  if (!out)
+    error (EXIT_FAILURE, errno, "%s", file);
+  for (n = 0; n < SMALL_LINES && fgets (line, sizeof line, in); n++)
+    fputs (line, out);
+  fclose (in);
+  if (fclose (out) == EOF)
+    error (EXIT_FAILURE, errno, "%s", file);
+}
+
+/* Append to OUTPUT a line of JSON with what running case C over
+   CORPUS came to.  */
+
+static void
+print_result (FILE *output, const struct bench_case *c,
+	      struct corpus *corpus, struct result *result)
+{
+  char date[32];
+  time_t t = time (NULL);
+  int i;
+
+  strftime (date, sizeof date, "%Y-%m-%dT%H:%M:%SZ", gmtime (&t));
+  fprintf (output, "{\"date\": \"%s\", \"case\": \"%s\", \"args\": \"",
+	   date, c->name);
+  for (i = 0; i < sizeof c->args / sizeof *c->args && c->args[i]; i++)
+    fprintf (output, "%s%s", i ? " " : "", c->args[i]);
+  fprintf (output, "\", \"seed\": %llu, \"files\": %d, "
+	   "\"line_dist\": \"%s\", \"words_per_line\": %d, "
+	   "\"misspell\": %g, \"bytes\": %ld, \"lines\": %ld, "
+	   "\"words\": %ld, \"runs\": %d, \"seconds\": %.6f, "
+	   "\"lines_per_s\": %.0f, \"words_per_s\": %.0f, "
+	   "\"mb_per_s\": %.3f, ",
+	   seed, corpus->files, dist_names[line_dist], words_per_line,
+	   misspell_rate, corpus->bytes, corpus->lines, corpus->words,
+	   repeat, result->seconds, corpus->lines / result->seconds,
+	   corpus->words / result->seconds,
+	   corpus->bytes / result->seconds / 1e6);
+  if (result->p50 < 0)
+    fputs ("\"latency_p50_us\": null, \"latency_p99_us\": null, ", output);
+  else
+    fprintf (output, "\"latency_p50_us\": %.1f, \"latency_p99_us\": %.1f, ",
+	     result->p50, result->p99);
+  fprintf (output, "\"peak_rss_kb\": %ld}\n", result->peak_rss);
+}
+
+/* Append to OUTPUT a line of JSON with what timing the runs of case
+   C (one of `start_cases') came to.  */
+
+static void
+print_start_result (FILE *output, const struct bench_case *c,
+		    struct start_result *result)
+{
+  char date[32];
+  time_t t = time (NULL);
+  int i;
+
+  strftime (date, sizeof date, "%Y-%m-%dT%H:%M:%SZ", gmtime (&t));
+  fprintf (output, "{\"date\": \"%s\", \"case\": \"%s\", \"args\": \"",
+	   date, c->name);
+  for (i = 0; i < sizeof c->args / sizeof *c->args && c->args[i]; i++)
+    fprintf (output, "%s%s", i ? " " : "", c->args[i]);
+  fprintf (output, "\", \"lines\": %d, \"runs\": %d, "
+	   "\"cold_p50_ms\": %.3f, \"cold_p99_ms\": %.3f, "
+	   "\"served_p50_ms\": %.3f, \"served_p99_ms\": %.3f}\n",
+	   SMALL_LINES, invocations, result->cold_p50, result->cold_p99,
+	   result->served_p50, result->served_p99);
+}
+
+/* Return a copy of ARG with `@ispell', `@words' and `@dir' replaced
+   by what they stand for.  */
+
+static char *
+expand (const char *arg)
+{
+  static const char *const names[] = {"@ispell", "@words", "@dir"};
+  const char *values[3];
+  char *copy;
+  int len = 1;
+  int pass;
+  int i;
+
+  values[0] = ispell_prog ? ispell_prog : "";
+  values[1] = word_list;
+  values[2] = corpus_dir;
+
+  /* Measure on the first pass, and copy on the second.  */
+  for (pass = 0, copy = NULL; pass < 2; pass++)
+    {
+      const char *from = arg;
+      char *to = copy;
+
+      while (*from)
+	{
+	  for (i = 0; i < 3; i++)
+	    if (!strncmp (from, names[i], strlen (names[i])))
+	      break;
+	  if (i < 3)
+	    {
+	      if (pass)
+		to = strcpy (to, values[i]) + strlen (values[i]);
+	      else
+		len += strlen (values[i]);
+	      from += strlen (names[i]);
+	    }
+	  else if (pass)
+	    *to++ = *from++;
+	  else
+	    len++, from++;
+	}
+      if (pass)
+	*to = '\0';
+      else
+	copy = xmalloc (len);
+    }
+  return copy;
+}
+
+/* Return the file name of PROGRAM in the directories of $PATH, or
+   NULL if it is in none of them.  */
+
+static char *
+find_program (const char *program)
+{
+  const char *path = getenv ("PATH");
+
+  while (path && *path)
+    {
+      const char *colon = strchr (path, ':');
+      int len = colon ? colon - path : strlen (path);
+      char *file = xmalloc (len + strlen (program) + 2);
+
+      sprintf (file, "%.*s/%s", len, len ? path : ".", program);
+      if (access (file, X_OK) == 0)
+	return file;
+      free (file);
+      path = colon ? colon + 1 : NULL;
+    }
+  return NULL;
+}
+
+/* Return how many lines of the file FILE, spell's output, are at
+   least `LONG_WORD_SEEN' characters long.  */
+
+static long
+count_long_words (const char *file)
+{
+  FILE *stream = fopen (file, "r");
+  long count = 0;
+  long len = 0;
+  int c;
+
+  if (!stream)
+    error (EXIT_FAILURE, errno, "%s", file);
+  while ((c = getc (stream)) != EOF)
+    if (c != '\n')
+      len++;
+    else
+      {
+	if (len >= LONG_WORD_SEEN)
+	  count++;
+	len = 0;
+      }
+  fclose (stream);
+  return count;
+}
+
+/* Remove DIR and the files in it.  */
+
+static void
+remove_tree (const char *dir)
+{
+  DIR *stream = opendir (dir);
+  struct dirent *entry;
+
+  if (!stream)
+    return;
+  while ((entry = readdir (stream)))
+    if (strcmp (entry->d_name, ".") && strcmp (entry->d_name, ".."))
+      {
+	char *file = xmalloc (strlen (dir) + strlen (entry->d_name) + 2);
+
+	sprintf (file, "%s/%s", dir, entry->d_name);
+	unlink (file);
+	free (file);
+      }
+  closedir (stream);
+  rmdir (dir);
+}
+
+/* Return the P'th quantile of the N values at VALUE, which are sorted
+   in place.  */
+
+static double
+percentile (double *value, int n, double p)
+{
+  qsort (value, n, sizeof *value, compare_doubles);
+  return value[(int) (p * (n - 1) + 0.5)];
+}
+
+static int
+compare_doubles (const void *a, const void *b)
+{
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* Return the time in seconds since some fixed moment.  */
+
+static double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Return the next random number (xorshift64*).  */
+
+static unsigned long long
+random_next (void)
+{
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+/* Return a random number at least 0 and less than 1.  */
+
+static double
+random_unit (void)
+{
+  return (random_next () >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Print a message with `fprintf (stderr, FORMAT, ...)';
+   if ERRNUM is nonzero, follow it with ": " and strerror (ERRNUM).
+   If STATUS is nonzero, terminate the program with `exit (STATUS)'.  */
+
+static void
+error (int status, int errnum, const char *message,...)
+{
+  va_list args;
+
+  fprintf (stderr, "%s: ", program_name);
+
+  va_start (args, message);
+  vfprintf (stderr, message, args);
+  va_end (args);
+
+  if (errnum)
+    fprintf (stderr, ": %s", strerror (errnum));
+  putc ('\n', stderr);
+  fflush (stderr);
+  if (status)
+    exit (status);
+}
+
+/* Allocate N bytes of memory dynamically, with error checking.  */
+
+static void *
+xmalloc (size_t n)
+{
+  void *p;
+
+  p = malloc (n);
+  if (p == 0)
+    error (EXIT_FAILURE, 0, "virtual memory exhausted");
+  return p;
+}
@@ -0,0 +1,214 @@
+/* stats.c -- counts and timings of a run (--stats).
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+   The counts are plain increments, and the timings read the
+   monotonic clock, which on most systems is read without entering
+   the kernel, so `--stats' costs little enough to leave on.  */
+
+/* Local headers.  */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "stats.h"
+
+/* System headers.  */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <time.h>
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else /* not HAVE_STRING_H */
+#include <strings.h>
+#endif /* not HAVE_STRING_H */
+
+extern char *program_name;
+
+static int bucket_of (uint64_t);
+static uint64_t bucket_value (int);
+
+/* Set *STATS to nothing done yet.  */
+
+void
+stats_init (stats_t * stats)
+{
+  memset (stats, 0, sizeof *stats);
+}
+
+/* Return the time in nanoseconds since some fixed moment, from a clock
+   that is never set back.  */
+
+uint64_t
+stats_now (void)
+{
+  struct timespec now;
+
+#ifdef CLOCK_MONOTONIC
+  clock_gettime (CLOCK_MONOTONIC, &now);
+#else
+  clock_gettime (CLOCK_REALTIME, &now);
+#endif
+  return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/* Add the counts and timings in *FROM to those in *TO.  */
+
+void
+stats_add (stats_t * to, stats_t * from)
+{
+  int i;
+
+  to->files += from->files;
+  to->cached += from->cached;
+  to->lines += from->lines;
+  to->words += from->words;
+  to->misspelled += from->misspelled;
+  to->bytes += from->bytes;
+  to->writes += from->writes;
+  to->written += from->written;
+  to->polls += from->polls;
+  to->read_time += from->read_time;
+  to->window_time += from->window_time;
+  to->write_time += from->write_time;
+  to->poll_time += from->poll_time;
+  to->answer_time += from->answer_time;
+
+  for (i = 0; i < 2; i++)
+    {
+      histogram_t *into = i ? &to->file_time : &to->line_time;
+      histogram_t *hist = i ? &from->file_time : &from->line_time;
+      int b;
+
+      if (!hist->total)
+	continue;
+      for (b = 0; b < HISTOGRAM_BUCKETS; b++)
+	into->count[b] += hist->count[b];
+      if (!into->total || hist->min < into->min)
+	into->min = hist->min;
+      if (hist->max > into->max)
+	into->max = hist->max;
+      into->total += hist->total;
+      into->sum += hist->sum;
+    }
+}
+
+/* Record the duration VALUE in *HIST.  */
+
+void
+histogram_record (histogram_t * hist, uint64_t value)
+{
+  hist->count[bucket_of (value)]++;
+  if (!hist->total || value < hist->min)
+    hist->min = value;
+  if (value > hist->max)
+    hist->max = value;
+  hist->total++;
+  hist->sum += value;
+}
+
+/* Return the value below which the fraction P of the values recorded
+   in *HIST lie, as the lowest value of its bucket, but never less
+   than the least recorded nor more than the greatest.  */
+
+uint64_t
+histogram_percentile (histogram_t * hist, double p)
+{
+  long want = (long) (p * hist->total + 0.5);
+  long seen = 0;
+  uint64_t value;
+  int b;
+
+  if (want < 1)
+    want = 1;
+  for (b = 0; b < HISTOGRAM_BUCKETS - 1; b++)
+    {
+      seen += hist->count[b];
+      if (seen >= want)
+	break;
+    }
+
+  value = bucket_value (b);
+  if (value < hist->min)
+    value = hist->min;
+  if (value > hist->max)
+    value = hist->max;
+  return value;
+}
+
+/* Print a line to STREAM summing up *HIST, called NAME, with the
+   values divided by UNIT and followed by UNIT_NAME.  */
+
+void
+histogram_print (FILE * stream, const char *name, histogram_t * hist,
+		 double unit, const char *unit_name)
+{
+  static const double points[] = {0.5, 0.9, 0.99, 0.999};
+  static const char *const point_names[] = {"p50", "p90", "p99", "p99.9"};
+  int i;
+
+  fprintf (stream, "%s: %s: %ld", program_name, name, hist->total);
+  if (hist->total)
+    {
+      fprintf (stream, ", min %.1f", hist->min / unit);
+      for (i = 0; i < 4; i++)
+	fprintf (stream, ", %s %.1f", point_names[i],
+		 histogram_percentile (hist, points[i]) / unit);
+      fprintf (stream, ", max %.1f, mean %.1f %s", hist->max / unit,
+	       hist->sum / hist->total / unit, unit_name);
+    }
+  putc ('\n', stream);
+}
+
+/* Return the bucket that VALUE goes in.  */
+
+static int
+bucket_of (uint64_t value)
+{
+  int shift;
+
+  if (value < HISTOGRAM_SUB_BUCKETS)
+    return value;
+
+  /* The power of two of the highest bit set, less `SUB_BITS', is
+     how much of the value is too fine to keep.  */
+#ifdef __GNUC__
+  shift = 63 - __builtin_clzll (value) - HISTOGRAM_SUB_BITS;
+#else
+  for (shift = -HISTOGRAM_SUB_BITS;
+       value >> (shift + HISTOGRAM_SUB_BITS + 1); shift++);
+#endif
+  return (shift + 1) * HISTOGRAM_SUB_BUCKETS
+    + ((value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+/* Return the lowest value that goes in bucket B.  */
+
+static uint64_t
+bucket_value (int b)
+{
+  int shift = b / HISTOGRAM_SUB_BUCKETS - 1;
+
+  if (shift < 0)
+    return b;
+  return (uint64_t) (HISTOGRAM_SUB_BUCKETS + b % HISTOGRAM_SUB_BUCKETS)
+    << shift;
+}
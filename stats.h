@@ -0,0 +1,92 @@
+/* stats.h -- header for stats.c.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Each power of two is split into this many buckets (as a power of
+   two), so a value is known to within one part in sixteen.  */
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+
+/* The number of buckets, enough for any 64-bit value.  */
+#define HISTOGRAM_BUCKETS \
+  ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+/* A histogram of durations in nanoseconds, kept the way HdrHistogram
+   keeps them: values below `HISTOGRAM_SUB_BUCKETS' each have a
+   bucket, and beyond that each power of two is split into
+   `HISTOGRAM_SUB_BUCKETS' equal buckets.  Recording a value is a
+   shift and an increment, and the relative error of any percentile
+   is bounded whatever the range of the values.  */
+struct histogram
+  {
+    long count[HISTOGRAM_BUCKETS];	/* Values in each bucket.  */
+    long total;			/* Values recorded.  */
+    uint64_t min;		/* The least, if `total'.  */
+    uint64_t max;		/* The greatest.  */
+    double sum;			/* The sum of them all.  */
+  };
+typedef struct histogram histogram_t;
+
+/* What was done while checking, and how long it took.  Each thread
+   counts into its own, or into fields of a shared one that no other
+   thread touches, and they are added up with `stats_add' at the end,
+   so keeping them takes no locking.  Times are in nanoseconds.  */
+struct stats
+  {
+    long files;			/* Files checked.  */
+    long cached;		/* Of those, how many had results in
+				   the cache directory.  */
+    long lines;			/* Lines read.  */
+    long words;			/* Words in them.  */
+    long misspelled;		/* Misspelled words printed.  */
+    long bytes;			/* Bytes read.  */
+
+    long writes;		/* `write' calls to Ispell.  */
+    long written;		/* Bytes written to Ispell.  */
+    long polls;			/* Waits for Ispell (`epoll_wait' or
+				   `poll' calls).  */
+
+    uint64_t read_time;		/* Time spent reading input to send
+				   to Ispell.  */
+    uint64_t window_time;	/* Time spent waiting for room in the
+				   window of lines in flight.  */
+    uint64_t write_time;	/* Time spent writing to Ispell.  */
+    uint64_t poll_time;		/* Time spent in those waits.  */
+    uint64_t answer_time;	/* Time spent taking Ispell's answers
+				   and printing them.  */
+
+    histogram_t line_time;	/* How long each line took, from its
+				   being sent to Ispell until its
+				   misspellings were printed, or to
+				   read and check with the builtin
+				   engine.  */
+    histogram_t file_time;	/* How long each file took to read and
+				   check (or send).  */
+  };
+typedef struct stats stats_t;
+
+uint64_t histogram_percentile (histogram_t *, double);
+uint64_t stats_now (void);
+void histogram_print (FILE *, const char *, histogram_t *, double,
+		      const char *);
+void histogram_record (histogram_t *, uint64_t);
+void stats_add (stats_t *, stats_t *);
+void stats_init (stats_t *);
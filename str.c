@@ -40,9 +40,11 @@
 
 #include <sys/types.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #ifdef HAVE_STRING_H
 #include <string.h>
@@ -72,7 +74,10 @@ extern char *program_name;
 extern int interactive;
 
 /* Initialize (or reinitialize) the string *STR for use.  STR may be
-   NULL; it will be changed.  Return the (sometimes new) pointer.  */
+   NULL; it will be changed.  Return the (sometimes new) pointer.  A
+   string that is reinitialized keeps its buffer, so that a string
+   reused for line after line stops allocating once it has grown to
+   fit the longest.  */
 
 str_t *
 str_make (str_t * str)
@@ -82,13 +87,41 @@ str_make (str_t * str)
       str = xmalloc (sizeof *str);
       str->str = xmalloc (str->mem = CHUNK);
     }
-  else
-    str->str = xrealloc (str->str, str->mem = CHUNK);
+  else if (!str->str)
+    str->str = xmalloc (str->mem = CHUNK);
   str->len = 0;
 
   return str;
 }
 
+/* Free the string *STR (created with `str_make') and its buffer.  */
+
+void
+str_free (str_t * str)
+{
+  if (!str)
+    return;
+  free (str->str);
+  free (str);
+}
+
+/* Make room in the string *STR (created with `str_make') for LEN more
+   characters, so that appending them will not allocate.  */
+
+void
+str_reserve (str_t * str, int len)
+{
+  size_t need = str->len + len;
+
+  if (need <= str->mem)
+    return;
+  if (need < str->mem * 2)
+    need = str->mem * 2;
+  if (need < CHUNK)
+    need = CHUNK;
+  str->str = xrealloc (str->str, str->mem = need);
+}
+
 /* Append the character C to the string *STR (create `*str' with
    `str_make').  */
 
@@ -98,10 +131,24 @@ str_add_char (str_t * str, char c)
   if (!str || !str->str)
     str = str_make (str);
 
-  if (++(str->len) > str->mem)
-    str->str = xrealloc (str->str, str->mem += CHUNK);
+  if (str->len >= str->mem)
+    str_reserve (str, 1);
+
+  str->str[str->len++] = c;
+}
+
+/* Append the LEN characters at MEM to the string *STR (create `*str'
+   with `str_make').  */
+
+void
+str_add_mem (str_t * str, const char *mem, int len)
+{
+  if (!str || !str->str)
+    str = str_make (str);
 
-  str->str[str->len - 1] = c;
+  str_reserve (str, len);
+  memcpy (str->str + str->len, mem, len);
+  str->len += len;
 }
 
 /* Append the string *STR2 to the string *STR1.  Both should be
@@ -110,15 +157,12 @@ str_add_char (str_t * str, char c)
 void
 str_add_str (str_t * str1, str_t * str2)
 {
-  int pos = 0;
-
   if (!str2 || !str2->str)
     return;
   if (!str1 || !str1->str)
     str1 = str_make (str1);
 
-  for (; pos < str2->len; pos++)
-    str_add_char (str1, str2->str[pos]);
+  str_add_mem (str1, str2->str, str2->len);
 }
 
 /* Copy a newline-terminated line from STREAM to the string *STR
@@ -129,55 +173,186 @@ str_add_str (str_t * str1, str_t * str2)
 int
 str_add_line (str_t * str, FILE * stream)
 {
+  int ret = ADD_LINE_OK;
+
   if (!str || !str->str)
     str = str_make (str);
   if (!stream)
     return ADD_LINE_ERR;
 
+  /* Lock the stream once for the whole line rather than once per
+     character, which `getc' does as soon as there is a second
+     thread.  */
+  flockfile (stream);
   while (1)
     {
-      register char c = getc (stream);
+      register char c = getc_unlocked (stream);
 
       if (c == EOF || ferror (stream))
-	return ADD_LINE_EOF;
+	{
+	  ret = ADD_LINE_EOF;
+	  break;
+	}
       str_add_char (str, c);
       if (c == '\n')
 	break;
     }
+  funlockfile (stream);
 
-  return ADD_LINE_OK;
+  return ret;
 }
 
-/* Copy a newline-terminated line from FILE_DESC to the string *STR
-   (create `*str' with `str_make').  Return `ADD_LINE_OK' if
-   successful, `ADD_LINE_EOF' if an EOF was gotten, or `ADD_LINE_ERR'
-   in event of an error.  FIXME: should not read only one character at
-   a time.  */
+/* Make a buffer for reading from the descriptor DESC and return
+   it.  */
+
+desc_buf_t *
+desc_buf_make (int desc)
+{
+  desc_buf_t *buf = xmalloc (sizeof *buf);
+
+  buf->desc = desc;
+  buf->buf = xmalloc (DESC_BUF_SIZE);
+  buf->start = buf->len = 0;
+  buf->reads = buf->bytes = 0;
+
+  return buf;
+}
+
+/* Read as much as will fit, up to the end of the ring, into the
+   buffer *BUF (created with `desc_buf_make').  Return the number of
+   bytes read, zero for EOF, or negative for an error.  If the buffer
+   is already full, read nothing and return its size.  */
+
+int
+desc_buf_fill (desc_buf_t * buf)
+{
+  int end;
+  int nchars;
+
+  if (!buf->len)
+    buf->start = 0;
+  end = (buf->start + buf->len) % DESC_BUF_SIZE;
+
+  if (buf->len == DESC_BUF_SIZE)
+    return DESC_BUF_SIZE;
+  nchars = safe_read (buf->desc, buf->buf + end,
+		      (end < buf->start ? buf->start : DESC_BUF_SIZE)
+		      - end);
+  buf->reads++;
+  if (nchars > 0)
+    {
+      buf->len += nchars;
+      buf->bytes += nchars;
+    }
+
+  return nchars;
+}
+
+/* Free the buffer *BUF (created with `desc_buf_make').  Its
+   descriptor is left open.  */
+
+void
+desc_buf_free (desc_buf_t * buf)
+{
+  if (!buf)
+    return;
+  free (buf->buf);
+  free (buf);
+}
+
+/* Return nonzero if the buffer *BUF (created with `desc_buf_make')
+   holds a whole line, or is full, so that taking a line from it
+   would not wait for the descriptor.  */
+
+int
+desc_buf_has_line (desc_buf_t * buf)
+{
+  int run = buf->len;
+
+  if (buf->len == DESC_BUF_SIZE)
+    return 1;
+  if (buf->start + run > DESC_BUF_SIZE)
+    {
+      run = DESC_BUF_SIZE - buf->start;
+      if (memchr (buf->buf, '\n', buf->len - run))
+	return 1;
+    }
+  return memchr (buf->buf + buf->start, '\n', run) != NULL;
+}
+
+/* Move the characters of the buffer *BUF (created with
+   `desc_buf_make') up to and including the first newline to the end
+   of the string *STR (created with `str_make'), without reading.
+   Return nonzero if a newline was reached; if not, all there was has
+   been moved, and a later call may add the rest of the line.  */
 
 int
-str_add_line_from_desc (str_t * str, int file_desc)
+desc_buf_take_line (desc_buf_t * buf, str_t * str)
 {
-  int nchars = 0;
-  char c = 0;
+  return desc_buf_take_upto (buf, str, INT_MAX);
+}
+
+/* Do as `desc_buf_take_line' does, but move no more than MAX
+   characters; if that many are moved without reaching a newline,
+   the rest stay in *BUF.  */
 
+int
+desc_buf_take_upto (desc_buf_t * buf, str_t * str, int max)
+{
+  while (buf->len && max > 0)
+    {
+      char *start = buf->buf + buf->start;
+      char *newline;
+      int run = buf->len;
+
+      /* Take what lies before the end of the ring, up to and
+         including the first newline.  */
+      if (buf->start + run > DESC_BUF_SIZE)
+	run = DESC_BUF_SIZE - buf->start;
+      if (run > max)
+	run = max;
+      newline = memchr (start, '\n', run);
+      if (newline)
+	run = newline - start + 1;
+
+      str_add_mem (str, start, run);
+      buf->start = (buf->start + run) % DESC_BUF_SIZE;
+      buf->len -= run;
+      max -= run;
+
+      if (newline)
+	return 1;
+    }
+
+  return 0;
+}
+
+/* Copy a newline-terminated line from the buffer *BUF (created with
+   `desc_buf_make') to the string *STR (create `*str' with
+   `str_make'), reading from its descriptor whenever the buffer runs
+   dry.  Return `ADD_LINE_OK' if successful, `ADD_LINE_EOF' if an EOF
+   was gotten, or `ADD_LINE_ERR' in event of an error.  */
+
+int
+str_add_line_from_buf (str_t * str, desc_buf_t * buf)
+{
   if (!str || !str->str)
     str = str_make (str);
 
   while (1)
     {
-      nchars = safe_read (file_desc, &c, 1);
+      int nchars;
+
+      if (desc_buf_take_line (buf, str))
+	return ADD_LINE_OK;
+
+      nchars = desc_buf_fill (buf);
 
       if (!nchars)
 	return ADD_LINE_EOF;
       if (nchars < 0)
 	return ADD_LINE_ERR;
-
-      str_add_char (str, c);
-      if (c == '\n')
-	break;
     }
-
-  return ADD_LINE_OK;
 }
 
 /* Convert the NUL-terminated character array *NSTR to a string
@@ -186,15 +361,10 @@ str_add_line_from_desc (str_t * str, int file_desc)
 str_t *
 nstr_to_str (char *nstr)
 {
-  str_t *str = 0;
-  int pos = 0;
-
-  str = str_make (str);
+  str_t *str = str_make (0);
 
-  if (!nstr)
-    return str;
-  for (; nstr[pos]; pos++)
-    str_add_char (str, nstr[pos]);
+  if (nstr)
+    str_add_mem (str, nstr, strlen (nstr));
 
   return str;
 }
@@ -205,60 +375,28 @@ nstr_to_str (char *nstr)
 char *
 str_to_nstr (str_t * str)
 {
-  char *nstr = xmalloc (str->len + 1);
-  int pos = 0;
+  char *nstr;
+  char *nul;
 
   if (!str || !str->str)
-    return nstr;
-
-  for (; pos < str->len; pos++)
     {
-      if (!str->str[pos])
-	/* NUL-terminated strings dislike having NULs in their
-	   content.  I suppose the best thing is to give them a space
-	   instead.  */
-	str->str[pos] = ' ';
-
-      nstr[pos] = str->str[pos];
+      nstr = xmalloc (1);
+      *nstr = 0;
+      return nstr;
     }
 
-  nstr[pos + 1] = 0;
+  /* NUL-terminated strings dislike having NULs in their content.  I
+     suppose the best thing is to give them a space instead.  */
+  for (nul = memchr (str->str, 0, str->len); nul;
+       nul = memchr (nul, 0, str->str + str->len - nul))
+    *nul = ' ';
+
+  nstr = xmalloc (str->len + 1);
+  memcpy (nstr, str->str, str->len);
+  nstr[str->len] = 0;
   return nstr;
 }
 
-/* Convert the whole number NUM to a string structure and return it.
-   I'd just as soon use `sprintf', but it requires the space to be
-   allocated *before* it's called.  How should I know how many
-   characters it's going to write?  This is my solution, which calls
-   `sprintf' only one character at a time (and thus does some work
-   that `sprintf' already knows perfectly well how to do).  */
-
-str_t *
-int_to_str (int num)
-{
-  char c[2];			/* Array for the `sprintf' output.  */
-  int pos = 0;			/* Position in `*rstr'.  */
-  int rem = 0;			/* Remainder.  */
-  str_t *rstr = str_make (0);	/* String reversed.  */
-  str_t *str = str_make (0);	/* Final string.  */
-
-  /* Get the digits one at a time in reverse order, putting them in
-     `*rstr'.  */
-  while (num > 0)
-    {
-      rem = num % 10;
-      num /= 10;
-      sprintf (c, "%d", rem);
-      str_add_char (rstr, *c);
-    }
-
-  /* Reverse `*rstr', putting it in `*str'.  */
-  for (pos = rstr->len - 1; pos >= 0; pos--)
-    str_add_char (str, rstr->str[pos]);
-
-  return str;
-}
-
 /* Return a NUL-terminated character array: the meaning of the error
    ERRNUM.  */
 
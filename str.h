@@ -22,7 +22,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-/* Always add at least this many bytes when extending the buffer.  */
+/* The smallest buffer allocated.  Beyond it a buffer grows to at
+   least twice its size, so appending is linear on the whole.  */
 #define CHUNK 64
 
 /* Return values for `str_add_line*'.  */
@@ -33,6 +34,9 @@ enum add_line_return
     ADD_LINE_EOF
   };
 
+/* Bytes read from a descriptor at once by `desc_buf_fill'.  */
+#define DESC_BUF_SIZE 8192
+
 struct str
   {
     char *str;			/* The array of characters.  */
@@ -41,11 +45,32 @@ struct str
   };
 typedef struct str str_t;
 
+/* Input read ahead from a file descriptor, so that lines can be
+   handed out without a system call per character.  */
+struct desc_buf
+  {
+    int desc;			/* The file descriptor read from.  */
+    char *buf;			/* Ring of `DESC_BUF_SIZE' bytes.  */
+    int start;			/* Index of the first unread byte.  */
+    int len;			/* Number of unread bytes.  */
+    long reads;			/* `read' calls made.  */
+    long bytes;			/* Bytes they read.  */
+  };
+typedef struct desc_buf desc_buf_t;
+
 char *str_to_nstr (str_t * str);
+desc_buf_t *desc_buf_make (int);
+int desc_buf_fill (desc_buf_t *);
+int desc_buf_has_line (desc_buf_t *);
+int desc_buf_take_line (desc_buf_t *, str_t *);
+int desc_buf_take_upto (desc_buf_t *, str_t *, int);
 int str_add_line (str_t *, FILE *);
-int str_add_line_from_desc (str_t *, int);
-str_t *int_to_str (int);
+int str_add_line_from_buf (str_t *, desc_buf_t *);
 str_t *nstr_to_str (char *);
 str_t *str_make (str_t *);
+void desc_buf_free (desc_buf_t *);
 void str_add_char (str_t *, char);
+void str_add_mem (str_t *, const char *, int);
 void str_add_str (str_t *, str_t *);
+void str_free (str_t *);
+void str_reserve (str_t *, int);
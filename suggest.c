@@ -0,0 +1,656 @@
+/* suggest.c -- suggest words near a misspelling (--suggest).
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+   Two words within two edits of each other have a string in common
+   that each makes with at most two of its characters deleted, so
+   indexing each word under its deletes, and looking up the deletes
+   of a misspelling, finds every word near it at the cost of a few
+   dozen lookups and a distance computed for each word found, rather
+   than one for every word in the dictionary.  A word of N characters
+   has 1 + N + N(N-1)/2 deletes; making them from only the first
+   `prefix' characters of each word bounds the size of the index,
+   at the cost of missing the rare word whose first characters are
+   further from the misspelling's than the whole words are.
+
+   The index is built once every word has been added, in two passes
+   over the deletes: one counts the keys falling in each bucket (by
+   the top bits of their hashes), and the other puts them in place.
+   Each bucket is then sorted, and a key's words are those between
+   its start and the next key's, so the index is four arrays with
+   nothing allocated per key or per word.  */
+
+/* Local headers.  */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dict.h"
+#include "suggest.h"
+
+/* System headers.  */
+
+#include <sys/types.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else /* not HAVE_STRING_H */
+#include <strings.h>
+#endif /* not HAVE_STRING_H */
+
+#ifndef EXIT_FAILURE
+#define EXIT_FAILURE 1
+#endif
+
+/* The number of buckets.  */
+#define BUCKETS (1 << SUGGEST_BUCKET_BITS)
+
+/* Deletes that fit in the array `suggest_find' keeps on the stack: all
+   those of a word of 16 characters.  */
+#define STACK_DELETES 137
+
+/* Slots of the set `suggest_find' keeps of the words it has already
+   looked at; it stops keeping track of them once half are used.  */
+#define SEEN_SIZE 1024
+
+/* The most suggestions `suggest_find' gives.  */
+#define MAX_SUGGESTIONS 32
+
+static int count_deletes (int);
+static int distance (const char *, int, const char *, int, int);
+static int make_deletes (const char *, int, uint32_t *);
+static void *xmalloc (size_t);
+static void *xrealloc (void *, size_t);
+static void add_word (const char *, int, void *);
+static void error (int, int, const char *,...);
+
+/* The name of the executable this process comes from.  This should be
+   set by the caller.  */
+extern char *program_name;
+
+/* Make an empty index whose words' deletes are made from their first
+   PREFIX characters (all of them if PREFIX is zero), and return
+   it.  */
+
+suggest_t *
+suggest_make (int prefix)
+{
+  suggest_t *suggest = xmalloc (sizeof *suggest);
+
+  suggest->words = dict_make ();
+  suggest->count = 0;
+  suggest->mem = 1024;
+  suggest->word = xmalloc (suggest->mem * sizeof *suggest->word);
+  suggest->freq = xmalloc (suggest->mem * sizeof *suggest->freq);
+  suggest->prefix = prefix;
+  suggest->bucket = NULL;
+  suggest->key = suggest->start = suggest->posting = NULL;
+  suggest->keys = 0;
+  suggest->postings = 0;
+
+  return suggest;
+}
+
+/* Add the LEN characters at WORD to *SUGGEST, as a word used FREQ
+   times in some body of text (or zero if that is not known), unless
+   it is there already.  */
+
+void
+suggest_add (suggest_t * suggest, const char *word, int len, uint32_t freq)
+{
+  uint32_t offset = suggest->words->pool_len + 1;
+  uint32_t count = suggest->words->count;
+
+  dict_add (suggest->words, word, len);
+  if (suggest->words->count == count)
+    return;
+
+  if (suggest->count == suggest->mem)
+    {
+      suggest->mem *= 2;
+      suggest->word = xrealloc (suggest->word,
+				suggest->mem * sizeof *suggest->word);
+      suggest->freq = xrealloc (suggest->freq,
+				suggest->mem * sizeof *suggest->freq);
+    }
+  suggest->word[suggest->count] = offset;
+  suggest->freq[suggest->count] = freq;
+  suggest->count++;
+}
+
+/* Add every word in *DICT to *SUGGEST.  */
+
+void
+suggest_add_dict (suggest_t * suggest, dict_t * dict)
+{
+  dict_enumerate (dict, "", 0, add_word, suggest);
+}
+
+/* Add the LEN characters at WORD to the index at SUGGEST, for
+   `dict_enumerate'.  */
+
+static void
+add_word (const char *word, int len, void *suggest)
+{
+  suggest_add (suggest, word, len, 0);
+}
+
+/* Add the words in the file FILE to *SUGGEST.  FILE is a compiled
+   dictionary, or a word list as `dict_load' reads it, each word of
+   which may be followed on its line by white space and the number of
+   times it is used.  Exit with an error if the file cannot be
+   read.  */
+
+void
+suggest_load (suggest_t * suggest, const char *file)
+{
+  FILE *stream;
+  struct stat stat_buf;
+  char *text;
+  size_t len;
+  size_t pos = 0;
+
+  if (dict_is_compiled (file))
+    {
+      dict_t *dict = dict_map (file);
+
+      suggest_add_dict (suggest, dict);
+      dict_free (dict);
+      return;
+    }
+
+  stream = fopen (file, "r");
+  if (!stream)
+    error (EXIT_FAILURE, errno, "%s: cannot open", file);
+  if (fstat (fileno (stream), &stat_buf) == -1)
+    error (EXIT_FAILURE, errno, "%s: stat error", file);
+
+  text = xmalloc (stat_buf.st_size + 1);
+  len = fread (text, 1, stat_buf.st_size, stream);
+  if (ferror (stream))
+    error (EXIT_FAILURE, errno, "%s: read error", file);
+  fclose (stream);
+
+  while (pos < len)
+    {
+      size_t start = pos;
+      size_t end;
+      uint32_t freq = 0;
+
+      for (end = start; end < len && text[end] != '\n' && text[end] != '/'
+	   && !isspace ((unsigned char) text[end]); end++);
+
+      /* Past the affix flags, if any, to the number.  */
+      for (pos = end; pos < len && text[pos] != '\n'
+	   && !isspace ((unsigned char) text[pos]); pos++);
+      for (; pos < len && text[pos] != '\n'
+	   && isspace ((unsigned char) text[pos]); pos++);
+      for (; pos < len && isdigit ((unsigned char) text[pos]); pos++)
+	freq = freq * 10 + text[pos] - '0';
+
+      while (pos < len && text[pos] != '\n')
+	pos++;
+      pos++;
+
+      suggest_add (suggest, text + start, end - start, freq);
+    }
+
+  free (text);
+}
+
+/* Build the index of the words added to *SUGGEST, which must be done
+   before they can be suggested.  */
+
+void
+suggest_build (suggest_t * suggest)
+{
+  uint32_t *hash;
+  uint32_t *key;
+  uint32_t *posting;
+  uint32_t *fill;
+  size_t total = 0;
+  size_t out;
+  uint32_t keys;
+  uint32_t w;
+  int most = 0;
+  int pass;
+  int b;
+
+  /* Room for the deletes of the longest prefix.  */
+  for (w = 0; w < suggest->count; w++)
+    {
+      int len = (unsigned char) suggest->words->pool[suggest->word[w] - 1];
+
+      if (suggest->prefix && len > suggest->prefix)
+	len = suggest->prefix;
+      if (len > most)
+	most = len;
+    }
+  hash = xmalloc (count_deletes (most) * sizeof *hash);
+
+  suggest->bucket = xmalloc ((BUCKETS + 1) * sizeof *suggest->bucket);
+  memset (suggest->bucket, 0, (BUCKETS + 1) * sizeof *suggest->bucket);
+  fill = suggest->bucket + 1;
+  key = posting = NULL;
+
+  /* Count the deletes in each bucket, then put each in its place.  */
+  for (pass = 0; pass < 2; pass++)
+    {
+      for (w = 0; w < suggest->count; w++)
+	{
+	  char *word = suggest->words->pool + suggest->word[w];
+	  char folded[DICT_MAX_WORD];
+	  int len = (unsigned char) word[-1];
+	  int n;
+	  int i;
+
+	  if (suggest->prefix && len > suggest->prefix)
+	    len = suggest->prefix;
+	  for (i = 0; i < len; i++)
+	    folded[i] = tolower ((unsigned char) word[i]);
+
+	  n = make_deletes (folded, len, hash);
+	  for (i = 0; i < n; i++)
+	    if (pass == 0)
+	      fill[hash[i] >> (32 - SUGGEST_BUCKET_BITS)]++;
+	    else
+	      {
+		uint32_t at = fill[hash[i] >> (32 - SUGGEST_BUCKET_BITS)]++;
+
+		key[at] = hash[i];
+		posting[at] = w;
+	      }
+	}
+
+      if (pass == 0)
+	{
+	  /* Make the counts the start of each bucket, to be filled
+	     from there.  */
+	  for (b = 0; b < BUCKETS; b++)
+	    suggest->bucket[b + 1] += suggest->bucket[b];
+	  total = suggest->bucket[BUCKETS];
+	  fill = suggest->bucket;
+	  key = xmalloc ((total ? total : 1) * sizeof *key);
+	  posting = xmalloc ((total ? total : 1) * sizeof *posting);
+	}
+    }
+  free (hash);
+
+  /* Filling has left the start of each bucket where the one before
+     it was: move them back.  Sort each bucket by key, by insertion
+     since buckets are small, which keeps each key's words in the
+     order they were added.  */
+  memmove (fill + 1, fill, BUCKETS * sizeof *fill);
+  fill[0] = 0;
+  for (b = 0; b < BUCKETS; b++)
+    {
+      uint32_t i;
+
+      for (i = suggest->bucket[b] + 1; i < suggest->bucket[b + 1]; i++)
+	{
+	  uint32_t k = key[i];
+	  uint32_t p = posting[i];
+	  uint32_t j = i;
+
+	  for (; j > suggest->bucket[b] && key[j - 1] > k; j--)
+	    {
+	      key[j] = key[j - 1];
+	      posting[j] = posting[j - 1];
+	    }
+	  key[j] = k;
+	  posting[j] = p;
+	}
+    }
+
+  /* Keep each key once, and each word once under it (a word may make
+     the same delete more than one way).  */
+  for (keys = 0, out = 0; out < total; out++)
+    if (!out || key[out] != key[out - 1])
+      keys++;
+  suggest->start = xmalloc ((keys + 1) * sizeof *suggest->start);
+
+  {
+    size_t in = 0;
+    uint32_t k = 0;
+
+    out = 0;
+    for (b = 0; b < BUCKETS; b++)
+      {
+	uint32_t end = suggest->bucket[b + 1];
+
+	suggest->bucket[b] = k;
+	while (in < end)
+	  {
+	    uint32_t this = key[in];
+
+	    key[k] = this;
+	    suggest->start[k++] = out;
+	    for (; in < end && key[in] == this; in++)
+	      if (out == suggest->start[k - 1]
+		  || posting[out - 1] != posting[in])
+		posting[out++] = posting[in];
+	  }
+      }
+    suggest->bucket[BUCKETS] = k;
+    suggest->start[k] = out;
+  }
+
+  suggest->keys = keys;
+  suggest->postings = out;
+  suggest->key = xrealloc (key, (keys ? keys : 1) * sizeof *key);
+  suggest->posting = xrealloc (posting, (out ? out : 1) * sizeof *posting);
+}
+
+/* Put in SUGGESTIONS up to MAX words in *SUGGEST (built with
+   `suggest_build') that are at most `SUGGEST_MAX_DISTANCE' edits from
+   the LEN characters at WORD, case aside, and return how many there
+   are.  They are given nearest first; of those as near, the most
+   common first, and of those as common, in the order they were
+   added.  An edit is putting in, taking out or changing one
+   character, or swapping two next to each other.  Several threads may
+   look up words at once.  */
+
+int
+suggest_find (suggest_t * suggest, const char *word, int len,
+	      suggestion_t * suggestions, int max)
+{
+  uint32_t stack_hash[STACK_DELETES];
+  uint32_t *hash = stack_hash;
+  uint32_t seen[SEEN_SIZE];
+  uint32_t freq[MAX_SUGGESTIONS];
+  uint32_t index[MAX_SUGGESTIONS];
+  char folded[DICT_MAX_WORD];
+  int seen_count = 0;
+  int found = 0;
+  int prefix;
+  int n;
+  int i;
+
+  if (len <= 0 || len > DICT_MAX_WORD || !suggest->keys)
+    return 0;
+  if (max > MAX_SUGGESTIONS)
+    max = MAX_SUGGESTIONS;
+
+  for (i = 0; i < len; i++)
+    folded[i] = tolower ((unsigned char) word[i]);
+  prefix = suggest->prefix && len > suggest->prefix ? suggest->prefix : len;
+  if (count_deletes (prefix) > STACK_DELETES)
+    hash = xmalloc (count_deletes (prefix) * sizeof *hash);
+  n = make_deletes (folded, prefix, hash);
+  memset (seen, 0, sizeof seen);
+
+  for (i = 0; i < n; i++)
+    {
+      uint32_t b = hash[i] >> (32 - SUGGEST_BUCKET_BITS);
+      uint32_t lo = suggest->bucket[b];
+      uint32_t hi = suggest->bucket[b + 1];
+      uint32_t p;
+
+      while (lo < hi)
+	{
+	  uint32_t mid = lo + (hi - lo) / 2;
+
+	  if (suggest->key[mid] < hash[i])
+	    lo = mid + 1;
+	  else
+	    hi = mid;
+	}
+      if (lo == suggest->bucket[b + 1] || suggest->key[lo] != hash[i])
+	continue;
+
+      for (p = suggest->start[lo]; p < suggest->start[lo + 1]; p++)
+	{
+	  uint32_t w = suggest->posting[p];
+	  const char *entry = suggest->words->pool + suggest->word[w];
+	  int entry_len = (unsigned char) entry[-1];
+	  char entry_folded[DICT_MAX_WORD];
+	  int dist;
+	  int j;
+
+	  if (entry_len - len > SUGGEST_MAX_DISTANCE
+	      || len - entry_len > SUGGEST_MAX_DISTANCE)
+	    continue;
+
+	  /* Skip a word looked at already.  */
+	  if (seen_count < SEEN_SIZE / 2)
+	    {
+	      uint32_t slot = (w * 2654435761U) & (SEEN_SIZE - 1);
+
+	      while (seen[slot] && seen[slot] != w + 1)
+		slot = (slot + 1) & (SEEN_SIZE - 1);
+	      if (seen[slot])
+		continue;
+	      seen[slot] = w + 1;
+	      seen_count++;
+	    }
+	  else
+	    {
+	      for (j = 0; j < found && index[j] != w; j++);
+	      if (j < found)
+		continue;
+	    }
+
+	  for (j = 0; j < entry_len; j++)
+	    entry_folded[j] = tolower ((unsigned char) entry[j]);
+	  dist = distance (folded, len, entry_folded, entry_len,
+			   SUGGEST_MAX_DISTANCE);
+	  if (dist > SUGGEST_MAX_DISTANCE)
+	    continue;
+
+	  /* Insert it in order, if it makes the cut.  */
+	  for (j = found; j > 0; j--)
+	    {
+	      suggestion_t *before = &suggestions[j - 1];
+
+	      if (before->distance < dist
+		  || (before->distance == dist
+		      && (freq[j - 1] > suggest->freq[w]
+			  || (freq[j - 1] == suggest->freq[w]
+			      && index[j - 1] < w))))
+		break;
+	      if (j < max)
+		{
+		  suggestions[j] = *before;
+		  freq[j] = freq[j - 1];
+		  index[j] = index[j - 1];
+		}
+	    }
+	  if (j < max)
+	    {
+	      suggestions[j].word = entry;
+	      suggestions[j].len = entry_len;
+	      suggestions[j].distance = dist;
+	      freq[j] = suggest->freq[w];
+	      index[j] = w;
+	      if (found < max)
+		found++;
+	    }
+	}
+    }
+
+  if (hash != stack_hash)
+    free (hash);
+  return found;
+}
+
+/* Return the number of bytes the index of *SUGGEST takes, besides the
+   words themselves.  */
+
+size_t
+suggest_size (suggest_t * suggest)
+{
+  return (BUCKETS + 1 + suggest->count * 2 + suggest->keys * 2 + 1)
+    * sizeof (uint32_t) + suggest->postings * sizeof (uint32_t);
+}
+
+/* Return the number of deletes `make_deletes' makes of a string of LEN
+   characters.  */
+
+static int
+count_deletes (int len)
+{
+  return 1 + len + len * (len - 1) / 2;
+}
+
+/* Put in HASH the hash of each string that the LEN characters at WORD
+   make with none, one or two of them deleted, and return how many
+   there are.  A string made more than one way is there as many
+   times.  */
+
+static int
+make_deletes (const char *word, int len, uint32_t *hash)
+{
+  char copy[DICT_MAX_WORD];
+  int n = 0;
+  int i;
+  int j;
+
+  hash[n++] = dict_hash (word, len);
+  for (i = 0; i < len; i++)
+    {
+      memcpy (copy, word, i);
+      memcpy (copy + i, word + i + 1, len - i - 1);
+      hash[n++] = dict_hash (copy, len - 1);
+
+      /* Then the second after the first, from what is left.  */
+      for (j = i; j < len - 1; j++)
+	{
+	  char second[DICT_MAX_WORD];
+
+	  memcpy (second, copy, j);
+	  memcpy (second + j, copy + j + 1, len - j - 2);
+	  hash[n++] = dict_hash (second, len - 2);
+	}
+    }
+  return n;
+}
+
+/* Return the number of edits between the A_LEN characters at A and
+   the B_LEN characters at B (the optimal string alignment distance:
+   Levenshtein's, with swapping two neighbours as one edit), or
+   anything over MAX if it is over MAX.  */
+
+static int
+distance (const char *a, int a_len, const char *b, int b_len, int max)
+{
+  int rows[3][DICT_MAX_WORD + 1];
+  int *before = rows[0];
+  int *prev = rows[1];
+  int *cur = rows[2];
+  int i;
+  int j;
+
+  for (j = 0; j <= b_len; j++)
+    prev[j] = j;
+
+  for (i = 1; i <= a_len; i++)
+    {
+      int least;
+      int *swap;
+
+      cur[0] = least = i;
+      for (j = 1; j <= b_len; j++)
+	{
+	  int cost = a[i - 1] != b[j - 1];
+	  int d = prev[j - 1] + cost;
+
+	  if (prev[j] + 1 < d)
+	    d = prev[j] + 1;
+	  if (cur[j - 1] + 1 < d)
+	    d = cur[j - 1] + 1;
+	  if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1]
+	      && before[j - 2] + 1 < d)
+	    d = before[j - 2] + 1;
+	  cur[j] = d;
+	  if (d < least)
+	    least = d;
+	}
+
+      /* No alignment can come back under MAX.  */
+      if (least > max)
+	return max + 1;
+
+      swap = before;
+      before = prev;
+      prev = cur;
+      cur = swap;
+    }
+
+  return prev[b_len];
+}
+
+/* Print the program name and error message MESSAGE, which is a
+   printf-style format string with optional args.  If ERRNUM is
+   nonzero, print its corresponding system error message.  Exit with
+   status STATUS if it is nonzero.  This function was written by David
+   MacKenzie <djm@gnu.ai.mit.edu>.  */
+
+static void
+error (int status, int errnum, const char *message,...)
+{
+  va_list args;
+
+  fflush (stdout);
+  fprintf (stderr, "%s: ", program_name);
+
+  va_start (args, message);
+  vfprintf (stderr, message, args);
+  va_end (args);
+
+  if (errnum)
+    fprintf (stderr, ": %s", strerror (errnum));
+  putc ('\n', stderr);
+  fflush (stderr);
+  if (status)
+    exit (status);
+}
+
+/* Allocate SIZE bytes of memory dynamically, with error checking,
+   returning a pointer to that memory.  */
+
+static void *
+xmalloc (size_t size)
+{
+  void *ptr = malloc (size);
+
+  if (!ptr)
+    error (EXIT_FAILURE, 0, "virtual memory exhausted");
+  return ptr;
+}
+
+/* Change the size of an allocated block of memory *PTR to SIZE bytes,
+   with error checking, returning the new pointer.  If PTR is NULL,
+   run `xmalloc'.  */
+
+static void *
+xrealloc (void *ptr, size_t size)
+{
+  if (!ptr)
+    return xmalloc (size);
+  ptr = realloc (ptr, size);
+  if (!ptr)
+    error (EXIT_FAILURE, 0, "virtual memory exhausted");
+  return ptr;
+}
@@ -0,0 +1,79 @@
+/* suggest.h -- header for suggest.c.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+/* The most edits a suggestion may be from the word it is for.  */
+#define SUGGEST_MAX_DISTANCE 2
+
+/* Bits of a delete's hash that pick its bucket in the index.  */
+#define SUGGEST_BUCKET_BITS 16
+
+/* A word suggested by `suggest_find'.  */
+struct suggestion
+  {
+    const char *word;		/* The word, in the index's pool.  */
+    int len;			/* Its length.  */
+    int distance;		/* The edits it is from the word looked
+				   up.  */
+  };
+typedef struct suggestion suggestion_t;
+
+/* An index of words for suggesting near misses, the symmetric-delete
+   way (as SymSpell does it).  Every string that a word's first
+   `prefix' characters make with up to `SUGGEST_MAX_DISTANCE' of them
+   deleted is a key under which the word is found; a misspelling's
+   own deletes are looked up as keys, and the words found under them
+   are the only candidates whose edit distance need be computed.  Keys
+   are kept as their 32-bit hashes: a word found under a key it does
+   not make is turned away by the distance check, and the strings
+   are never stored.  */
+struct suggest
+  {
+    dict_t *words;		/* The words, for their pool and to add
+				   each only once.  */
+    uint32_t *word;		/* Offset of each word in the pool of
+				   `words' plus one, in the order
+				   added.  */
+    uint32_t *freq;		/* How common each is, or zero.  */
+    uint32_t count;		/* Number of words.  */
+    uint32_t mem;		/* Number allocated.  */
+    int prefix;			/* Characters of a word that its deletes
+				   are made from, or zero for all.  */
+
+    uint32_t *bucket;		/* Index in `key' of the first key of
+				   each bucket, and one more for the
+				   end.  */
+    uint32_t *key;		/* The hash of each key, sorted within
+				   its bucket.  */
+    uint32_t *start;		/* Index in `posting' of the first word
+				   of each key, and one more for the
+				   end.  */
+    uint32_t *posting;		/* The words (numbers in `word') under
+				   each key.  */
+    uint32_t keys;		/* Number of keys.  */
+    size_t postings;		/* Number of postings.  */
+  };
+typedef struct suggest suggest_t;
+
+int suggest_find (suggest_t *, const char *, int, suggestion_t *, int);
+size_t suggest_size (suggest_t *);
+suggest_t *suggest_make (int);
+void suggest_add (suggest_t *, const char *, int, uint32_t);
+void suggest_add_dict (suggest_t *, dict_t *);
+void suggest_build (suggest_t *);
+void suggest_load (suggest_t *, const char *);
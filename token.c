@@ -0,0 +1,627 @@
+/* token.c -- split lines of text into words.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+   A word is what Ispell considers one: a run of letters, which may
+   contain apostrophes as long as each has a letter on both sides.
+   So `don't' is one word, while the apostrophes of `'quoted'' and
+   `Lets'' belong to no word at all.
+
+   Text is taken to be UTF-8.  A character beyond ASCII is a letter
+   unless it is one of the spaces, punctuation marks, digits and
+   symbols in `not_letters', so that a word with accented letters, or
+   one in Greek or Cyrillic, is a single word.  A byte that begins no
+   valid sequence (one that is overlong, encodes a surrogate or a code
+   point beyond U+10FFFF, or is cut short) is no letter, so that a
+   word never holds an invalid sequence; 8-bit text such as Latin-1
+   is split around its accented letters.
+
+   `token_scan_scalar' looks at a character at a time and is the
+   reference.  On x86 there are also kernels that classify 64
+   characters at a time with SSE2 or AVX2 into a bit mask of letters
+   and one of apostrophes.  From these, a character is part of a word
+   if it is a letter, or an apostrophe with a letter on each side:
+
+     word = letter | (apostrophe & letter << 1 & letter >> 1)
+
+   and the words begin and end wherever that mask changes.  The same
+   pass marks the bytes beyond ASCII, and only a block that has some
+   is looked at again, a character at a time from one such byte to
+   the next, to mark the bytes of each letter among them as letters.
+   Pure ASCII text, 16 or 32 bytes at a time, costs nothing more.
+   The best kernel the processor supports is chosen the first time
+   `token_scan' is called.  */
+
+/* Local headers.  */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "token.h"
+
+/* System headers.  */
+
+#include <sys/types.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else /* not HAVE_STRING_H */
+#include <strings.h>
+#endif /* not HAVE_STRING_H */
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#ifndef EXIT_FAILURE
+#define EXIT_FAILURE 1
+#endif
+
+/* Whether the ASCII character C can be part of a word by itself:
+   whether setting its 0x20 bit, which lowercases ASCII letters,
+   gives one of `a' to `z'.  */
+#define IS_LETTER(c) \
+  ((unsigned char) (((unsigned char) (c) | 0x20) - 'a') < 26)
+
+/* Characters classified at once by a vector kernel.  */
+#define BLOCK 64
+
+/* Lines shorter than this are not worth a vector kernel.  */
+#define SHORT_LINE 32
+
+/* A vector kernel's classification of `BLOCK' characters: bit N of
+   each mask stands for character N.  */
+struct masks
+  {
+    uint64_t letter;		/* The letters.  */
+    uint64_t apostrophe;	/* The apostrophes.  */
+    uint64_t high;		/* The bytes beyond ASCII.  */
+  };
+
+/* The characters beyond ASCII that are not letters, as ranges of
+   code points, in order.  */
+static const uint32_t not_letters[][2] =
+{
+  {0x0080, 0x00a9}, {0x00ab, 0x00b4}, {0x00b6, 0x00b9}, {0x00bb, 0x00bf},
+  {0x00d7, 0x00d7}, {0x00f7, 0x00f7}, {0x037e, 0x037e}, {0x0387, 0x0387},
+  {0x055a, 0x055f}, {0x0589, 0x058a}, {0x05be, 0x05be}, {0x05c0, 0x05c0},
+  {0x05c3, 0x05c3}, {0x05c6, 0x05c6}, {0x05f3, 0x05f4}, {0x0600, 0x060f},
+  {0x061b, 0x061f}, {0x0660, 0x066d}, {0x06d4, 0x06d4}, {0x06f0, 0x06f9},
+  {0x0964, 0x096f}, {0x0e3f, 0x0e3f}, {0x0e4f, 0x0e5b}, {0x10fb, 0x10fb},
+  {0x1360, 0x137c}, {0x166d, 0x166e}, {0x1680, 0x1680}, {0x16eb, 0x16ed},
+  {0x2000, 0x2bff}, {0x2e00, 0x2e7f}, {0x3000, 0x3004}, {0x3008, 0x3020},
+  {0x3030, 0x3030}, {0x303d, 0x303f}, {0xe000, 0xf8ff}, {0xfd3e, 0xfd3f},
+  {0xfe10, 0xfe1f}, {0xfe30, 0xfe6f}, {0xfeff, 0xfeff}, {0xff00, 0xff20},
+  {0xff3b, 0xff40}, {0xff5b, 0xff65}, {0xffe0, 0xffff}, {0x1f000, 0x1fbff},
+  {0xe0000, 0x10ffff}
+};
+
+/* A way of tokenizing.  */
+struct kernel
+  {
+    const char *name;		/* The name `token_use' knows it by.  */
+    int (*scan) (const char *, int, span_list_t *);
+    int (*supported) (void);	/* Whether the processor can run it.  */
+  };
+
+static int always (void);
+static int detect_and_scan (const char *, int, span_list_t *);
+static int letter_len (const char *, int, int);
+static int wide_char (const unsigned char *, int);
+static void add_span (span_list_t *, int, int);
+static void *xrealloc (void *, size_t);
+static void error (int, int, const char *,...);
+
+#ifdef X86_KERNELS
+static void mark_wide (const char *, int, int, struct masks *, uint64_t *);
+static int scan_avx2 (const char *, int, span_list_t *);
+static int scan_sse2 (const char *, int, span_list_t *);
+static int has_avx2 (void);
+static int has_sse2 (void);
+#endif
+
+/* The kernels, best first.  */
+static const struct kernel kernels[] =
+{
+#ifdef X86_KERNELS
+  {"avx2", scan_avx2, has_avx2},
+  {"sse2", scan_sse2, has_sse2},
+#endif
+  {"scalar", token_scan_scalar, always},
+  {NULL, NULL, NULL}
+};
+
+/* The kernel `token_scan' uses.  Until it is chosen, it is
+   `detect_and_scan', which chooses it.  Threads that race to choose
+   it all choose the same one.  */
+static int (*scan) (const char *, int, span_list_t *) = detect_and_scan;
+static const char *scan_name = NULL;
+
+/* The name of the executable this process comes from.  This should be
+   set by the caller.  */
+extern char *program_name;
+
+/* Find the words in the LEN characters at TEXT, replacing the
+   contents of *SPANS with where they lie.  Return the number of words
+   found.  */
+
+int
+token_scan (const char *text, int len, span_list_t * spans)
+{
+  return scan (text, len, spans);
+}
+
+/* Do as `token_scan' does, a character at a time.  */
+
+int
+token_scan_scalar (const char *text, int len, span_list_t * spans)
+{
+  int pos = 0;
+
+  spans->len = 0;
+
+  while (pos < len)
+    {
+      int start;
+
+      while (pos < len && !letter_len (text, len, pos))
+	pos++;
+      if (pos >= len)
+	break;
+
+      start = pos;
+      while (pos < len)
+	{
+	  int n = letter_len (text, len, pos);
+
+	  if (n)
+	    pos += n;
+	  else if (text[pos] == '\'' && pos + 1 < len
+		   && letter_len (text, len, pos + 1))
+	    pos++;
+	  else
+	    break;
+	}
+
+      add_span (spans, start, pos - start);
+    }
+
+  return spans->len;
+}
+
+/* Make `token_scan' use the kernel called NAME (`avx2', `sse2' or
+   `scalar').  Return zero if there is no such kernel or the processor
+   cannot run it, leaving the kernel as it was.  */
+
+int
+token_use (const char *name)
+{
+  const struct kernel *kernel;
+
+  for (kernel = kernels; kernel->name; kernel++)
+    if (!strcmp (kernel->name, name) && kernel->supported ())
+      {
+	scan = kernel->scan;
+	scan_name = kernel->name;
+	return 1;
+      }
+
+  return 0;
+}
+
+/* Return the name of the kernel `token_scan' uses.  */
+
+const char *
+token_kernel (void)
+{
+  const struct kernel *kernel;
+
+  if (scan_name)
+    return scan_name;
+  for (kernel = kernels; !kernel->supported (); kernel++);
+  return kernel->name;
+}
+
+/* The first value of `scan': choose the best kernel, and use it.  */
+
+static int
+detect_and_scan (const char *text, int len, span_list_t * spans)
+{
+  token_use (token_kernel ());
+  return scan (text, len, spans);
+}
+
+/* Return nonzero; the scalar kernel runs anywhere.  */
+
+static int
+always (void)
+{
+  return 1;
+}
+
+/* Append the word of LEN characters at START to *SPANS.  */
+
+static void
+add_span (span_list_t * spans, int start, int len)
+{
+  if (spans->len == spans->mem)
+    spans->span = xrealloc (spans->span,
+			    (spans->mem = spans->mem * 2 + 16)
+			    * sizeof *spans->span);
+  spans->span[spans->len].start = start;
+  spans->span[spans->len].len = len;
+  spans->len++;
+}
+
+/* Return the number of bytes of the letter at POS among the LEN
+   characters at TEXT, or zero if none begins there.  */
+
+static inline int
+letter_len (const char *text, int len, int pos)
+{
+  int n;
+
+  if ((unsigned char) text[pos] < 0x80)
+    return IS_LETTER (text[pos]);
+  n = wide_char ((const unsigned char *) text + pos, len - pos);
+  return n > 0 ? n : 0;
+}
+
+/* Decode the UTF-8 character beginning the LEN bytes at TEXT, the
+   first of which is beyond ASCII.  Return its length in bytes if it
+   is a letter, minus its length if it is some other character, or
+   zero if the sequence is invalid.  */
+
+static int
+wide_char (const unsigned char *text, int len)
+{
+  unsigned char min = 0x80;	/* The smallest second byte.  */
+  unsigned char max = 0xbf;	/* And the largest.  */
+  uint32_t code;
+  int lo = 0;
+  int hi = sizeof not_letters / sizeof *not_letters - 1;
+  int n;
+  int i;
+
+  /* The lead byte gives the length, and narrows the second byte so as
+     to rule out overlong encodings, surrogates and code points beyond
+     U+10FFFF.  */
+  if (text[0] < 0xc2 || text[0] > 0xf4)
+    return 0;
+  if (text[0] < 0xe0)
+    n = 2;
+  else if (text[0] < 0xf0)
+    {
+      n = 3;
+      if (text[0] == 0xe0)
+	min = 0xa0;
+      else if (text[0] == 0xed)
+	max = 0x9f;
+    }
+  else
+    {
+      n = 4;
+      if (text[0] == 0xf0)
+	min = 0x90;
+      else if (text[0] == 0xf4)
+	max = 0x8f;
+    }
+  if (len < n || text[1] < min || text[1] > max)
+    return 0;
+
+  code = text[0] & (0x7f >> n);
+  for (i = 1; i < n; i++)
+    {
+      if ((text[i] & 0xc0) != 0x80)
+	return 0;
+      code = code << 6 | (text[i] & 0x3f);
+    }
+
+  /* Most letters beyond ASCII are accented Latin ones.  */
+  if (code >= 0xc0 && code < 0x37e && code != 0xd7 && code != 0xf7)
+    return n;
+  while (lo <= hi)
+    {
+      int mid = (lo + hi) / 2;
+
+      if (code < not_letters[mid][0])
+	hi = mid - 1;
+      else if (code > not_letters[mid][1])
+	lo = mid + 1;
+      else
+	return -n;
+    }
+  return n;
+}
+
+#ifdef X86_KERNELS
+
+/* Mark as letters in *MASKS, which classifies the `BLOCK' characters
+   at TEXT + BASE among the LEN characters at TEXT, the bytes of each
+   letter beyond ASCII that begins in them, and those left over from
+   the block before in *SPILL.  The bytes of a letter that runs on
+   into the next block are left in *SPILL for it.  Only the bytes in
+   MASKS->high are decoded, skipping those that a character decoded
+   before them takes in; an invalid byte begins no letter.  */
+
+static void
+mark_wide (const char *text, int len, int base, struct masks *masks,
+	   uint64_t * spill)
+{
+  uint64_t high = masks->high;
+
+  masks->letter |= *spill;
+  *spill = 0;
+  while (high)
+    {
+      int at = __builtin_ctzll (high);
+      int n = wide_char ((const unsigned char *) text + base + at,
+			 len - base - at);
+      uint64_t run = ((uint64_t) 1 << (n < 0 ? -n : n)) - 1;
+
+      high &= ~(run << at) & (high - 1);
+      if (n > 0)
+	{
+	  masks->letter |= run << at;
+	  if (at + n > BLOCK)
+	    *spill = run >> (BLOCK - at);
+	}
+    }
+}
+
+/* Classify the first `BLOCK' of the LEN characters at TEXT into
+   *MASKS with CLASSIFY.  If there are fewer than that, the missing
+   ones are taken to be neither letters nor apostrophes.  */
+
+static inline __attribute__ ((always_inline)) void
+classify_tail (const char *text, int len, struct masks *masks,
+	       void (*classify) (const char *, struct masks *))
+{
+  char block[BLOCK];
+
+  if (len >= BLOCK)
+    classify (text, masks);
+  else
+    {
+      memset (block, 0, BLOCK);
+      memcpy (block, text, len);
+      classify (block, masks);
+    }
+}
+
+/* Find the words in the LEN characters at TEXT as `token_scan' does,
+   classifying each `BLOCK' characters with CLASSIFY.  The
+   block after the current one is classified before the current one
+   is finished, because whether its last character belongs to a word
+   may depend on the next one.  */
+
+static inline __attribute__ ((always_inline)) int
+scan_blocks (const char *text, int len, span_list_t * spans,
+	     void (*classify) (const char *, struct masks *))
+{
+  struct masks cur;
+  struct masks next;
+  uint64_t spill = 0;		/* Bytes of a letter begun in the block
+				   before (see `mark_wide').  */
+  uint64_t prev_letter = 0;	/* Whether the last character of the
+				   previous block was a letter.  */
+  uint64_t prev_word = 0;	/* And whether it was in a word.  */
+  int start = 0;		/* Where the word being found began.  */
+  int in_word = 0;
+  int base;
+
+  /* Padding a short line out to a block costs more than looking at
+     its characters one at a time.  */
+  if (len < SHORT_LINE)
+    return token_scan_scalar (text, len, spans);
+
+  spans->len = 0;
+  classify_tail (text, len, &cur, classify);
+  if (cur.high)
+    mark_wide (text, len, 0, &cur, &spill);
+  for (base = 0; base < len; base += BLOCK)
+    {
+      uint64_t word;
+      uint64_t change;
+
+      if (base + BLOCK < len)
+	{
+	  classify_tail (text + base + BLOCK, len - base - BLOCK, &next,
+			 classify);
+	  if (next.high)
+	    mark_wide (text, len, base + BLOCK, &next, &spill);
+	}
+      else
+	next.letter = next.apostrophe = 0;
+
+      word = cur.letter
+	| (cur.apostrophe
+	   & (cur.letter << 1 | prev_letter)
+	   & (cur.letter >> 1 | (next.letter & 1) << (BLOCK - 1)));
+
+      /* Each bit that differs from the one before it begins or ends a
+         word.  */
+      change = word ^ (word << 1 | prev_word);
+      while (change)
+	{
+	  int pos = base + __builtin_ctzll (change);
+
+	  if (in_word)
+	    add_span (spans, start, pos - start);
+	  else
+	    start = pos;
+	  in_word = !in_word;
+	  change &= change - 1;
+	}
+
+      prev_letter = cur.letter >> (BLOCK - 1);
+      prev_word = word >> (BLOCK - 1);
+      cur = next;
+    }
+
+  if (in_word)
+    add_span (spans, start, len - start);
+
+  return spans->len;
+}
+
+/* Classify the `BLOCK' characters at TEXT into *MASKS, 32 at a time.
+   A character is a letter if setting its 0x20 bit, which lowercases
+   ASCII letters, gives one of `a' to `z'; the letters beyond ASCII
+   are left to `mark_wide'.  */
+
+static inline __attribute__ ((always_inline, target ("avx2"))) void
+classify_avx2 (const char *text, struct masks *masks)
+{
+  const __m256i lower = _mm256_set1_epi8 (0x20);
+  const __m256i a = _mm256_set1_epi8 ('a');
+  const __m256i z = _mm256_set1_epi8 ('z' - 'a');
+  const __m256i quote = _mm256_set1_epi8 ('\'');
+  uint64_t letter = 0;
+  uint64_t apostrophe = 0;
+  uint64_t high = 0;
+  int i;
+
+  for (i = 0; i < BLOCK; i += 32)
+    {
+      __m256i c = _mm256_loadu_si256 ((const __m256i *) (text + i));
+      __m256i off = _mm256_sub_epi8 (_mm256_or_si256 (c, lower), a);
+      __m256i is_letter = _mm256_cmpeq_epi8 (_mm256_min_epu8 (off, z), off);
+
+      letter |= (uint64_t) (uint32_t) _mm256_movemask_epi8 (is_letter) << i;
+      apostrophe |= (uint64_t) (uint32_t)
+	_mm256_movemask_epi8 (_mm256_cmpeq_epi8 (c, quote)) << i;
+      high |= (uint64_t) (uint32_t) _mm256_movemask_epi8 (c) << i;
+    }
+
+  masks->letter = letter;
+  masks->apostrophe = apostrophe;
+  masks->high = high;
+}
+
+/* Do as `classify_avx2' does, 16 characters at a time.  */
+
+static inline __attribute__ ((always_inline, target ("sse2"))) void
+classify_sse2 (const char *text, struct masks *masks)
+{
+  const __m128i lower = _mm_set1_epi8 (0x20);
+  const __m128i a = _mm_set1_epi8 ('a');
+  const __m128i z = _mm_set1_epi8 ('z' - 'a');
+  const __m128i quote = _mm_set1_epi8 ('\'');
+  uint64_t letter = 0;
+  uint64_t apostrophe = 0;
+  uint64_t high = 0;
+  int i;
+
+  for (i = 0; i < BLOCK; i += 16)
+    {
+      __m128i c = _mm_loadu_si128 ((const __m128i *) (text + i));
+      __m128i off = _mm_sub_epi8 (_mm_or_si128 (c, lower), a);
+      __m128i is_letter = _mm_cmpeq_epi8 (_mm_min_epu8 (off, z), off);
+
+      letter |= (uint64_t) _mm_movemask_epi8 (is_letter) << i;
+      apostrophe |= (uint64_t)
+	_mm_movemask_epi8 (_mm_cmpeq_epi8 (c, quote)) << i;
+      high |= (uint64_t) _mm_movemask_epi8 (c) << i;
+    }
+
+  masks->letter = letter;
+  masks->apostrophe = apostrophe;
+  masks->high = high;
+}
+
+/* Do as `token_scan' does, with AVX2.  */
+
+static __attribute__ ((target ("avx2"))) int
+scan_avx2 (const char *text, int len, span_list_t * spans)
+{
+  return scan_blocks (text, len, spans, classify_avx2);
+}
+
+/* Do as `token_scan' does, with SSE2.  */
+
+static __attribute__ ((target ("sse2"))) int
+scan_sse2 (const char *text, int len, span_list_t * spans)
+{
+  return scan_blocks (text, len, spans, classify_sse2);
+}
+
+/* Return whether the processor has AVX2.  */
+
+static int
+has_avx2 (void)
+{
+  __builtin_cpu_init ();
+  return __builtin_cpu_supports ("avx2");
+}
+
+/* Return whether the processor has SSE2.  */
+
+static int
+has_sse2 (void)
+{
+  __builtin_cpu_init ();
+  return __builtin_cpu_supports ("sse2");
+}
+
+#endif /* X86_KERNELS */
+
+/* Print the program name and error message MESSAGE, which is a
+   printf-style format string with optional args.  If ERRNUM is
+   nonzero, print its corresponding system error message.  Exit with
+   status STATUS if it is nonzero.  This function was written by David
+   MacKenzie <djm@gnu.ai.mit.edu>.  */
+
+static void
+error (int status, int errnum, const char *message,...)
+{
+  va_list args;
+
+  fflush (stdout);
+  fprintf (stderr, "%s: ", program_name);
+
+  va_start (args, message);
+  vfprintf (stderr, message, args);
+  va_end (args);
+
+  if (errnum)
+    fprintf (stderr, ": %s", strerror (errnum));
+  putc ('\n', stderr);
+  fflush (stderr);
+  if (status)
+    exit (status);
+}
+
+/* Change the size of an allocated block of memory *PTR to SIZE bytes,
+   with error checking, returning the new pointer.  If PTR is NULL,
+   allocate a new block.  */
+
+static void *
+xrealloc (void *ptr, size_t size)
+{
+  ptr = ptr ? realloc (ptr, size) : malloc (size);
+  if (!ptr)
+    error (EXIT_FAILURE, 0, "virtual memory exhausted");
+  return ptr;
+}
@@ -0,0 +1,41 @@
+/* token.h -- header for token.c.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+/* Where a word lies within a line.  */
+struct span
+  {
+    int start;			/* Offset of its first character.  */
+    int len;			/* The number of characters.  */
+  };
+typedef struct span span_t;
+
+/* A growable array of spans.  Initialize all members to zero before
+   first use.  */
+struct span_list
+  {
+    span_t *span;		/* The spans, in order.  */
+    int len;			/* The number of spans.  */
+    int mem;			/* The number allocated.  */
+  };
+typedef struct span_list span_list_t;
+
+const char *token_kernel (void);
+int token_scan (const char *, int, span_list_t *);
+int token_scan_scalar (const char *, int, span_list_t *);
+int token_use (const char *);
@@ -0,0 +1,248 @@
+/* tokentest.c -- check the tokenizer kernels against each other.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+   Usage: tokentest FILE...
+
+   Split each line of each FILE into words with every kernel the
+   processor can run, then do the same with random lines, and report
+   any span that differs from those of `token_scan_scalar'.  Then
+   report how fast each kernel goes through the lines of the FILEs.
+   Exit with status 1 if any kernel disagreed.  */
+
+/* Local headers.  */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "token.h"
+
+/* System headers.  */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else /* not HAVE_STRING_H */
+#include <strings.h>
+#endif /* not HAVE_STRING_H */
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#include <x86intrin.h>
+#define CYCLES() __rdtsc ()
+#endif
+
+/* The number of random lines to try.  */
+#define FUZZ_LINES 200000
+
+/* The longest random line.  */
+#define FUZZ_MAX 300
+
+/* Go through the lines of the files at least this many bytes' worth
+   when timing a kernel.  */
+#define TIMING_BYTES (64L * 1024 * 1024)
+
+/* The kernels there may be, best first.  */
+static const char *const kernel_names[] = {"avx2", "sse2", "scalar", NULL};
+
+/* The characters random lines are made of.  Those around the letters
+   and the apostrophe are there to catch off-by-one classification,
+   and the bytes beyond ASCII make valid and invalid UTF-8 of every
+   length, letters (`\xc3\xa9', `\xe4\xb8\x80', `\xf0\x90\x8c\xb0')
+   and not (`\xe2\x80\x99', `\xf0\x9f\x98\x80').  */
+static const char fuzz_chars[] = "aZzA'''' \n@[`{\0\x80\xc1\xe1\xff-."
+  "\xc3\xa9\xc3\xa9\xe2\x80\x99\xe4\xb8\x80\xf0\x90\x8c\xb0\xf0\x9f\x98\x80"
+  "\xed\xa0\xf4\x90\xe0\x9f\xbf";
+
+/* The name this program was run with.  */
+char *program_name;
+
+/* Nonzero if any kernel has disagreed with the scalar one.  */
+static int failed = 0;
+
+static void compare (const char *, int, const char *, long);
+static char *read_whole (const char *, long *);
+static void time_kernel (const char *, const char *, const char *, long);
+
+int
+main (int argc, char **argv)
+{
+  char *text[64];
+  long len[64];
+  char line[FUZZ_MAX];
+  unsigned long seed = 1;
+  int files = argc - 1;
+  int n;
+  int i;
+
+  program_name = argv[0];
+  if (files > 64)
+    files = 64;
+
+  for (n = 0; n < files; n++)
+    {
+      const char *end;
+      char *pos;
+
+      text[n] = read_whole (argv[n + 1], &len[n]);
+      for (pos = text[n], end = pos + len[n]; pos < end;)
+	{
+	  char *eol = memchr (pos, '\n', end - pos);
+	  int line_len = eol ? eol + 1 - pos : end - pos;
+
+	  compare (pos, line_len, argv[n + 1], pos - text[n]);
+	  pos += line_len;
+	}
+    }
+
+  for (n = 0; n < FUZZ_LINES; n++)
+    {
+      int line_len;
+
+      seed = seed * 1103515245 + 12345;
+      line_len = (seed >> 16) % FUZZ_MAX;
+      for (i = 0; i < line_len; i++)
+	{
+	  seed = seed * 1103515245 + 12345;
+	  line[i] = fuzz_chars[(seed >> 16) % (sizeof fuzz_chars - 1)];
+	}
+      compare (line, line_len, "random line", n);
+    }
+
+  if (failed)
+    return 1;
+
+  for (i = 0; kernel_names[i]; i++)
+    if (token_use (kernel_names[i]))
+      for (n = 0; n < files; n++)
+	time_kernel (kernel_names[i], argv[n + 1], text[n], len[n]);
+
+  return 0;
+}
+
+/* Split the LEN characters at TEXT with each kernel, and report it if
+   any finds other spans than the scalar kernel.  Call the characters
+   line WHERE of NAME.  */
+
+static void
+compare (const char *text, int len, const char *name, long where)
+{
+  static span_list_t want, got;
+  int i;
+  int k;
+
+  token_scan_scalar (text, len, &want);
+  for (k = 0; kernel_names[k]; k++)
+    {
+      if (!token_use (kernel_names[k]))
+	continue;
+      token_scan (text, len, &got);
+      for (i = 0; i < want.len && i < got.len; i++)
+	if (want.span[i].start != got.span[i].start
+	    || want.span[i].len != got.span[i].len)
+	  break;
+      if (i < want.len || i < got.len)
+	{
+	  fprintf (stderr, "%s: %s kernel differs at %s %ld, word %d\n",
+		   program_name, kernel_names[k], name, where, i);
+	  failed = 1;
+	}
+    }
+}
+
+/* Print how many bytes a cycle, or if cycles cannot be counted, how
+   many megabytes a second, the kernel called NAME splits the lines of
+   the LEN characters at TEXT, which came from FILE, at.  */
+
+static void
+time_kernel (const char *name, const char *file, const char *text, long len)
+{
+  static span_list_t spans;
+  long done = 0;
+  long words = 0;
+  double elapsed;
+  clock_t start = clock ();
+#ifdef CYCLES
+  unsigned long long cycles = CYCLES ();
+#endif
+
+  if (len == 0)
+    return;
+  while (done < TIMING_BYTES)
+    {
+      const char *pos = text;
+      const char *end = text + len;
+
+      while (pos < end)
+	{
+	  const char *eol = memchr (pos, '\n', end - pos);
+	  int line_len = eol ? eol + 1 - pos : end - pos;
+
+	  words += token_scan (pos, line_len, &spans);
+	  pos += line_len;
+	}
+      done += len;
+    }
+
+#ifdef CYCLES
+  cycles = CYCLES () - cycles;
+#endif
+  elapsed = (double) (clock () - start) / CLOCKS_PER_SEC;
+  printf ("%-6s %-12s %8.1f MB/s", name, file, done / elapsed / 1e6);
+#ifdef CYCLES
+  printf ("  %5.2f bytes/cycle", (double) done / cycles);
+#endif
+  printf ("  (%ld words)\n", words);
+}
+
+/* Read the whole of FILE into memory, storing its length in *LEN.  */
+
+static char *
+read_whole (const char *file, long *len)
+{
+  FILE *stream = fopen (file, "rb");
+  char *text = NULL;
+  long mem = 0;
+
+  if (!stream)
+    {
+      perror (file);
+      exit (2);
+    }
+
+  *len = 0;
+  do
+    {
+      mem = mem * 2 + 4096;
+      text = realloc (text, mem);
+      if (!text)
+	{
+	  fprintf (stderr, "%s: virtual memory exhausted\n", program_name);
+	  exit (2);
+	}
+      *len += fread (text + *len, 1, mem - *len, stream);
+    }
+  while (*len == mem);
+
+  fclose (stream);
+  return text;
+}
@@ -0,0 +1,487 @@
+/* unpack.c -- read files compressed with gzip or Zstandard.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+   A file is taken to be compressed if it begins with the magic bytes
+   of gzip or of Zstandard, whatever its name.  It is then unpacked by
+   a thread of its own into a pipe, and its `input_t' reads the other
+   end of the pipe as it would any stream, so that the file is
+   unpacked while the lines already unpacked are checked, and nothing
+   is written to disk.  The pipe is the buffer between the two: the
+   thread waits when it is full, and the reader when it is empty.
+
+   Gzip is unpacked with zlib, and Zstandard with libzstd if spell was
+   built with it (`HAVE_ZSTD').  */
+
+/* Local headers.  */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "str.h"
+#include "input.h"
+#include "unpack.h"
+
+/* System headers.  */
+
+#include <sys/types.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else /* not HAVE_STRING_H */
+#include <strings.h>
+#endif /* not HAVE_STRING_H */
+
+#ifndef EXIT_FAILURE
+#define EXIT_FAILURE 1
+#endif
+
+/* The longest magic number.  */
+#define MAGIC_MAX 4
+
+/* The magic numbers that compressed files begin with.  */
+static const struct
+  {
+    enum unpack_format format;
+    int len;
+    const char *magic;
+  }
+magics[] =
+{
+  {UNPACK_GZIP, 3, "\x1f\x8b\x08"},
+  {UNPACK_ZSTD, 4, "\x28\xb5\x2f\xfd"},
+};
+
+extern char *program_name;
+
+static int format_of (const char *, int);
+static int put_output (unpack_t *, int, const char *, size_t);
+static long next_input (unpack_t *, char *, const char **);
+static void *run (void *);
+static void *xmalloc (size_t);
+static void error (int, int, const char *,...);
+static void gunzip (unpack_t *);
+static void unzstd (unpack_t *);
+
+/* If *INPUT, just set up by `input_map' or `input_stream', is of a
+   compressed file, start a thread unpacking it and set up *INPUT
+   again to read what it unpacks, with `unpack' pointing to the
+   thread's `unpack_t'.  The stream *INPUT had, if any, is then read
+   by the thread; `unpack_finish' closes it.  */
+
+void
+unpack_input (input_t * input)
+{
+  str_t *buf = input->buf;
+  unpack_t *unpack;
+  FILE *stream;
+  int format;
+  int fd[2];
+  int err;
+
+  if (input->map)
+    format = format_of (input->map, input->map_len < MAGIC_MAX
+			? input->map_len : MAGIC_MAX);
+  else if (!input->stream || input->eof)
+    return;
+  else
+    {
+      /* Read no more than it takes to tell, so that a line typed on
+         a terminal is not held up waiting for the next.  */
+      while ((format = format_of (input->desc->buf + input->desc->start,
+				  input->desc->len)) < 0
+	     && !input->ended)
+	input_fill (input);
+    }
+  if (format <= UNPACK_NONE)
+    return;
+
+  unpack = xmalloc (sizeof *unpack);
+  unpack->format = format;
+  unpack->map = input->map;
+  unpack->map_len = input->map_len;
+  unpack->pos = unpack->dropped = 0;
+  unpack->source = input->stream;
+  unpack->head = NULL;
+  unpack->head_len = 0;
+  unpack->problem = NULL;
+  unpack->errnum = 0;
+  if (input->desc && input->desc->len)
+    {
+      unpack->head_len = input->desc->len;
+      unpack->head = xmalloc (unpack->head_len);
+      memcpy (unpack->head, input->desc->buf + input->desc->start,
+	      unpack->head_len);
+    }
+
+  /* The mapping and the stream now belong to the thread.  */
+  input->unmap = 0;
+  input_close (input);
+
+  if (pipe (fd) < 0)
+    error (EXIT_FAILURE, errno, "error creating pipe");
+  fcntl (fd[0], F_SETFD, FD_CLOEXEC);
+  fcntl (fd[1], F_SETFD, FD_CLOEXEC);
+#ifdef F_SETPIPE_SZ
+  fcntl (fd[1], F_SETPIPE_SZ, UNPACK_PIPE);
+#endif
+  unpack->out = fd[1];
+  stream = fdopen (fd[0], "r");
+  if (!stream)
+    error (EXIT_FAILURE, errno, "error opening pipe");
+
+  err = pthread_create (&unpack->thread, NULL, run, unpack);
+  if (err)
+    error (EXIT_FAILURE, err, "cannot start a thread");
+
+  input_stream (input, stream, buf);
+  input->unpack = unpack;
+}
+
+/* Wait for the thread unpacking *UNPACK to end, and free it.  The
+   stream reading the pipe must have been closed already, so that the
+   thread does not wait for room in it.  Return NULL if the file was
+   unpacked (or the reader stopped first).  Otherwise return what went
+   wrong, setting *ERRNUM to the error number that goes with it (or
+   zero).  */
+
+const char *
+unpack_finish (unpack_t * unpack, int *errnum)
+{
+  const char *problem;
+
+  pthread_join (unpack->thread, NULL);
+  if (unpack->map)
+    munmap (unpack->map, unpack->map_len);
+  if (unpack->source && unpack->source != stdin
+      && fclose (unpack->source) == EOF && !unpack->problem)
+    {
+      unpack->problem = "close error";
+      unpack->errnum = errno;
+    }
+
+  problem = unpack->problem;
+  *errnum = unpack->errnum;
+  free (unpack->head);
+  free (unpack);
+  return problem;
+}
+
+/* Return the format of a file beginning with the LEN characters at
+   HEAD, or -1 if more of it is needed to tell.  */
+
+static int
+format_of (const char *head, int len)
+{
+  int i;
+
+  for (i = 0; i < sizeof magics / sizeof *magics; i++)
+    if (!memcmp (head, magics[i].magic,
+		 len < magics[i].len ? len : magics[i].len))
+      return len < magics[i].len ? -1 : magics[i].format;
+  return UNPACK_NONE;
+}
+
+/* Unpack *UNPACK into its pipe, and close the pipe.  This is the
+   thread's start.  */
+
+static void *
+run (void *arg)
+{
+  unpack_t *unpack = arg;
+  sigset_t set;
+
+  /* The reader may stop reading, and close its end, before the end of
+     the file.  Writing to the pipe then fails with EPIPE, rather than
+     raising a SIGPIPE that would end spell.  */
+  sigemptyset (&set);
+  sigaddset (&set, SIGPIPE);
+  pthread_sigmask (SIG_BLOCK, &set, NULL);
+
+  if (unpack->format == UNPACK_GZIP)
+    gunzip (unpack);
+  else
+    unzstd (unpack);
+
+  close (unpack->out);
+  return NULL;
+}
+
+/* Point *DATA at the next of the compressed file of *UNPACK, reading
+   it into BUF (of `UNPACK_CHUNK' characters) if it is not mapped, and
+   return how much of it there is.  Return 0 at the end, or -1 if it
+   could not be read.  */
+
+static long
+next_input (unpack_t * unpack, char *buf, const char **data)
+{
+  long len;
+
+  if (unpack->map)
+    {
+      len = unpack->map_len - unpack->pos;
+      if (len > UNPACK_CHUNK)
+	len = UNPACK_CHUNK;
+      *data = unpack->map + unpack->pos;
+      unpack->pos += len;
+
+      /* Drop the pages already unpacked, as `input_line' does.  */
+      if (unpack->pos - unpack->dropped >= INPUT_DROP)
+	{
+	  size_t page = getpagesize ();
+	  size_t end = (unpack->pos - len) / page * page;
+
+	  madvise (unpack->map + unpack->dropped, end - unpack->dropped,
+		   MADV_DONTNEED);
+	  unpack->dropped = end;
+	}
+      return len;
+    }
+
+  if (unpack->head_len)
+    {
+      len = unpack->head_len;
+      unpack->head_len = 0;
+      *data = unpack->head;
+      return len;
+    }
+
+  do
+    len = read (fileno (unpack->source), buf, UNPACK_CHUNK);
+  while (len < 0 && errno == EINTR);
+  if (len < 0)
+    {
+      unpack->problem = "read error";
+      unpack->errnum = errno;
+    }
+  *data = buf;
+  return len;
+}
+
+/* Write the LEN characters at TEXT into the pipe FD, for *UNPACK.
+   Return zero if successful, or nonzero if the reader has stopped or
+   there was an error.  */
+
+static int
+put_output (unpack_t * unpack, int fd, const char *text, size_t len)
+{
+  ssize_t n;
+
+  while (len)
+    {
+      n = write (fd, text, len);
+      if (n < 0 && errno == EINTR)
+	continue;
+      if (n < 0)
+	{
+	  if (errno != EPIPE)
+	    {
+	      unpack->problem = "write error";
+	      unpack->errnum = errno;
+	    }
+	  return 1;
+	}
+      text += n;
+      len -= n;
+    }
+  return 0;
+}
+
+/* Unpack the gzip file of *UNPACK into its pipe.  Members one after
+   another are unpacked one after another, as by `gzip -d'; anything
+   after the last that is not a member is ignored.  */
+
+static void
+gunzip (unpack_t * unpack)
+{
+  char *in = xmalloc (2 * UNPACK_CHUNK);
+  char *out = in + UNPACK_CHUNK;
+  const char *data;
+  z_stream z;
+  long len;
+  int full = 0;
+  int ret = Z_OK;
+
+  memset (&z, 0, sizeof z);
+  if (inflateInit2 (&z, 15 + 16) != Z_OK)
+    {
+      unpack->problem = "cannot unpack";
+      free (in);
+      return;
+    }
+
+  while (1)
+    {
+      /* Only when zlib has nothing left to give is more wanted.  */
+      if (!z.avail_in && !full)
+	{
+	  len = next_input (unpack, in, &data);
+	  if (len < 0)
+	    break;
+	  if (!len)
+	    {
+	      if (ret != Z_STREAM_END)
+		unpack->problem = "unexpected end of compressed data";
+	      break;
+	    }
+	  z.next_in = (Bytef *) data;
+	  z.avail_in = len;
+	}
+      if (ret == Z_STREAM_END)
+	{
+	  if (*z.next_in != magics[0].magic[0])
+	    break;
+	  inflateReset (&z);
+	}
+
+      z.next_out = (Bytef *) out;
+      z.avail_out = UNPACK_CHUNK;
+      ret = inflate (&z, Z_NO_FLUSH);
+      if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+	{
+	  unpack->problem = z.msg ? z.msg : "invalid compressed data";
+	  break;
+	}
+      full = ret != Z_STREAM_END && !z.avail_out;
+      if (put_output (unpack, unpack->out, out,
+		      UNPACK_CHUNK - z.avail_out))
+	break;
+    }
+
+  inflateEnd (&z);
+  free (in);
+}
+
+#ifdef HAVE_ZSTD
+
+/* Unpack the Zstandard file of *UNPACK into its pipe.  Frames one
+   after another are unpacked one after another.  */
+
+static void
+unzstd (unpack_t * unpack)
+{
+  char *buf = xmalloc (2 * UNPACK_CHUNK);
+  ZSTD_DStream *z = ZSTD_createDStream ();
+  ZSTD_inBuffer in;
+  ZSTD_outBuffer out;
+  const char *data;
+  size_t ret = 0;
+  long len;
+  int full = 0;
+
+  if (!z || ZSTD_isError (ZSTD_initDStream (z)))
+    {
+      unpack->problem = "cannot unpack";
+      ZSTD_freeDStream (z);
+      free (buf);
+      return;
+    }
+
+  in.src = NULL;
+  in.size = in.pos = 0;
+  while (1)
+    {
+      if (in.pos == in.size && !full)
+	{
+	  len = next_input (unpack, buf, &data);
+	  if (len < 0)
+	    break;
+	  if (!len)
+	    {
+	      if (ret)
+		unpack->problem = "unexpected end of compressed data";
+	      break;
+	    }
+	  in.src = data;
+	  in.size = len;
+	  in.pos = 0;
+	}
+
+      out.dst = buf + UNPACK_CHUNK;
+      out.size = UNPACK_CHUNK;
+      out.pos = 0;
+      ret = ZSTD_decompressStream (z, &out, &in);
+      if (ZSTD_isError (ret))
+	{
+	  unpack->problem = ZSTD_getErrorName (ret);
+	  break;
+	}
+      full = out.pos == out.size;
+      if (put_output (unpack, unpack->out, out.dst, out.pos))
+	break;
+    }
+
+  ZSTD_freeDStream (z);
+  free (buf);
+}
+
+#else /* not HAVE_ZSTD */
+
+/* Without libzstd, a Zstandard file cannot be unpacked.  */
+
+static void
+unzstd (unpack_t * unpack)
+{
+  unpack->problem = "cannot unpack Zstandard files without libzstd";
+}
+
+#endif /* not HAVE_ZSTD */
+
+static void
+error (int status, int errnum, const char *message,...)
+{
+  va_list args;
+
+  fflush (stdout);
+  fprintf (stderr, "%s: ", program_name);
+
+  va_start (args, message);
+  vfprintf (stderr, message, args);
+  va_end (args);
+
+  if (errnum)
+    fprintf (stderr, ": %s", strerror (errnum));
+  putc ('\n', stderr);
+  fflush (stderr);
+  if (status)
+    exit (status);
+}
+
+static void *
+xmalloc (size_t size)
+{
+  void *ptr = malloc (size);
+
+  if (!ptr)
+    error (EXIT_FAILURE, 0, "virtual memory exhausted");
+  return ptr;
+}
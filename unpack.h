@@ -0,0 +1,64 @@
+/* unpack.h -- header for unpack.c.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/* How much compressed input is read, and how much is unpacked, at
+   once.  */
+#define UNPACK_CHUNK 65536
+
+/* How much unpacked text may be waiting for the reader, if the system
+   lets a pipe hold that much.  */
+#define UNPACK_PIPE (1 << 18)
+
+/* The ways a file may be compressed.  */
+enum unpack_format
+  {
+    UNPACK_NONE,		/* It is not.  */
+    UNPACK_GZIP,		/* With gzip.  */
+    UNPACK_ZSTD			/* With Zstandard.  */
+  };
+
+/* A compressed file being unpacked by a thread of its own into a
+   pipe, which the file's `input_t' reads.  */
+struct unpack
+  {
+    enum unpack_format format;	/* How it is compressed.  */
+    char *map;			/* The mapped file, or NULL.  */
+    size_t map_len;		/* Its length.  */
+    size_t pos;			/* How much of `map' has been read.  */
+    size_t dropped;		/* How much of it has been dropped
+				   from memory.  */
+    FILE *source;		/* Otherwise, the stream it is read
+				   from.  */
+    char *head;			/* What was read from `source' to
+				   tell how it is compressed.  */
+    int head_len;		/* Its length, or zero once used.  */
+    int out;			/* The pipe's end to write to.  */
+    pthread_t thread;		/* The thread unpacking it.  */
+    const char *problem;	/* What went wrong, or NULL.  */
+    int errnum;			/* The error number that goes with it
+				   (or zero).  */
+  };
+typedef struct unpack unpack_t;
+
+const char *unpack_finish (unpack_t *, int *);
+void unpack_input (input_t *);
@@ -0,0 +1,579 @@
+/* verdict.c -- remember what Ispell said of each word.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+   Most words of a text are repeats, so rather than send Ispell every
+   line, spell splits lines into words itself and asks only about
+   words it has no verdict on yet.  This is where the verdicts are
+   kept.  Words longer than `DICT_MAX_WORD' are never kept; they are
+   always asked about.
+
+   The verdicts may also be kept from one run to the next in a cache
+   file (--word-cache).  The file holds a snapshot of a table, which
+   is mapped and searched where it lies, followed by a log of the
+   verdicts given since, which is read into memory.  A run appends
+   what it learned to the log; once the log grows long, the next run
+   writes the whole file afresh with a new snapshot.  Each file has a
+   key, naming the Ispell and dictionary its verdicts come from, and
+   a file with any other key is taken to be empty and replaced.  */
+
+/* Local headers.  */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dict.h"
+#include "verdict.h"
+
+/* System headers.  */
+
+#include <sys/types.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else /* not HAVE_STRING_H */
+#include <strings.h>
+#endif /* not HAVE_STRING_H */
+
+#ifndef EXIT_FAILURE
+#define EXIT_FAILURE 1
+#endif
+
+/* Number of slots in a new table.  */
+#define INITIAL_SIZE 4096
+
+/* The log may have this many entries more than half the snapshot's
+   before the file is rewritten.  */
+#define LOG_SLACK 1024
+
+/* Round N up to a multiple of four.  */
+#define PAD(n) (((n) + 3) & ~(size_t) 3)
+
+static void *xmalloc (size_t);
+static void *xrealloc (void *, size_t);
+static char *xstrdup (const char *);
+static void error (int, int, const char *,...);
+static void grow (verdicts_t *);
+static int insert (verdicts_t *, const char *, int, enum verdict);
+static uint32_t lookup (struct verdict_slot *, uint32_t, const char *,
+			const char *, int, uint32_t);
+static void read_log (verdicts_t *);
+static int same_key (verdicts_t *, int);
+static void write_file (verdicts_t *);
+
+/* The name of the executable this process comes from.  This should be
+   set by the caller.  */
+extern char *program_name;
+
+/* Make an empty set of verdicts and return it.  */
+
+verdicts_t *
+verdict_make (void)
+{
+  verdicts_t *verdicts = xmalloc (sizeof *verdicts);
+
+  memset (verdicts, 0, sizeof *verdicts);
+  verdicts->size = INITIAL_SIZE;
+  verdicts->slot = xmalloc (verdicts->size * sizeof *verdicts->slot);
+  memset (verdicts->slot, 0, verdicts->size * sizeof *verdicts->slot);
+  verdicts->pool = xmalloc (verdicts->pool_mem = 65536);
+  pthread_rwlock_init (&verdicts->lock, NULL);
+
+  return verdicts;
+}
+
+/* Return the verdict on the LEN characters at WORD, or
+   `VERDICT_UNKNOWN' if there is none.  */
+
+enum verdict
+verdict_find (verdicts_t * verdicts, const char *word, int len)
+{
+  enum verdict verdict = VERDICT_UNKNOWN;
+  uint32_t hash;
+  uint32_t pos;
+
+  if (len > DICT_MAX_WORD)
+    return VERDICT_UNKNOWN;
+
+  hash = dict_hash (word, len);
+  if (verdicts->old_slot)
+    {
+      pos = lookup (verdicts->old_slot, verdicts->old_size,
+		    verdicts->old_pool, word, len, hash);
+      if (verdicts->old_slot[pos].word)
+	return verdicts->old_pool[verdicts->old_slot[pos].word - 1];
+    }
+
+  pthread_rwlock_rdlock (&verdicts->lock);
+  pos = lookup (verdicts->slot, verdicts->size, verdicts->pool, word, len,
+		hash);
+  if (verdicts->slot[pos].word)
+    verdict = verdicts->pool[verdicts->slot[pos].word - 1];
+  pthread_rwlock_unlock (&verdicts->lock);
+
+  return verdict;
+}
+
+/* Record VERDICT on the LEN characters at WORD, unless there is one
+   already.  If a cache file is attached, note it for the log.  */
+
+void
+verdict_add (verdicts_t * verdicts, const char *word, int len,
+	     enum verdict verdict)
+{
+  if (len <= 0 || len > DICT_MAX_WORD || verdict == VERDICT_UNKNOWN)
+    return;
+
+  if (verdicts->old_slot
+      && verdicts->old_slot[lookup (verdicts->old_slot, verdicts->old_size,
+				    verdicts->old_pool, word, len,
+				    dict_hash (word, len))].word)
+    return;
+
+  pthread_rwlock_wrlock (&verdicts->lock);
+  if (insert (verdicts, word, len, verdict) && verdicts->file)
+    {
+      char *entry;
+
+      if (verdicts->log_len + len + 3 > verdicts->log_mem)
+	verdicts->log = xrealloc (verdicts->log, verdicts->log_mem =
+				  verdicts->log_mem * 2 + len + 4096);
+      entry = verdicts->log + verdicts->log_len;
+      entry[0] = verdict;
+      entry[1] = len;
+      memcpy (entry + 2, word, len);
+      entry[len + 2] = '\n';
+      verdicts->log_len += len + 3;
+    }
+  pthread_rwlock_unlock (&verdicts->lock);
+}
+
+/* Attach the cache file FILE to *VERDICTS, which must be empty, for
+   verdicts given under KEY.  If the file is there, has that key and
+   is sound, look words up in its snapshot and add those of its log
+   to *VERDICTS.  Otherwise note that it must be written afresh.
+   `verdict_save' writes it.  */
+
+void
+verdict_attach (verdicts_t * verdicts, const char *file, const char *key)
+{
+  struct verdict_header header;
+  struct stat stat_buf;
+  size_t table_len;
+  size_t pool_len;
+  char *map;
+  int desc;
+
+  verdicts->file = xstrdup (file);
+  verdicts->key = xstrdup (key);
+  verdicts->stale = 1;
+
+  desc = open (file, O_RDONLY);
+  if (desc == -1)
+    {
+      if (errno != ENOENT)
+	error (0, errno, "%s: cannot open", file);
+      return;
+    }
+  if (fstat (desc, &stat_buf) == -1 || stat_buf.st_size < sizeof header)
+    {
+      close (desc);
+      return;
+    }
+
+  map = mmap (NULL, stat_buf.st_size, PROT_READ, MAP_SHARED, desc, 0);
+  close (desc);
+  if (map == MAP_FAILED)
+    {
+      error (0, errno, "%s: cannot map", file);
+      return;
+    }
+
+  memcpy (&header, map, sizeof header);
+  table_len = (size_t) header.size * sizeof (struct verdict_slot);
+  pool_len = PAD ((size_t) header.pool_len);
+  if (memcmp (header.magic, VERDICT_MAGIC, sizeof header.magic)
+      || header.byte_order != 0x01020304
+      || header.version != VERDICT_VERSION
+      || header.key_len != strlen (key)
+      || memcmp (map + sizeof header, key, header.key_len)
+      || !header.size || (header.size & (header.size - 1))
+      || header.count >= header.size
+      || stat_buf.st_size < (sizeof header + PAD (header.key_len)
+			     + table_len + pool_len)
+      || dict_checksum (map + sizeof header,
+			PAD (header.key_len) + table_len + pool_len)
+      != header.checksum)
+    {
+      munmap (map, stat_buf.st_size);
+      return;
+    }
+
+  verdicts->map = map;
+  verdicts->map_len = stat_buf.st_size;
+  verdicts->old_slot = (struct verdict_slot *)
+    (map + sizeof header + PAD (header.key_len));
+  verdicts->old_size = header.size;
+  verdicts->old_count = header.count;
+  verdicts->old_pool = (char *) verdicts->old_slot + table_len;
+  verdicts->log_start = sizeof header + PAD (header.key_len) + table_len
+    + pool_len;
+  verdicts->stale = 0;
+
+  read_log (verdicts);
+  if (verdicts->logged > verdicts->old_count / 2 + LOG_SLACK)
+    verdicts->stale = 1;
+}
+
+/* Write what *VERDICTS has learned to its cache file, if one is
+   attached: append to the log, or if the file is stale, write the
+   whole of it afresh.  A cache is only a cache, so on failure just
+   say so.  */
+
+void
+verdict_save (verdicts_t * verdicts)
+{
+  int desc;
+
+  if (!verdicts->file || (!verdicts->stale && !verdicts->log_len))
+    return;
+
+  if (verdicts->stale)
+    {
+      write_file (verdicts);
+      return;
+    }
+
+  /* Another run may have rewritten the file since it was read, so
+     append only to a file that is still for the same key.  The lock
+     keeps runs from interleaving their entries.  */
+  desc = open (verdicts->file, O_RDWR | O_APPEND);
+  if (desc == -1)
+    {
+      error (0, errno, "%s: cannot open", verdicts->file);
+      return;
+    }
+  flock (desc, LOCK_EX);
+  if (same_key (verdicts, desc)
+      && write (desc, verdicts->log, verdicts->log_len) != verdicts->log_len)
+    error (0, errno, "%s: write error", verdicts->file);
+  close (desc);
+}
+
+/* Add the entries of the log of the mapped cache file of *VERDICTS
+   to its table.  Should the log end in an entry cut short, as when a
+   run was killed while appending, stop there and mark the file
+   stale.  */
+
+static void
+read_log (verdicts_t * verdicts)
+{
+  char *map = verdicts->map;
+  size_t pos = verdicts->log_start;
+
+  while (pos < verdicts->map_len)
+    {
+      int verdict = map[pos];
+      int len;
+
+      if (pos + 2 > verdicts->map_len)
+	break;
+      len = (unsigned char) map[pos + 1];
+      if (verdict < VERDICT_OK || verdict > VERDICT_GUESS || !len
+	  || pos + len + 3 > verdicts->map_len || map[pos + len + 2] != '\n')
+	break;
+
+      insert (verdicts, map + pos + 2, len, verdict);
+      verdicts->logged++;
+      pos += len + 3;
+    }
+
+  if (pos != verdicts->map_len)
+    verdicts->stale = 1;
+}
+
+/* Return nonzero if the file open on DESC is a cache file for the
+   key of *VERDICTS.  */
+
+static int
+same_key (verdicts_t * verdicts, int desc)
+{
+  struct verdict_header header;
+  size_t key_len = strlen (verdicts->key);
+  char *key;
+  int same;
+
+  if (pread (desc, &header, sizeof header, 0) != sizeof header
+      || memcmp (header.magic, VERDICT_MAGIC, sizeof header.magic)
+      || header.version != VERDICT_VERSION
+      || header.byte_order != 0x01020304 || header.key_len != key_len)
+    return 0;
+
+  key = xmalloc (key_len + 1);
+  same = (pread (desc, key, key_len, sizeof header) == key_len
+	  && !memcmp (key, verdicts->key, key_len));
+  free (key);
+
+  return same;
+}
+
+/* Write the cache file of *VERDICTS afresh, with all its verdicts in
+   the snapshot and none in the log.  The file is written under a
+   temporary name and then renamed, so that a reader never sees half
+   of it.  */
+
+static void
+write_file (verdicts_t * verdicts)
+{
+  verdicts_t *all = verdict_make ();
+  struct verdict_header header;
+  size_t key_len = strlen (verdicts->key);
+  size_t table_len;
+  size_t pool_len;
+  char *image;
+  char *temp;
+  FILE *stream;
+  uint32_t i;
+
+  for (i = 0; i < verdicts->old_size; i++)
+    if (verdicts->old_slot[i].word)
+      {
+	char *entry = verdicts->old_pool + verdicts->old_slot[i].word - 1;
+
+	insert (all, entry + 2, (unsigned char) entry[1], entry[0]);
+      }
+  for (i = 0; i < verdicts->size; i++)
+    if (verdicts->slot[i].word)
+      {
+	char *entry = verdicts->pool + verdicts->slot[i].word - 1;
+
+	insert (all, entry + 2, (unsigned char) entry[1], entry[0]);
+      }
+
+  /* Build the key, table and padded pool in one block to checksum
+     it.  */
+  table_len = all->size * sizeof *all->slot;
+  pool_len = PAD (all->pool_len);
+  image = xmalloc (PAD (key_len) + table_len + pool_len);
+  memset (image, 0, PAD (key_len) + table_len + pool_len);
+  memcpy (image, verdicts->key, key_len);
+  memcpy (image + PAD (key_len), all->slot, table_len);
+  memcpy (image + PAD (key_len) + table_len, all->pool, all->pool_len);
+
+  memset (&header, 0, sizeof header);
+  memcpy (header.magic, VERDICT_MAGIC, sizeof header.magic);
+  header.version = VERDICT_VERSION;
+  header.byte_order = 0x01020304;
+  header.key_len = key_len;
+  header.size = all->size;
+  header.count = all->count;
+  header.pool_len = all->pool_len;
+  header.checksum = dict_checksum (image, PAD (key_len) + table_len
+				   + pool_len);
+
+  /* Runs that rewrite the file at once must not share a temporary
+     file.  */
+  temp = xmalloc (strlen (verdicts->file) + 32);
+  sprintf (temp, "%s.%ld.tmp", verdicts->file, (long) getpid ());
+
+  stream = fopen (temp, "wb");
+  if (!stream)
+    error (0, errno, "%s: cannot create", temp);
+  else if (fwrite (&header, sizeof header, 1, stream) != 1
+	   || fwrite (image, 1, PAD (key_len) + table_len + pool_len, stream)
+	   != PAD (key_len) + table_len + pool_len
+	   || fclose (stream) == EOF)
+    {
+      error (0, errno, "%s: write error", temp);
+      unlink (temp);
+    }
+  else if (rename (temp, verdicts->file) == -1)
+    {
+      error (0, errno, "%s: cannot rename to %s", temp, verdicts->file);
+      unlink (temp);
+    }
+
+  free (temp);
+  free (image);
+}
+
+/* Add VERDICT on the LEN characters at WORD to the table of
+   *VERDICTS, unless there is one already.  Return nonzero if it was
+   added.  */
+
+static int
+insert (verdicts_t * verdicts, const char *word, int len,
+	enum verdict verdict)
+{
+  uint32_t hash = dict_hash (word, len);
+  uint32_t pos;
+  char *entry;
+
+  if ((verdicts->count + 1) * 2 > verdicts->size)
+    grow (verdicts);
+
+  pos = lookup (verdicts->slot, verdicts->size, verdicts->pool, word, len,
+		hash);
+  if (verdicts->slot[pos].word)
+    return 0;
+
+  if (verdicts->pool_len + len + 2 > verdicts->pool_mem)
+    verdicts->pool = xrealloc (verdicts->pool, verdicts->pool_mem *= 2);
+  entry = verdicts->pool + verdicts->pool_len;
+  entry[0] = verdict;
+  entry[1] = len;
+  memcpy (entry + 2, word, len);
+
+  verdicts->slot[pos].hash = hash;
+  verdicts->slot[pos].word = verdicts->pool_len + 1;
+  verdicts->pool_len += len + 2;
+  verdicts->count++;
+
+  return 1;
+}
+
+/* Return the slot of the table of SIZE slots at SLOT, with its pool at
+   POOL, that holds the LEN characters at WORD, whose hash is HASH, or
+   else the empty slot where they would go.  */
+
+static uint32_t
+lookup (struct verdict_slot *slot, uint32_t size, const char *pool,
+	const char *word, int len, uint32_t hash)
+{
+  uint32_t mask = size - 1;
+  uint32_t pos;
+
+  for (pos = hash & mask; slot[pos].word; pos = (pos + 1) & mask)
+    if (slot[pos].hash == hash)
+      {
+	const char *entry = pool + slot[pos].word - 1;
+
+	if ((unsigned char) entry[1] == len && !memcmp (entry + 2, word, len))
+	  break;
+      }
+
+  return pos;
+}
+
+/* Double the number of slots in *VERDICTS, moving every word to its
+   place in the bigger table.  */
+
+static void
+grow (verdicts_t * verdicts)
+{
+  struct verdict_slot *old = verdicts->slot;
+  uint32_t old_size = verdicts->size;
+  uint32_t mask;
+  uint32_t i;
+
+  verdicts->size *= 2;
+  mask = verdicts->size - 1;
+  verdicts->slot = xmalloc (verdicts->size * sizeof *verdicts->slot);
+  memset (verdicts->slot, 0, verdicts->size * sizeof *verdicts->slot);
+
+  for (i = 0; i < old_size; i++)
+    if (old[i].word)
+      {
+	uint32_t pos;
+
+	for (pos = old[i].hash & mask; verdicts->slot[pos].word;
+	     pos = (pos + 1) & mask);
+	verdicts->slot[pos] = old[i];
+      }
+
+  free (old);
+}
+
+/* Print the program name and error message MESSAGE, which is a
+   printf-style format string with optional args.  If ERRNUM is
+   nonzero, print its corresponding system error message.  Exit with
+   status STATUS if it is nonzero.  This function was written by David
+   MacKenzie <djm@gnu.ai.mit.edu>.  */
+
+static void
+error (int status, int errnum, const char *message,...)
+{
+  va_list args;
+
+  fflush (stdout);
+  fprintf (stderr, "%s: ", program_name);
+
+  va_start (args, message);
+  vfprintf (stderr, message, args);
+  va_end (args);
+
+  if (errnum)
+    fprintf (stderr, ": %s", strerror (errnum));
+  putc ('\n', stderr);
+  fflush (stderr);
+  if (status)
+    exit (status);
+}
+
+/* Allocate SIZE bytes of memory dynamically, with error checking,
+   returning a pointer to that memory.  */
+
+static void *
+xmalloc (size_t size)
+{
+  void *ptr = malloc (size);
+
+  if (!ptr)
+    error (EXIT_FAILURE, 0, "virtual memory exhausted");
+  return ptr;
+}
+
+/* Change the size of an allocated block of memory *PTR to SIZE bytes,
+   with error checking, returning the new pointer.  If PTR is NULL,
+   run `xmalloc'.  */
+
+static void *
+xrealloc (void *ptr, size_t size)
+{
+  if (!ptr)
+    return xmalloc (size);
+  ptr = realloc (ptr, size);
+  if (!ptr)
+    error (EXIT_FAILURE, 0, "virtual memory exhausted");
+  return ptr;
+}
+
+/* Duplicate STR, returning an identical malloc'd string.  I first
+   just did this for error checking, calling `strdup', but the task is
+   so simple I decided to just do it here--it saves a call.  */
+
+static char *
+xstrdup (const char *str)
+{
+  size_t len = strlen (str) + 1;
+  void *new = xmalloc (len);
+
+  memcpy (new, (void *) str, len);
+
+  return (char *) new;
+}
@@ -0,0 +1,109 @@
+/* verdict.h -- header for verdict.c.
+
+   This file is part of GNU Spell.
+   Copyright (C) 1996 Free Software Foundation, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include <pthread.h>
+#include <stdint.h>
+
+/* What Ispell said of a word.  */
+enum verdict
+  {
+    VERDICT_UNKNOWN,		/* Not asked yet.  */
+    VERDICT_OK,			/* Spelled correctly (`*', `+', `-').  */
+    VERDICT_MISSPELLED,		/* Misspelled (`&', `#').  */
+    VERDICT_GUESS		/* Only a guess from affixes (`?'),
+				   printed with `--verbose'.  */
+  };
+
+/* The first bytes of a verdict cache file, and the version of the
+   format written by `verdict_save'.  */
+#define VERDICT_MAGIC "GNUSVCAC"
+#define VERDICT_VERSION 1
+
+/* The header of a verdict cache file.  It is followed by the key
+   (`key_len' bytes, padded to a multiple of four), the table of the
+   snapshot (`size' slots), the snapshot's pool (`pool_len' bytes,
+   padded to a multiple of four), and then the log: entries added
+   since the snapshot, each laid out as in a pool and followed by a
+   newline.  */
+struct verdict_header
+  {
+    char magic[8];		/* `VERDICT_MAGIC', without the NUL.  */
+    uint32_t version;		/* `VERDICT_VERSION'.  */
+    uint32_t byte_order;	/* `0x01020304' as the writer saw it.  */
+    uint32_t key_len;		/* Length of the key.  */
+    uint32_t size;		/* Number of slots.  */
+    uint32_t count;		/* Number of words in the snapshot.  */
+    uint32_t pool_len;		/* Bytes of the pool in use.  */
+    uint32_t checksum;		/* `dict_checksum' of the key, table and
+				   pool.  */
+  };
+
+/* One slot of the hash table.  */
+struct verdict_slot
+  {
+    uint32_t hash;		/* The hash of the word.  */
+    uint32_t word;		/* Offset of the entry in the pool plus
+				   one, or zero if the slot is empty.  */
+  };
+
+/* The verdicts on the words seen so far, in an open-addressing hash
+   table with linear probing that is never more than half full.  Any
+   thread may use it; `lock' is taken for reading to look a word up
+   and for writing to add one.
+
+   If a cache file is attached, the words of its snapshot are looked
+   up where the file is mapped, and those of its log are added to the
+   table as it is read.  */
+struct verdicts
+  {
+    struct verdict_slot *slot;	/* The table.  */
+    uint32_t size;		/* Number of slots; a power of two.  */
+    uint32_t count;		/* Number of words in the table.  */
+    char *pool;			/* Each word as a verdict byte and a
+				   length byte followed by its
+				   characters.  */
+    size_t pool_len;		/* Bytes of the pool in use.  */
+    size_t pool_mem;		/* Bytes of the pool allocated.  */
+    pthread_rwlock_t lock;	/* Guards all of the above.  */
+
+    char *file;			/* The attached cache file, or NULL.  */
+    char *key;			/* What its verdicts must have been
+				   given under.  */
+    int stale;			/* Whether it must be rewritten whole,
+				   being missing, corrupt, of another
+				   key, or with too long a log.  */
+    void *map;			/* The file mapped, or NULL.  */
+    size_t map_len;		/* Its length.  */
+    struct verdict_slot *old_slot; /* The snapshot's table.  */
+    uint32_t old_size;		/* Its number of slots.  */
+    uint32_t old_count;		/* Its number of words.  */
+    char *old_pool;		/* Its pool.  */
+    size_t log_start;		/* Offset of the log in the file.  */
+    uint32_t logged;		/* Number of entries in the log.  */
+    char *log;			/* Entries to append to the log.  */
+    size_t log_len;		/* Bytes of `log' in use.  */
+    size_t log_mem;		/* Bytes of `log' allocated.  */
+  };
+typedef struct verdicts verdicts_t;
+
+enum verdict verdict_find (verdicts_t *, const char *, int);
+verdicts_t *verdict_make (void);
+void verdict_add (verdicts_t *, const char *, int, enum verdict);
+void verdict_attach (verdicts_t *, const char *, const char *);
+void verdict_save (verdicts_t *);